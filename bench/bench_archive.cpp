@@ -0,0 +1,87 @@
+#include <benchmark/benchmark.h>
+#include <lochfolk/vfs.hpp>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "bench_common.hpp"
+
+namespace
+{
+constexpr std::size_t entry_count = 64;
+constexpr std::size_t entry_size = 1024 * 1024;
+
+struct archive_fixture
+{
+    lochfolk::virtual_file_system vfs;
+    std::vector<lochfolk::path> entries;
+
+    archive_fixture()
+    {
+        std::vector<std::pair<std::string, std::string>> files;
+        for(std::size_t i = 0; i < entry_count; ++i)
+        {
+            std::string name = "entry_" + std::to_string(i) + ".txt";
+            files.emplace_back(name, lochfolk_bench::make_payload(entry_size, static_cast<unsigned int>(i)));
+            entries.emplace_back("/bench/" + name);
+        }
+
+        auto ar_path = lochfolk_bench::data_dir() / "parallel.zip";
+        lochfolk_bench::write_zip(ar_path, files);
+
+        using namespace lochfolk::vfs_literals;
+        vfs.mount_archive("/bench"_pv, ar_path);
+    }
+};
+
+archive_fixture& fixture()
+{
+    static archive_fixture f;
+    return f;
+}
+
+int max_threads()
+{
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+/**
+ * @brief Every thread decompresses different entries of the same archive
+ */
+void archive_read_string(benchmark::State& state)
+{
+    auto& f = fixture();
+
+    std::size_t i = static_cast<std::size_t>(state.thread_index());
+    for(auto _ : state)
+    {
+        std::string str = f.vfs.read_string(f.entries[i % entry_count]);
+        benchmark::DoNotOptimize(str.data());
+        i += static_cast<std::size_t>(state.threads());
+    }
+
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * entry_size));
+}
+
+BENCHMARK(archive_read_string)->ThreadRange(1, max_threads())->UseRealTime();
+
+void archive_stream_read(benchmark::State& state)
+{
+    auto& f = fixture();
+    std::vector<char> buf(entry_size);
+
+    std::size_t i = static_cast<std::size_t>(state.thread_index());
+    for(auto _ : state)
+    {
+        auto vfss = f.vfs.open(f.entries[i % entry_count]);
+        vfss.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        benchmark::DoNotOptimize(buf.data());
+        i += static_cast<std::size_t>(state.threads());
+    }
+
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * entry_size));
+}
+
+BENCHMARK(archive_stream_read)->ThreadRange(1, max_threads())->UseRealTime();
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+#include <lochfolk/vfs.hpp>
+#include <vector>
+#include "bench_common.hpp"
+
+namespace
+{
+constexpr std::size_t entry_count = 16;
+constexpr std::size_t entry_size = 1024 * 1024;
+
+/**
+ * @brief Archives with the same content compressed by different methods
+ */
+struct codec_fixture
+{
+    std::vector<std::pair<std::string, std::string>> files;
+
+    codec_fixture()
+    {
+        for(std::size_t i = 0; i < entry_count; ++i)
+        {
+            files.emplace_back(
+                "asset_" + std::to_string(i) + ".json",
+                lochfolk_bench::make_payload(entry_size, static_cast<unsigned int>(i))
+            );
+        }
+    }
+
+    std::filesystem::path archive_for(std::uint16_t method) const
+    {
+        auto ar_path = lochfolk_bench::data_dir() / ("codec_" + std::to_string(method) + ".zip");
+        if(!std::filesystem::exists(ar_path))
+            lochfolk_bench::write_zip(ar_path, files, method);
+        return ar_path;
+    }
+};
+
+codec_fixture& fixture()
+{
+    static codec_fixture f;
+    return f;
+}
+
+void read_entries(benchmark::State& state, std::uint16_t method)
+{
+    using namespace lochfolk::vfs_literals;
+
+    auto& f = fixture();
+    lochfolk::virtual_file_system vfs;
+    vfs.mount_archive("/data"_pv, f.archive_for(method));
+
+    std::vector<lochfolk::path> paths;
+    for(const auto& [name, _] : f.files)
+        paths.emplace_back("/data/" + name);
+
+    for(auto _ : state)
+    {
+        for(const auto& p : paths)
+        {
+            std::string str = vfs.read_string(p);
+            benchmark::DoNotOptimize(str.data());
+        }
+    }
+
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * entry_count * entry_size));
+}
+
+BENCHMARK_CAPTURE(read_entries, store, MZ_COMPRESS_METHOD_STORE)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(read_entries, deflate, MZ_COMPRESS_METHOD_DEFLATE)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(read_entries, lzma, MZ_COMPRESS_METHOD_LZMA)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(read_entries, zstd, MZ_COMPRESS_METHOD_ZSTD)->Unit(benchmark::kMillisecond);
+} // namespace
+
+BENCHMARK_MAIN();
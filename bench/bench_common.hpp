@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <random>
+#include <span>
+#include <utility>
+#include <filesystem>
+#include "../test/zip_writer.hpp"
+
+namespace lochfolk_bench
+{
+/**
+ * @brief Generate text-like data with a compression ratio close to real assets
+ */
+inline std::string make_payload(std::size_t size, unsigned int seed)
+{
+    static constexpr std::string_view words[] = {
+        "texture", "mesh", "shader", "index", "json", "audio", "en_US", "material", "{", "}", "\n", "0.5", "1024"
+    };
+
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<std::size_t> dist(0, std::size(words) - 1);
+
+    std::string result;
+    result.reserve(size + 16);
+    while(result.size() < size)
+    {
+        result += words[dist(gen)];
+        result += ' ';
+    }
+    result.resize(size);
+
+    return result;
+}
+
+/**
+ * @brief Temporary directory for benchmark data
+ */
+inline std::filesystem::path data_dir()
+{
+    auto dir = std::filesystem::temp_directory_path() / "lochfolk_bench";
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+
+using lochfolk_test::write_zip;
+} // namespace lochfolk_bench
@@ -0,0 +1,107 @@
+#include <benchmark/benchmark.h>
+#include <lochfolk/vfs.hpp>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+#include "bench_common.hpp"
+
+namespace
+{
+constexpr std::size_t base_file_count = 100000;
+constexpr std::size_t patch_entry_count = 2000;
+
+struct concurrency_fixture
+{
+    lochfolk::virtual_file_system vfs;
+    // Paths of the base files in random order
+    std::vector<lochfolk::path> paths;
+    std::filesystem::path patch_path;
+
+    concurrency_fixture()
+    {
+        for(std::size_t i = 0; i < base_file_count; ++i)
+        {
+            paths.emplace_back(
+                "/base/dir_" + std::to_string(i % 100) + "/file_" + std::to_string(i) + ".json"
+            );
+            vfs.mount_string(paths.back(), "lochfolk");
+        }
+        std::shuffle(paths.begin(), paths.end(), std::mt19937(182375));
+
+        std::vector<std::pair<std::string, std::string>> files;
+        for(std::size_t i = 0; i < patch_entry_count; ++i)
+        {
+            files.emplace_back(
+                "dir_" + std::to_string(i % 16) + "/entry_" + std::to_string(i) + ".json",
+                lochfolk_bench::make_payload(64, static_cast<unsigned int>(i))
+            );
+        }
+
+        patch_path = lochfolk_bench::data_dir() / "concurrency_patch.zip";
+        lochfolk_bench::write_zip(patch_path, files);
+    }
+};
+
+concurrency_fixture& fixture()
+{
+    static concurrency_fixture f;
+    return f;
+}
+
+/**
+ * @brief Look up base files on every benchmark thread
+ *
+ * With a nonzero argument, a background thread keeps mounting and removing a patch archive during the run,
+ * like hot-mounting DLC while render and audio threads are reading files.
+ */
+void lookup_during_mounts(benchmark::State& state)
+{
+    auto& f = fixture();
+    const bool mounting = state.range(0) != 0;
+
+    std::atomic_bool stop = false;
+    std::atomic_size_t mounts = 0;
+    std::jthread writer;
+    if(mounting && state.thread_index() == 0)
+    {
+        writer = std::jthread(
+            [&]()
+            {
+                using namespace lochfolk::vfs_literals;
+
+                while(!stop)
+                {
+                    f.vfs.mount_archive("/patch"_pv, f.patch_path);
+                    f.vfs.remove("/patch"_pv);
+                    ++mounts;
+                }
+            }
+        );
+    }
+
+    std::size_t i = static_cast<std::size_t>(state.thread_index()) * 7919;
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(f.vfs.file_size(f.paths[i % f.paths.size()]));
+        ++i;
+    }
+
+    stop = true;
+    if(writer.joinable())
+        writer.join();
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+    if(state.thread_index() == 0)
+        state.counters["mounts"] = static_cast<double>(mounts);
+}
+
+BENCHMARK(lookup_during_mounts)
+    ->ArgName("mounting")
+    ->Arg(0)
+    ->Arg(1)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,221 @@
+#include <benchmark/benchmark.h>
+#include <lochfolk/vfs.hpp>
+#include <fstream>
+#include <vector>
+#include "bench_common.hpp"
+
+namespace
+{
+using namespace lochfolk::vfs_literals;
+
+constexpr std::size_t max_archive_count = 64;
+constexpr std::size_t entries_per_archive = 2000;
+
+struct mount_fixture
+{
+    std::vector<lochfolk::path> mount_points;
+    std::vector<lochfolk::archive_source> sources;
+
+    mount_fixture()
+    {
+        mount_points.reserve(max_archive_count);
+        for(std::size_t i = 0; i < max_archive_count; ++i)
+        {
+            std::vector<std::pair<std::string, std::string>> files;
+            for(std::size_t j = 0; j < entries_per_archive; ++j)
+            {
+                files.emplace_back(
+                    "dir_" + std::to_string(j % 16) + "/entry_" + std::to_string(j) + ".json",
+                    lochfolk_bench::make_payload(64, static_cast<unsigned int>(i * entries_per_archive + j))
+                );
+            }
+
+            auto ar_path = lochfolk_bench::data_dir() / ("patch_" + std::to_string(i) + ".zip");
+            lochfolk_bench::write_zip(ar_path, files);
+
+            // All patches are mounted to the same place, like a real launcher does
+            mount_points.emplace_back("/data");
+            sources.push_back({mount_points.back(), ar_path});
+        }
+    }
+};
+
+mount_fixture& fixture()
+{
+    static mount_fixture f;
+    return f;
+}
+
+void mount_archive_sequential(benchmark::State& state)
+{
+    auto& f = fixture();
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+
+    for(auto _ : state)
+    {
+        lochfolk::virtual_file_system vfs;
+        for(std::size_t i = 0; i < count; ++i)
+            vfs.mount_archive(f.sources[i].mount_point, f.sources[i].sys_path);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * count));
+}
+
+BENCHMARK(mount_archive_sequential)->RangeMultiplier(2)->Range(1, max_archive_count)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void mount_archives_batch(benchmark::State& state)
+{
+    auto& f = fixture();
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+
+    for(auto _ : state)
+    {
+        lochfolk::virtual_file_system vfs;
+        vfs.mount_archives(std::span(f.sources).first(count));
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * count));
+}
+
+BENCHMARK(mount_archives_batch)->RangeMultiplier(2)->Range(1, max_archive_count)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+constexpr std::size_t startup_top_dirs = 30;
+constexpr std::size_t startup_sub_dirs = 100;
+constexpr std::size_t startup_files_per_dir = 100;
+// 300k files in total
+constexpr std::size_t startup_file_count = startup_top_dirs * startup_sub_dirs * startup_files_per_dir;
+
+constexpr std::size_t startup_archive_count = startup_top_dirs / 5;
+
+/**
+ * @brief A directory of 300k files and archives of the same files, with their manifests
+ *
+ * The files are split into archives of 50k entries, so the archives need no ZIP64 records.
+ */
+struct startup_fixture
+{
+    std::filesystem::path dir = lochfolk_bench::data_dir() / "startup";
+    std::vector<std::filesystem::path> ar_paths;
+    std::filesystem::path dir_manifest_path = lochfolk_bench::data_dir() / "startup_dir.manifest";
+    std::filesystem::path ar_manifest_path = lochfolk_bench::data_dir() / "startup_zip.manifest";
+
+    startup_fixture()
+    {
+        namespace stdfs = std::filesystem;
+
+        for(std::size_t i = 0; i < startup_archive_count; ++i)
+            ar_paths.push_back(lochfolk_bench::data_dir() / ("startup_" + std::to_string(i) + ".zip"));
+
+        // Creating the files takes a while, so they are reused by later runs
+        if(!stdfs::exists(dir / "complete"))
+        {
+            stdfs::remove_all(dir);
+            std::vector<std::pair<std::string, std::string>> files;
+            for(std::size_t i = 0; i < startup_top_dirs; ++i)
+            {
+                for(std::size_t j = 0; j < startup_sub_dirs; ++j)
+                {
+                    const std::string sub = "assets_" + std::to_string(i) + "/category_" + std::to_string(j);
+                    stdfs::create_directories(dir / sub);
+                    for(std::size_t k = 0; k < startup_files_per_dir; ++k)
+                    {
+                        std::string name = sub + "/texture_" + std::to_string(k) + ".png";
+                        std::ofstream(dir / name) << k;
+                        files.emplace_back(std::move(name), std::to_string(k));
+                    }
+                }
+
+                if((i + 1) % (startup_top_dirs / startup_archive_count) == 0)
+                {
+                    lochfolk_bench::write_zip(ar_paths[i / (startup_top_dirs / startup_archive_count)], files, MZ_COMPRESS_METHOD_STORE);
+                    files.clear();
+                }
+            }
+            std::ofstream(dir / "complete");
+        }
+
+        lochfolk::mount_batch batch;
+        lochfolk::mount_manifest dir_manifest;
+        batch.add_dir("/data"_pv, dir, dir_manifest);
+        dir_manifest.save(dir_manifest_path);
+        lochfolk::mount_manifest ar_manifest;
+        for(const auto& p : ar_paths)
+            batch.add_archive("/data"_pv, p, ar_manifest);
+        ar_manifest.save(ar_manifest_path);
+    }
+};
+
+startup_fixture& startup()
+{
+    static startup_fixture f;
+    return f;
+}
+
+/**
+ * @brief Mount a directory of 300k files by enumerating it (argument 0) or from a saved manifest (argument 1)
+ *
+ * Loading the manifest is measured as a part of the startup.
+ */
+void startup_mount_dir(benchmark::State& state)
+{
+    auto& f = startup();
+    const bool use_manifest = state.range(0) != 0;
+
+    for(auto _ : state)
+    {
+        lochfolk::virtual_file_system vfs;
+        if(use_manifest)
+        {
+            lochfolk::mount_manifest manifest;
+            manifest.load(f.dir_manifest_path);
+            vfs.mount_dir("/data"_pv, f.dir, manifest);
+            if(manifest.hits() != 1)
+                state.SkipWithError("manifest is not valid");
+        }
+        else
+            vfs.mount_dir("/data"_pv, f.dir);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * startup_file_count));
+}
+
+BENCHMARK(startup_mount_dir)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * @brief Mount archives of 300k entries by reading their central directories (argument 0) or from a saved manifest (argument 1)
+ */
+void startup_mount_archive(benchmark::State& state)
+{
+    auto& f = startup();
+    const bool use_manifest = state.range(0) != 0;
+
+    for(auto _ : state)
+    {
+        lochfolk::virtual_file_system vfs;
+        if(use_manifest)
+        {
+            lochfolk::mount_manifest manifest;
+            manifest.load(f.ar_manifest_path);
+            for(const auto& p : f.ar_paths)
+                vfs.mount_archive("/data"_pv, p, manifest);
+            if(manifest.hits() != f.ar_paths.size())
+                state.SkipWithError("manifest is not valid");
+        }
+        else
+        {
+            for(const auto& p : f.ar_paths)
+                vfs.mount_archive("/data"_pv, p);
+        }
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * startup_file_count));
+}
+
+BENCHMARK(startup_mount_archive)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,77 @@
+#include <benchmark/benchmark.h>
+#include <lochfolk/vfs.hpp>
+#include <thread>
+#include "bench_common.hpp"
+
+namespace
+{
+constexpr std::size_t large_size = 256 * 1024 * 1024;
+
+/**
+ * @brief Packs of a single large file, with and without chunking
+ */
+struct pack_fixture
+{
+    std::filesystem::path chunked_path = lochfolk_bench::data_dir() / "large_chunked.lpk";
+    std::filesystem::path whole_path = lochfolk_bench::data_dir() / "large_whole.lpk";
+
+    pack_fixture()
+    {
+        using namespace lochfolk::vfs_literals;
+
+        lochfolk::virtual_file_system vfs;
+        vfs.mount_string("/large.bin"_pv, lochfolk_bench::make_payload(large_size, 182375));
+
+        vfs.write_pack("/"_pv, chunked_path, {.encoding = lochfolk::pack_encoding::zstd});
+        vfs.write_pack("/"_pv, whole_path, {.encoding = lochfolk::pack_encoding::zstd, .chunk_size = 0});
+    }
+};
+
+pack_fixture& fixture()
+{
+    static pack_fixture f;
+    return f;
+}
+
+void read_large_whole(benchmark::State& state)
+{
+    using namespace lochfolk::vfs_literals;
+
+    lochfolk::virtual_file_system vfs;
+    vfs.mount_pack("/"_pv, fixture().whole_path);
+
+    for(auto _ : state)
+    {
+        std::string str = vfs.read_string("/large.bin"_pv);
+        benchmark::DoNotOptimize(str.data());
+    }
+
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * large_size));
+}
+
+BENCHMARK(read_large_whole)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void read_large_chunked(benchmark::State& state)
+{
+    using namespace lochfolk::vfs_literals;
+
+    lochfolk::virtual_file_system vfs;
+    vfs.mount_pack("/"_pv, fixture().chunked_path, true, static_cast<unsigned int>(state.range(0)));
+
+    for(auto _ : state)
+    {
+        std::string str = vfs.read_string("/large.bin"_pv);
+        benchmark::DoNotOptimize(str.data());
+    }
+
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * large_size));
+}
+
+BENCHMARK(read_large_chunked)
+    ->RangeMultiplier(2)
+    ->Range(1, std::max(1u, std::thread::hardware_concurrency()))
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+} // namespace
+
+BENCHMARK_MAIN();
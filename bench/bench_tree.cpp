@@ -0,0 +1,532 @@
+#include <benchmark/benchmark.h>
+#include <lochfolk/vfs.hpp>
+#include <algorithm>
+#include <cctype>
+#include <memory_resource>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+constexpr std::size_t top_dirs = 50;
+constexpr std::size_t sub_dirs = 100;
+constexpr std::size_t files_per_dir = 100;
+// 500k files in total
+constexpr std::size_t file_count = top_dirs * sub_dirs * files_per_dir;
+
+constexpr std::string_view content = "lochfolk";
+
+std::vector<lochfolk::path> make_paths()
+{
+    std::vector<lochfolk::path> result;
+    result.reserve(file_count);
+    for(std::size_t i = 0; i < top_dirs; ++i)
+    {
+        for(std::size_t j = 0; j < sub_dirs; ++j)
+        {
+            for(std::size_t k = 0; k < files_per_dir; ++k)
+            {
+                result.emplace_back(
+                    "/assets_" + std::to_string(i) +
+                    "/category_" + std::to_string(j) +
+                    "/texture_" + std::to_string(k) + ".png"
+                );
+            }
+        }
+    }
+
+    return result;
+}
+
+struct tree_fixture
+{
+    std::vector<lochfolk::path> paths = make_paths();
+    // Same paths in random order for lookups
+    std::vector<lochfolk::path> shuffled;
+    std::vector<lochfolk::path> missing;
+    lochfolk::virtual_file_system vfs;
+
+    tree_fixture()
+    {
+        shuffled = paths;
+        std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(182375));
+
+        for(const auto& p : paths)
+            vfs.mount_string(p, content);
+
+        for(std::size_t i = 0; i < 4096; ++i)
+            missing.push_back(shuffled[i].parent_path() / std::string_view("missing.png"));
+    }
+};
+
+tree_fixture& fixture()
+{
+    static tree_fixture f;
+    return f;
+}
+
+const lochfolk::frozen_vfs& frozen_fixture()
+{
+    static const lochfolk::frozen_vfs frozen = fixture().vfs.freeze();
+    return frozen;
+}
+
+void tree_build(benchmark::State& state)
+{
+    auto& f = fixture();
+
+    for(auto _ : state)
+    {
+        lochfolk::virtual_file_system vfs;
+        for(const auto& p : f.paths)
+            vfs.mount_string(p, content);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * file_count));
+}
+
+BENCHMARK(tree_build)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Same as above, allocating the tree from a monotonic buffer released at once
+ */
+void tree_build_monotonic(benchmark::State& state)
+{
+    auto& f = fixture();
+
+    for(auto _ : state)
+    {
+        std::pmr::monotonic_buffer_resource arena;
+        {
+            lochfolk::virtual_file_system vfs(&arena);
+            for(const auto& p : f.paths)
+                vfs.mount_string(p, content);
+            benchmark::ClobberMemory();
+        }
+        arena.release();
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * file_count));
+}
+
+BENCHMARK(tree_build_monotonic)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Mount files in deep directories one by one (argument 0) or as a batch (argument 1)
+ *
+ * Collecting the batch is not measured, since it can be done without locking the VFS.
+ */
+void tree_build_deep(benchmark::State& state)
+{
+    const bool use_batch = state.range(0) != 0;
+
+    std::vector<lochfolk::path> paths;
+    for(std::size_t i = 0; i < 100; ++i)
+    {
+        std::string dir = "/root_" + std::to_string(i);
+        for(std::size_t depth = 0; depth < 10; ++depth)
+            dir += "/level_" + std::to_string(depth);
+        for(std::size_t k = 0; k < 1000; ++k)
+            paths.emplace_back(dir + "/file_" + std::to_string(k) + ".bin");
+    }
+
+    for(auto _ : state)
+    {
+        lochfolk::virtual_file_system vfs;
+        if(use_batch)
+        {
+            state.PauseTiming();
+            lochfolk::mount_batch batch;
+            for(const auto& p : paths)
+                batch.add_string(p, std::string(content));
+            state.ResumeTiming();
+
+            vfs.mount(batch);
+        }
+        else
+        {
+            for(const auto& p : paths)
+                vfs.mount_string(p, std::string(content));
+        }
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * paths.size()));
+}
+
+BENCHMARK(tree_build_deep)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Mount files into a single directory in random order
+ */
+void tree_build_flat(benchmark::State& state)
+{
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+
+    std::vector<lochfolk::path> paths;
+    for(std::size_t i = 0; i < count; ++i)
+        paths.emplace_back("/flat/file_" + std::to_string(i) + ".bin");
+    std::shuffle(paths.begin(), paths.end(), std::mt19937(182375));
+
+    for(auto _ : state)
+    {
+        lochfolk::virtual_file_system vfs;
+        for(const auto& p : paths)
+            vfs.mount_string(p, content);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * count));
+}
+
+BENCHMARK(tree_build_flat)->Arg(1000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Mount files whose names are too long for the small string optimization,
+ * and are repeated in every directory like the names of assets of the same kind
+ */
+void tree_build_long_names(benchmark::State& state)
+{
+    std::vector<lochfolk::path> paths;
+    for(std::size_t i = 0; i < top_dirs; ++i)
+    {
+        for(std::size_t j = 0; j < sub_dirs / 5; ++j)
+        {
+            for(std::size_t k = 0; k < files_per_dir; ++k)
+            {
+                paths.emplace_back(
+                    "/environment_props_" + std::to_string(i) +
+                    "/weathered_stone_variant_" + std::to_string(j) +
+                    "/diffuse_albedo_map_" + std::to_string(k) + ".texture"
+                );
+            }
+        }
+    }
+
+    for(auto _ : state)
+    {
+        lochfolk::virtual_file_system vfs;
+        for(const auto& p : paths)
+            vfs.mount_string(p, content);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * paths.size()));
+}
+
+BENCHMARK(tree_build_long_names)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Mount a layer hiding some files of the tree, then unmount it to restore them
+ */
+void tree_layer_toggle(benchmark::State& state)
+{
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+
+    lochfolk::virtual_file_system vfs;
+    const auto paths = make_paths();
+    for(const auto& p : paths)
+        vfs.mount_string(p, content);
+
+    for(auto _ : state)
+    {
+        const lochfolk::layer_id layer = vfs.add_layer(1);
+        for(std::size_t i = 0; i < count; ++i)
+            vfs.mount_string(layer, paths[i * (paths.size() / count)], "patched");
+        vfs.unmount_layer(layer);
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * count));
+}
+
+BENCHMARK(tree_layer_toggle)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+void tree_lookup_hit(benchmark::State& state)
+{
+    auto& f = fixture();
+
+    std::size_t i = 0;
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(f.vfs.file_size(f.shuffled[i]));
+        if(++i == f.shuffled.size())
+            i = 0;
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+    state.counters["index_bytes"] = static_cast<double>(f.vfs.path_index_memory_usage());
+}
+
+BENCHMARK(tree_lookup_hit);
+
+void tree_lookup_miss(benchmark::State& state)
+{
+    auto& f = fixture();
+
+    std::size_t i = 0;
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(f.vfs.exists(f.missing[i]));
+        if(++i == f.missing.size())
+            i = 0;
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+}
+
+BENCHMARK(tree_lookup_miss);
+
+/**
+ * @brief Look up paths relative to the current directory of an access context,
+ * by building the full paths (0) or from the cached node of the directory (1)
+ */
+void context_lookup_relative(benchmark::State& state)
+{
+    auto& f = fixture();
+    lochfolk::access_context ctx(f.vfs);
+    ctx.current_path(lochfolk::path_view("/assets_7/category_42"));
+
+    std::vector<lochfolk::path> names;
+    for(std::size_t k = 0; k < files_per_dir; ++k)
+        names.emplace_back("texture_" + std::to_string(k) + ".png");
+    std::ranges::shuffle(names, std::mt19937(182375));
+
+    const bool cached = state.range(0) != 0;
+    std::size_t i = 0;
+    for(auto _ : state)
+    {
+        if(cached)
+            benchmark::DoNotOptimize(ctx.file_size(names[i]));
+        else
+            benchmark::DoNotOptimize(f.vfs.file_size(ctx.to_fullpath(names[i])));
+        if(++i == names.size())
+            i = 0;
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+}
+
+BENCHMARK(context_lookup_relative)->Arg(0)->Arg(1);
+
+struct case_insensitive_fixture
+{
+    lochfolk::virtual_file_system vfs{lochfolk::vfs_options{.case_insensitive = true}};
+    // Paths of the fixture in upper case, in random order
+    std::vector<lochfolk::path> upper;
+
+    case_insensitive_fixture()
+    {
+        for(const auto& p : fixture().paths)
+            vfs.mount_string(p, content);
+
+        for(const auto& p : fixture().shuffled)
+        {
+            std::string str = p.string();
+            std::ranges::transform(str, str.begin(), [](char ch) { return static_cast<char>(std::toupper(ch)); });
+            upper.emplace_back(std::move(str));
+        }
+    }
+};
+
+/**
+ * @brief Look up paths spelled in another case,
+ * by lower-casing them before looking up (0) or by a case-insensitive VFS (1)
+ */
+void tree_lookup_case(benchmark::State& state)
+{
+    auto& f = fixture();
+    static case_insensitive_fixture ci;
+    const bool insensitive = state.range(0) != 0;
+
+    std::size_t i = 0;
+    for(auto _ : state)
+    {
+        if(insensitive)
+            benchmark::DoNotOptimize(ci.vfs.file_size(ci.upper[i]));
+        else
+        {
+            std::string str = ci.upper[i].string();
+            std::ranges::transform(str, str.begin(), [](char ch) { return static_cast<char>(std::tolower(ch)); });
+            benchmark::DoNotOptimize(f.vfs.file_size(lochfolk::path_view(str)));
+        }
+        if(++i == ci.upper.size())
+            i = 0;
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+}
+
+BENCHMARK(tree_lookup_case)->Arg(0)->Arg(1);
+
+void tree_freeze(benchmark::State& state)
+{
+    auto& f = fixture();
+
+    for(auto _ : state)
+    {
+        lochfolk::frozen_vfs frozen = f.vfs.freeze();
+        benchmark::DoNotOptimize(frozen.size());
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * file_count));
+}
+
+BENCHMARK(tree_freeze)->Unit(benchmark::kMillisecond);
+
+void frozen_lookup_hit(benchmark::State& state)
+{
+    auto& f = fixture();
+    const auto& frozen = frozen_fixture();
+
+    std::size_t i = 0;
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(frozen.file_size(f.shuffled[i]));
+        if(++i == f.shuffled.size())
+            i = 0;
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+    state.counters["frozen_bytes"] = benchmark::Counter(
+        static_cast<double>(frozen.memory_usage()), benchmark::Counter::kAvgThreads
+    );
+}
+
+BENCHMARK(frozen_lookup_hit)->ThreadRange(1, 8);
+
+void frozen_lookup_miss(benchmark::State& state)
+{
+    auto& f = fixture();
+    const auto& frozen = frozen_fixture();
+
+    std::size_t i = 0;
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(frozen.exists(f.missing[i]));
+        if(++i == f.missing.size())
+            i = 0;
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+}
+
+BENCHMARK(frozen_lookup_miss);
+
+/**
+ * @brief Enumerate all entries of the tree recursively, touching their names and kinds
+ */
+void tree_iterate(benchmark::State& state)
+{
+    auto& f = fixture();
+
+    std::size_t count = 0;
+    for(auto _ : state)
+    {
+        count = 0;
+        for(const auto& e : lochfolk::directory_iterator(f.vfs, lochfolk::path_view("/"), true))
+        {
+            benchmark::DoNotOptimize(e.name().size() + static_cast<std::size_t>(e.kind()));
+            ++count;
+        }
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * count));
+}
+
+BENCHMARK(tree_iterate)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Tree of the fixture with a shader in each category, so a few files have a rare extension
+ */
+struct shader_fixture
+{
+    lochfolk::virtual_file_system vfs;
+
+    shader_fixture()
+    {
+        for(const auto& p : fixture().paths)
+            vfs.mount_string(p, content);
+        for(std::size_t i = 0; i < top_dirs; ++i)
+        {
+            for(std::size_t j = 0; j < sub_dirs; ++j)
+            {
+                vfs.mount_string(
+                    lochfolk::path("/assets_" + std::to_string(i) + "/category_" + std::to_string(j) + "/lit.shader"),
+                    content
+                );
+            }
+        }
+    }
+};
+
+/**
+ * @brief Find the shaders under a top directory, by walking the tree (0) or by the extension index (1)
+ */
+void tree_glob_extension(benchmark::State& state)
+{
+    static shader_fixture f;
+    auto& vfs = f.vfs;
+    vfs.enable_extension_index(state.range(0) != 0);
+    const lochfolk::glob_pattern pattern("/assets_7/**/*.shader");
+
+    for(auto _ : state)
+    {
+        auto result = vfs.glob(pattern);
+        benchmark::DoNotOptimize(result.data());
+    }
+}
+
+BENCHMARK(tree_glob_extension)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief Match the name of every file, compared with enumerating and filtering by the client
+ */
+void tree_glob_walk(benchmark::State& state)
+{
+    auto& f = fixture();
+    const lochfolk::glob_pattern pattern("/**/texture_?7.png");
+
+    for(auto _ : state)
+    {
+        auto result = f.vfs.glob(pattern);
+        benchmark::DoNotOptimize(result.data());
+    }
+}
+
+BENCHMARK(tree_glob_walk)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Match a pattern whose literal and wildcard components prune most of the tree
+ */
+void tree_glob_pruned(benchmark::State& state)
+{
+    auto& f = fixture();
+    const lochfolk::glob_pattern pattern("/assets_1?/category_4*/texture_[0-4].png");
+
+    for(auto _ : state)
+    {
+        auto result = f.vfs.glob(pattern);
+        benchmark::DoNotOptimize(result.data());
+    }
+}
+
+BENCHMARK(tree_glob_pruned)->Unit(benchmark::kMicrosecond);
+
+void tree_list_files(benchmark::State& state)
+{
+    auto& f = fixture();
+
+    for(auto _ : state)
+    {
+        std::ostringstream ss;
+        f.vfs.list_files(ss);
+        benchmark::DoNotOptimize(ss.str().size());
+    }
+}
+
+BENCHMARK(tree_list_files)->Unit(benchmark::kMillisecond);
+} // namespace
+
+BENCHMARK_MAIN();
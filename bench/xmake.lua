@@ -0,0 +1,49 @@
+add_requires("benchmark")
+
+target("bench_archive")
+    set_warnings("all", "error")
+    set_kind("binary")
+    set_default(false)
+    add_packages("benchmark", "minizip-ng")
+    add_deps("lochfolk")
+    add_files("bench_archive.cpp")
+
+target("bench_mount")
+    set_warnings("all", "error")
+    set_kind("binary")
+    set_default(false)
+    add_packages("benchmark", "minizip-ng")
+    add_deps("lochfolk")
+    add_files("bench_mount.cpp")
+
+target("bench_codec")
+    set_warnings("all", "error")
+    set_kind("binary")
+    set_default(false)
+    add_packages("benchmark", "minizip-ng")
+    add_deps("lochfolk")
+    add_files("bench_codec.cpp")
+
+target("bench_pack")
+    set_warnings("all", "error")
+    set_kind("binary")
+    set_default(false)
+    add_packages("benchmark", "minizip-ng")
+    add_deps("lochfolk")
+    add_files("bench_pack.cpp")
+
+target("bench_tree")
+    set_warnings("all", "error")
+    set_kind("binary")
+    set_default(false)
+    add_packages("benchmark")
+    add_deps("lochfolk")
+    add_files("bench_tree.cpp")
+
+target("bench_concurrency")
+    set_warnings("all", "error")
+    set_kind("binary")
+    set_default(false)
+    add_packages("benchmark", "minizip-ng")
+    add_deps("lochfolk")
+    add_files("bench_concurrency.cpp")
@@ -3,8 +3,18 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <ios>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <stdexcept>
+#include <string_view>
+#include <vector>
 #include <filesystem>
 #include "detail/config.hpp"
 #include "path.hpp"
@@ -15,8 +25,349 @@ namespace lochfolk
 namespace detail
 {
     class file_node;
+    struct file_tree;
 } // namespace detail
 
+class frozen_vfs;
+
+/**
+ * @brief Identifier of a layer of overlay mounts
+ */
+enum class layer_id : std::uint32_t
+{
+};
+
+/**
+ * @brief Layer targeted by mounting functions without a layer
+ */
+inline constexpr layer_id base_layer = layer_id(0);
+
+/**
+ * @brief Options for mounting an archive
+ */
+struct archive_options
+{
+    /**
+     * @brief Map the archive into memory
+     *
+     * Stored (uncompressed) entries will be read directly from the mapped memory without copying.
+     * Their views from `view_bytes` are invalidated when the archive is unmapped,
+     * i.e. all of its files are removed or overwritten and none of its streams is left.
+     */
+    bool memory_map = false;
+
+    /**
+     * @brief Spacing of inflate checkpoints in uncompressed bytes, zero to disable
+     *
+     * Streams of deflated entries larger than this value record checkpoints when decompressing,
+     * so later seeks resume from the nearest one instead of decompressing from the beginning.
+     */
+    std::uint64_t checkpoint_interval = 0;
+
+    /**
+     * @brief Maximum memory used by inflate checkpoints of the archive
+     *
+     * Each checkpoint holds a window of 32 KiB.
+     */
+    std::uint64_t checkpoint_memory_limit = 16 * 1024 * 1024;
+
+    /**
+     * @brief Create the nodes of a directory only when it is accessed for the first time
+     *
+     * A single placeholder is created at the mount point, so mounting a large archive costs almost nothing
+     * besides reading its central directory.
+     *
+     * @note Accessing a directory of a lazily mounted archive modifies the tree.
+     *       Such a lookup takes the lock of the VFS exclusively for materializing the directory.
+     */
+    bool lazy = false;
+};
+
+/**
+ * @brief Source of an archive for batch mounting
+ */
+struct archive_source
+{
+    path_view mount_point;
+    std::filesystem::path sys_path;
+};
+
+/**
+ * @brief Encoding of a file in a pack
+ */
+enum class pack_encoding : std::uint8_t
+{
+    raw = 0,
+    lz4 = 1,
+    zstd = 2
+};
+
+/**
+ * @brief Options for writing a pack
+ */
+struct pack_options
+{
+    /**
+     * @brief Preferred encoding of files
+     *
+     * A file is stored raw if encoding does not make it smaller.
+     */
+    pack_encoding encoding = pack_encoding::zstd;
+
+    /**
+     * @brief Compression level of zstd, zero for the default level. Ignored by other encodings.
+     */
+    int level = 0;
+
+    /**
+     * @brief Alignment of file data in bytes, must be a power of two
+     *
+     * Files not smaller than the alignment start at an aligned offset.
+     * Smaller files are packed tightly but never cross an alignment boundary.
+     */
+    std::uint32_t alignment = 4096;
+
+    /**
+     * @brief Split encoded files larger than this size into independently encoded blocks, zero to disable
+     *
+     * Blocks of a large file are decoded in parallel when it is read as a whole.
+     */
+    std::uint32_t chunk_size = 4 * 1024 * 1024;
+
+    /**
+     * @brief Paths of files in the order they are expected to be accessed
+     *
+     * Their data are laid out first in this order, followed by the other files in path order.
+     * Paths not found in the packed directory are ignored.
+     */
+    std::span<const path> access_order = {};
+};
+
+/**
+ * @brief Options of a VFS fixed on construction
+ */
+struct vfs_options
+{
+    /**
+     * @brief Resource allocating the tree, null for the default resource
+     *
+     * @see virtual_file_system(std::pmr::memory_resource*)
+     */
+    std::pmr::memory_resource* memory_resource = nullptr;
+
+    /**
+     * @brief Look up names ignoring the case of ASCII letters
+     *
+     * Names are keyed by their case-folded forms, which are computed once when the nodes are created,
+     * so lookups stay allocation-free. Listings and enumerations show the spelling of the name that created a node;
+     * mounting a file over an existing one with another spelling keeps the existing spelling.
+     * Other characters, including non-ASCII ones, are compared exactly.
+     */
+    bool case_insensitive = false;
+};
+
+/**
+ * @brief Persistent cache of directory listings and archive indices for skipping enumeration at startup
+ *
+ * Mounting a directory or an archive with a manifest looks up the record of its absolute system path.
+ * A directory record is still valid if the modification times of all of its directories are unchanged,
+ * so only the directories are checked instead of iterating every file.
+ * An archive record is still valid if the size, the modification time and the CRC-32 of the tail of the archive
+ * (where the central directory ends) are unchanged, so its central directory is not read.
+ * Otherwise the source is enumerated as usual and its record is refreshed.
+ *
+ * @note A manifest must not be used by multiple threads at the same time.
+ *       Changes made within the timestamp resolution of the file system may go unnoticed.
+ */
+class mount_manifest
+{
+    struct manifest_data;
+
+public:
+    LOCHFOLK_API mount_manifest();
+    LOCHFOLK_API mount_manifest(mount_manifest&& other) noexcept;
+    mount_manifest(const mount_manifest&) = delete;
+
+    LOCHFOLK_API ~mount_manifest();
+
+    LOCHFOLK_API mount_manifest& operator=(mount_manifest&& rhs) noexcept;
+
+    /**
+     * @brief Replace the records by a manifest saved by `save`
+     *
+     * @return False if the file does not exist or is not a valid manifest, leaving this manifest empty
+     */
+    LOCHFOLK_API bool load(const std::filesystem::path& sys_path);
+
+    /**
+     * @brief Write all records into a file
+     *
+     * The file is replaced at once after the manifest is completely written.
+     */
+    LOCHFOLK_API void save(const std::filesystem::path& sys_path) const;
+
+    LOCHFOLK_API void clear() noexcept;
+
+    /**
+     * @brief Number of recorded directories and archives
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::size_t size() const noexcept;
+
+    /**
+     * @brief Number of sources mounted from valid records since construction
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::size_t hits() const noexcept;
+
+    /**
+     * @brief Number of sources enumerated and recorded since construction
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::size_t misses() const noexcept;
+
+private:
+    friend class mount_batch;
+    friend class virtual_file_system;
+
+    manifest_data* m_data;
+};
+
+/**
+ * @brief Files to be mounted together by `virtual_file_system::mount`
+ *
+ * Adding files only collects them, so system files and archives are scanned without locking any VFS.
+ * Mounting sorts them by directory, creates each directory once and inserts the files of a directory together,
+ * so it scales with the number of files rather than the number of files times their depth.
+ */
+class mount_batch
+{
+    struct batch_data;
+
+public:
+    LOCHFOLK_API mount_batch();
+    LOCHFOLK_API mount_batch(mount_batch&& other) noexcept;
+    mount_batch(const mount_batch&) = delete;
+
+    LOCHFOLK_API ~mount_batch();
+
+    LOCHFOLK_API mount_batch& operator=(mount_batch&& rhs) noexcept;
+
+    LOCHFOLK_API void add_string(path_view p, std::string str);
+
+    LOCHFOLK_API void add_file(path_view p, const std::filesystem::path& sys_path);
+
+    /**
+     * @brief Add the files of a directory recursively
+     *
+     * @param dir Must be a directory
+     */
+    LOCHFOLK_API void add_dir(path_view p, const std::filesystem::path& dir);
+
+    /**
+     * @brief Add the files of a directory recursively, listing them from a manifest if its record is still valid
+     *
+     * @note Names of files are relative to the directory without resolving symbolic links
+     */
+    LOCHFOLK_API void add_dir(path_view p, const std::filesystem::path& dir, mount_manifest& manifest);
+
+    /**
+     * @brief Open an archive and add its entries
+     *
+     * @note The `lazy` option is ignored
+     */
+    LOCHFOLK_API void add_archive(
+        path_view p,
+        const std::filesystem::path& sys_path,
+        const archive_options& opts = {}
+    );
+
+    /**
+     * @brief Open an archive and add its entries, indexing it from a manifest if its record is still valid
+     *
+     * @note The `lazy` option is ignored
+     */
+    LOCHFOLK_API void add_archive(
+        path_view p,
+        const std::filesystem::path& sys_path,
+        mount_manifest& manifest,
+        const archive_options& opts = {}
+    );
+
+    /**
+     * @brief Number of files added
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::size_t size() const noexcept;
+
+private:
+    friend class virtual_file_system;
+
+    batch_data* m_data;
+};
+
+/**
+ * @brief Glob pattern compiled for matching paths of a VFS
+ *
+ * A pattern is an absolute path whose components may contain wildcards:
+ * `*` matches any characters, `?` matches one character, and a character class like `[abc]`, `[a-z]` or `[!0-9]`
+ * matches one of its characters. A component of `**` matches zero or more levels of directories.
+ * Wildcards never match a separator, and a backslash escapes the next character.
+ *
+ * Components without wildcards are looked up by name instead of being compared with every child,
+ * and a subtree is skipped once no component can match inside it.
+ */
+class glob_pattern
+{
+    struct pattern_data;
+
+public:
+    /**
+     * @brief Compile a pattern
+     *
+     * @exception virtual_file_system::error The pattern is not absolute, or a character class is not closed
+     */
+    LOCHFOLK_API explicit glob_pattern(std::string_view pattern);
+    LOCHFOLK_API glob_pattern(glob_pattern&& other) noexcept;
+    glob_pattern(const glob_pattern&) = delete;
+
+    LOCHFOLK_API ~glob_pattern();
+
+    LOCHFOLK_API glob_pattern& operator=(glob_pattern&& rhs) noexcept;
+
+    /**
+     * @brief Check if a normalized absolute path matches the pattern without looking up any VFS
+     */
+    [[nodiscard]]
+    LOCHFOLK_API bool match(path_view p) const;
+
+    /**
+     * @brief Source of the pattern
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::string_view str() const noexcept;
+
+private:
+    friend class virtual_file_system;
+
+    pattern_data* m_data;
+};
+
+/**
+ * @brief Virtual file system
+ *
+ * All member functions are thread-safe. Lookups (`exists`, `open`, `read_string`, etc.) run concurrently
+ * under a shared lock. Mounting and removing hold the lock exclusively, so a concurrent lookup sees the tree
+ * either before or after a mount call, never in the middle of it. A mount call that throws is not rolled back,
+ * so the files it mounted before the error stay mounted and are visible afterwards.
+ * Files and archives are opened before taking the lock, so lookups are only blocked while the nodes are being inserted.
+ *
+ * @note Streams of archives and packs keep them alive, and streams of owned string constants read copies of them.
+ *       Only the following results borrow data that the VFS does not keep alive for them:
+ *       - Views returned by `view_bytes` of any kind of file. See `view_bytes` for how long they are valid.
+ *       - Streams of string constants mounted from a `std::string_view`, which read the buffer of the caller.
+ *       Invalidating them while another thread uses them is undefined behavior.
+ */
 class virtual_file_system
 {
     struct vfs_data;
@@ -29,6 +380,17 @@ public:
     };
 
     LOCHFOLK_API virtual_file_system();
+    /**
+     * @brief Construct a VFS allocating its tree from a memory resource
+     *
+     * Nodes, directory containers, names, the path index and the internal data of the VFS are allocated from it.
+     * File contents and archives are not. The resource must outlive the VFS.
+     * It is only used while the tree is locked exclusively, so an unsynchronized resource is fine.
+     *
+     * @param mr Null for the default resource
+     */
+    LOCHFOLK_API explicit virtual_file_system(std::pmr::memory_resource* mr);
+    LOCHFOLK_API explicit virtual_file_system(const vfs_options& opts);
     LOCHFOLK_API virtual_file_system(const virtual_file_system&) = delete;
 
     LOCHFOLK_API ~virtual_file_system();
@@ -58,9 +420,213 @@ public:
     );
 
     LOCHFOLK_API void mount_archive(
-        path_view p, const std::filesystem::path& sys_path, bool overwrite = true
+        path_view p,
+        const std::filesystem::path& sys_path,
+        bool overwrite = true,
+        const archive_options& opts = {}
     );
 
+    /**
+     * @brief Recursively mount a directory, listing its files from a manifest if its record is still valid
+     *
+     * @see mount_manifest
+     */
+    LOCHFOLK_API void mount_dir(
+        path_view p,
+        const std::filesystem::path& dir,
+        mount_manifest& manifest,
+        bool overwrite = true
+    );
+
+    /**
+     * @brief Mount an archive, indexing it from a manifest if its record is still valid
+     *
+     * @see mount_manifest
+     */
+    LOCHFOLK_API void mount_archive(
+        path_view p,
+        const std::filesystem::path& sys_path,
+        mount_manifest& manifest,
+        bool overwrite = true,
+        const archive_options& opts = {}
+    );
+
+    /**
+     * @brief Mount an archive in memory
+     *
+     * @param data Content of the archive. It must be kept alive until all of its entries are removed.
+     *
+     * @note Stored entries can be viewed by `view_bytes` without copying. The `memory_map` option is ignored.
+     */
+    LOCHFOLK_API void mount_archive(
+        path_view p,
+        std::span<const std::byte> data,
+        bool overwrite = true,
+        const archive_options& opts = {}
+    );
+
+    /**
+     * @brief Mount an archive in memory, taking the ownership of the buffer
+     *
+     * The buffer is freed when all files of the archive are removed or overwritten and none of its streams is left,
+     * which invalidates the views of its stored entries from `view_bytes`.
+     *
+     * @note Only an rvalue is accepted, so an lvalue vector is mounted by the overload viewing it instead of being copied.
+     */
+    LOCHFOLK_API void mount_archive(
+        path_view p,
+        std::vector<std::byte>&& data,
+        bool overwrite = true,
+        const archive_options& opts = {}
+    );
+
+    /**
+     * @brief Mount an archive that is a file of this virtual file system, e.g. a ZIP inside a ZIP
+     *
+     * @param archive_path Path of the archive file in this virtual file system
+     *
+     * @note A stored inner archive is read directly from the outer archive without decompression.
+     *       A compressed inner archive is decompressed into memory once.
+     */
+    LOCHFOLK_API void mount_nested_archive(
+        path_view p,
+        path_view archive_path,
+        bool overwrite = true,
+        const archive_options& opts = {}
+    );
+
+    /**
+     * @brief Mount many archives, opening and indexing them on the calling thread and the shared worker threads
+     *
+     * The result is the same as calling `mount_archive` for each of them in order,
+     * i.e. later archives overwrite earlier ones if `overwrite` is true.
+     * If an archive fails to open, the archives before it are mounted and the error is rethrown.
+     *
+     * @param max_threads Maximum number of threads opening archives, including the calling thread.
+     *                    Zero for the number of hardware threads.
+     */
+    LOCHFOLK_API void mount_archives(
+        std::span<const archive_source> archives,
+        bool overwrite = true,
+        const archive_options& opts = {},
+        unsigned int max_threads = 0
+    );
+
+    /**
+     * @brief Mount a pack of the native format
+     *
+     * The pack is memory-mapped, and only its header and index are validated.
+     * Raw files can be viewed by `view_bytes` without copying. The views are invalidated when the pack is unmapped,
+     * i.e. all of its files are removed or overwritten and none of its streams is left.
+     *
+     * @param max_threads Maximum number of threads decoding the blocks of a chunked file.
+     *                    Zero for the number of hardware threads.
+     */
+    LOCHFOLK_API void mount_pack(
+        path_view p,
+        const std::filesystem::path& sys_path,
+        bool overwrite = true,
+        unsigned int max_threads = 0
+    );
+
+    /**
+     * @brief Mount the files of a batch
+     *
+     * The result is the same as mounting them one by one, except that a file and a directory
+     * at the same path conflict regardless of their order. Files added to the same path are mounted in order.
+     *
+     * Without layers, conflicts are checked before anything is mounted, so a batch that throws leaves the tree
+     * and the batch unchanged. With layers, files are mounted one by one and those before a conflict stay mounted.
+     *
+     * @param batch Its files are moved into the tree, leaving it empty
+     */
+    LOCHFOLK_API void mount(mount_batch& batch, bool overwrite = true);
+
+    LOCHFOLK_API void mount(layer_id layer, mount_batch& batch, bool overwrite = true);
+
+    /**
+     * @brief Add a layer of overlay mounts
+     *
+     * A file mounted into a layer hides the files at the same path in lower layers without destroying them,
+     * so they are restored when the layer is unmounted. Lookups see the resolved tree, and cost the same as without layers.
+     * Layers of the same priority are ordered by creation, the later one being higher.
+     * The base layer has priority 0. The `overwrite` argument of mounting functions only applies within a layer.
+     *
+     * @note Layers work at the granularity of files. Mounting a file where another layer has a directory,
+     *       or the other way around, throws an error.
+     */
+    [[nodiscard]]
+    LOCHFOLK_API layer_id add_layer(int priority = 0);
+
+    /**
+     * @brief Remove all files mounted into a layer, restoring the files of lower layers hidden by them
+     *
+     * Directories left empty are removed.
+     *
+     * @return False if the layer does not exist or has been unmounted. The base layer cannot be unmounted.
+     */
+    LOCHFOLK_API bool unmount_layer(layer_id layer);
+
+    LOCHFOLK_API void mount_string(
+        layer_id layer, path_view p, std::string_view str, bool overwrite = true
+    );
+    LOCHFOLK_API void mount_string(
+        layer_id layer, path_view p, const char* str, bool overwrite = true
+    );
+    LOCHFOLK_API void mount_string(
+        layer_id layer, path_view p, std::string str, bool overwrite = true
+    );
+
+    LOCHFOLK_API void mount_file(
+        layer_id layer, path_view p, const std::filesystem::path& sys_path, bool overwrite = true
+    );
+
+    LOCHFOLK_API void mount_dir(
+        layer_id layer, path_view p, const std::filesystem::path& dir, bool overwrite = true
+    );
+
+    /**
+     * @brief Mount an archive into a layer
+     *
+     * @note The `lazy` option is ignored unless the archive is mounted into the base layer without other layers,
+     *       because entries of a layer are tracked individually.
+     */
+    LOCHFOLK_API void mount_archive(
+        layer_id layer,
+        path_view p,
+        const std::filesystem::path& sys_path,
+        bool overwrite = true,
+        const archive_options& opts = {}
+    );
+
+    LOCHFOLK_API void mount_dir(
+        layer_id layer,
+        path_view p,
+        const std::filesystem::path& dir,
+        mount_manifest& manifest,
+        bool overwrite = true
+    );
+
+    LOCHFOLK_API void mount_archive(
+        layer_id layer,
+        path_view p,
+        const std::filesystem::path& sys_path,
+        mount_manifest& manifest,
+        bool overwrite = true,
+        const archive_options& opts = {}
+    );
+
+    /**
+     * @brief Write a directory of this virtual file system into a pack of the native format
+     *
+     * @param dir Directory to be packed. Paths in the pack are relative to it.
+     */
+    LOCHFOLK_API void write_pack(
+        path_view dir,
+        const std::filesystem::path& sys_path,
+        const pack_options& opts = {}
+    ) const;
+
     [[nodiscard]]
     LOCHFOLK_API bool exists(path_view p) const;
 
@@ -85,15 +651,332 @@ public:
     [[nodiscard]]
     LOCHFOLK_API std::string read_string(path_view p, bool convert_crlf = true);
 
+    /**
+     * @brief Get a view of the file content if it is available in memory without copying
+     *
+     * @return `std::nullopt` if the content of this file must be read or decompressed
+     *
+     * @note The view borrows the data of the file. A view of a string constant is valid until the file is removed
+     *       or overwritten, or for a `std::string_view` constant, until the buffer of the caller is released.
+     *       A view of an archive entry or a pack file is valid until the archive or pack is released,
+     *       i.e. all of its files are removed or overwritten and none of its streams is left.
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::optional<std::span<const std::byte>> view_bytes(path_view p) const;
+
+    /**
+     * @brief Estimated memory used by the index of full paths in bytes
+     *
+     * @return Zero if the index is disabled by `LOCHFOLK_NO_PATH_INDEX`
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::size_t path_index_memory_usage() const noexcept;
+
+    /**
+     * @brief Find the files and directories matching a pattern
+     *
+     * A pattern made of literal directories, a `**` component and a last component of `*` followed by an extension
+     * (e.g. `*.shader`) is answered by the extension index without walking the tree if the index is enabled and complete.
+     *
+     * @return Normalized paths of the matches except the root, in no particular order
+     *
+     * @note Directories of lazily mounted archives are materialized when the walk reaches them
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::vector<path> glob(const glob_pattern& pattern) const;
+
+    [[nodiscard]]
+    LOCHFOLK_API std::vector<path> glob(std::string_view pattern) const;
+
+    /**
+     * @brief Enable or disable the secondary index from extensions to full paths
+     *
+     * Once enabled, it is updated by mounting and removing along with the index of full paths,
+     * and its memory is counted by `path_index_memory_usage`. An extension is the part of a name from its last dot.
+     *
+     * @note It has no effect if the index of full paths is disabled by `LOCHFOLK_NO_PATH_INDEX`.
+     *       Like the index of full paths, it does not cover directories of lazily mounted archives,
+     *       so `glob` walks the tree after mounting an archive lazily.
+     */
+    LOCHFOLK_API void enable_extension_index(bool enable = true);
+
+    /**
+     * @brief True if names are looked up ignoring the case of ASCII letters
+     */
+    [[nodiscard]]
+    LOCHFOLK_API bool case_insensitive() const noexcept;
+
+    /**
+     * @brief Memory resource allocating the tree
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::pmr::memory_resource* get_memory_resource() const noexcept;
+
     /**
      * @brief List all files for debugging
      */
     LOCHFOLK_API void list_files(std::ostream& os);
 
+    /**
+     * @brief Compile the current tree into an immutable snapshot for fast lookups
+     *
+     * Directories of lazily mounted archives are materialized. Later changes of this VFS do not affect the snapshot.
+     */
+    [[nodiscard]]
+    LOCHFOLK_API frozen_vfs freeze() const;
+
 private:
+    friend class directory_entry;
+    friend class directory_iterator;
+    friend class access_context;
+
     vfs_data* m_vfs_data;
 };
 
+/**
+ * @brief Immutable snapshot of a VFS, compiled for fast lookups
+ *
+ * Full paths are looked up by a perfect hash whose slots are the nodes, so a lookup reads one seed and one node.
+ * Children of a directory are stored contiguously in name order. Files keep their backends,
+ * i.e. string constants, system files and archive entries, without referring to the original VFS.
+ *
+ * @note All member functions are thread-safe without locking
+ */
+class frozen_vfs
+{
+    struct frozen_data;
+
+public:
+    frozen_vfs() = delete;
+    LOCHFOLK_API frozen_vfs(frozen_vfs&& other) noexcept;
+    frozen_vfs(const frozen_vfs&) = delete;
+
+    LOCHFOLK_API ~frozen_vfs();
+
+    LOCHFOLK_API frozen_vfs& operator=(frozen_vfs&& rhs) noexcept;
+
+    [[nodiscard]]
+    LOCHFOLK_API bool exists(path_view p) const;
+
+    [[nodiscard]]
+    LOCHFOLK_API bool is_directory(path_view p) const;
+
+    [[nodiscard]]
+    LOCHFOLK_API std::uint64_t file_size(path_view p) const;
+
+    LOCHFOLK_API ivfstream open(
+        path_view p, std::ios_base::openmode mode = std::ios_base::binary
+    ) const;
+
+    LOCHFOLK_API std::string read_string(
+        path_view p, bool convert_crlf = true
+    ) const;
+
+    /**
+     * @brief Get a view of the file content if it is available in memory without copying
+     *
+     * @return `std::nullopt` if the content of this file must be read or decompressed
+     *
+     * @note The view is valid until the snapshot is destroyed
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::optional<std::span<const std::byte>> view_bytes(path_view p) const;
+
+    /**
+     * @brief Number of files and directories, including the root
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::size_t size() const noexcept;
+
+    /**
+     * @brief Estimated heap memory used by the snapshot in bytes, excluding file contents and archives
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::size_t memory_usage() const noexcept;
+
+    /**
+     * @brief List all files for debugging, in the same format as `virtual_file_system::list_files`
+     */
+    LOCHFOLK_API void list_files(std::ostream& os) const;
+
+private:
+    friend class virtual_file_system;
+
+    explicit frozen_vfs(const detail::file_tree& tree);
+
+    frozen_data* m_data;
+};
+
+/**
+ * @brief Kind of a node in the tree
+ */
+enum class file_kind : std::uint8_t
+{
+    directory,
+    string_constant,
+    sys_file,
+    archive_entry
+};
+
+/**
+ * @brief Node visited by a `directory_iterator`
+ *
+ * @note It is only valid until the iterator is incremented
+ */
+class directory_entry
+{
+public:
+    [[nodiscard]]
+    std::string_view name() const noexcept
+    {
+        return m_name;
+    }
+
+    /**
+     * @brief Normalized full path, a view of a buffer reused by the iterator
+     */
+    [[nodiscard]]
+    path_view path() const noexcept
+    {
+        return path_view(m_path);
+    }
+
+    [[nodiscard]]
+    file_kind kind() const noexcept
+    {
+        return m_kind;
+    }
+
+    [[nodiscard]]
+    bool is_directory() const noexcept
+    {
+        return m_kind == file_kind::directory;
+    }
+
+    /**
+     * @brief Size of the file, zero for a directory
+     *
+     * @note The size of a system file is queried from the system
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::uint64_t file_size() const;
+
+    /**
+     * @brief Open the file, without looking up its path again unless the VFS has changed since it was listed
+     */
+    LOCHFOLK_API ivfstream open(std::ios_base::openmode mode = std::ios_base::binary) const;
+
+    [[nodiscard]]
+    LOCHFOLK_API std::string read_string(bool convert_crlf = true) const;
+
+private:
+    friend class directory_iterator;
+
+    /**
+     * @brief Call a function with the node of the entry while the tree of the VFS is locked
+     *
+     * The node is looked up by the path if the VFS has changed since the entry was listed.
+     */
+    template <typename Fn>
+    decltype(auto) with_node(Fn&& fn) const;
+
+    const virtual_file_system* m_vfs = nullptr;
+    // Node of the entry, valid while the generation of the VFS equals `m_generation`
+    const detail::file_node* m_node = nullptr;
+    std::uint64_t m_generation = 0;
+    std::string_view m_name;
+    std::string_view m_path;
+    file_kind m_kind = file_kind::directory;
+};
+
+/**
+ * @brief Iterator over the children of a directory of a VFS, optionally recursive
+ *
+ * Entries are listed in no particular order. The names of a directory are copied into one buffer,
+ * and full paths are built in a single buffer, so no memory is allocated per entry.
+ * A recursive iteration visits a directory before its children.
+ * Copies of an iterator share the same position, like the iterators of `std::filesystem`.
+ *
+ * The VFS is not kept locked between increments. The children of a directory are listed under a short lock
+ * when the iteration enters it, so the VFS can be used and changed during the iteration.
+ * Changes are not seen by directories already listed. A directory removed before the iteration enters it is skipped.
+ */
+class directory_iterator
+{
+    struct iterator_data;
+
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = directory_entry;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const directory_entry*;
+    using reference = const directory_entry&;
+
+    /**
+     * @brief The end iterator
+     */
+    directory_iterator() noexcept = default;
+
+    /**
+     * @param dir Must be a directory
+     * @param recursive Enumerate the descendants of subdirectories, too
+     */
+    LOCHFOLK_API directory_iterator(const virtual_file_system& vfs, path_view dir, bool recursive = false);
+
+    [[nodiscard]]
+    LOCHFOLK_API const directory_entry& operator*() const noexcept;
+
+    [[nodiscard]]
+    const directory_entry* operator->() const noexcept
+    {
+        return &**this;
+    }
+
+    LOCHFOLK_API directory_iterator& operator++();
+
+    /**
+     * @brief Depth of the current entry relative to the iterated directory, zero for its children
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::size_t depth() const noexcept;
+
+    /**
+     * @brief Skip the descendants of the current entry in a recursive iteration
+     */
+    LOCHFOLK_API void disable_recursion_pending() noexcept;
+
+    [[nodiscard]]
+    bool operator==(const directory_iterator& rhs) const noexcept
+    {
+        return m_data == rhs.m_data;
+    }
+
+private:
+    std::shared_ptr<iterator_data> m_data;
+};
+
+[[nodiscard]]
+inline directory_iterator begin(directory_iterator it) noexcept
+{
+    return it;
+}
+
+[[nodiscard]]
+inline directory_iterator end(const directory_iterator&) noexcept
+{
+    return directory_iterator();
+}
+
+/**
+ * @brief Accessing a VFS by paths relative to a current directory
+ *
+ * The node of the current directory is cached until the VFS is mounted into or removed from,
+ * so a relative path is looked up from it without building the full path.
+ * Absolute paths and paths going up after a name (e.g. `a/../b`) are looked up by their full paths.
+ *
+ * @note Const member functions can be called by multiple threads at the same time, because the cache is updated atomically.
+ *       Changing the current directory must not overlap with other calls.
+ */
 class access_context
 {
 public:
@@ -122,22 +1005,13 @@ public:
     }
 
     [[nodiscard]]
-    bool exists(path_view p) const
-    {
-        return m_vfs->exists(to_fullpath(p));
-    }
+    LOCHFOLK_API bool exists(path_view p) const;
 
     [[nodiscard]]
-    bool is_directory(path_view p) const
-    {
-        return m_vfs->is_directory(to_fullpath(p));
-    }
+    LOCHFOLK_API bool is_directory(path_view p) const;
 
     [[nodiscard]]
-    std::uint64_t file_size(path_view p) const
-    {
-        return m_vfs->file_size(to_fullpath(p));
-    }
+    LOCHFOLK_API std::uint64_t file_size(path_view p) const;
 
     bool remove(path_view p) const
     {
@@ -145,24 +1019,39 @@ public:
     }
 
     [[nodiscard]]
-    ivfstream open(
+    LOCHFOLK_API ivfstream open(
         path_view p, std::ios_base::openmode mode = std::ios_base::binary
-    ) const
-    {
-        return m_vfs->open(to_fullpath(p), mode);
-    }
+    ) const;
 
     [[nodiscard]]
-    std::string read_string(
+    LOCHFOLK_API std::string read_string(
         path_view p, bool convert_crlf = true
-    )
-    {
-        return m_vfs->read_string(to_fullpath(p), convert_crlf);
-    }
+    );
+
+    /**
+     * @brief Same as `virtual_file_system::view_bytes`, including how long the view is valid
+     */
+    [[nodiscard]]
+    LOCHFOLK_API std::optional<std::span<const std::byte>> view_bytes(path_view p) const;
 
 private:
+    /**
+     * @brief Call a function with the node of a path (null if not found) while the tree of the VFS is locked
+     */
+    template <typename Fn>
+    decltype(auto) with_node(path_view p, Fn&& fn) const;
+
+    /**
+     * @brief Find the node of a path while the tree of the VFS is locked, refreshing the cached node if necessary
+     */
+    const detail::file_node* find_node(path_view p, bool* blocked) const;
+
     virtual_file_system* m_vfs;
     path m_current;
+    // Node of the current directory (null if not found), valid while the generation of the VFS equals `m_generation`.
+    // The node is stored before the generation is released, so a thread acquiring a generation sees its node.
+    mutable std::atomic<const detail::file_node*> m_dir = nullptr;
+    mutable std::atomic_uint64_t m_generation = 0;
 };
 } // namespace lochfolk
 
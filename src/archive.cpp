@@ -3,9 +3,15 @@
 #include <span>
 #include <filesystem>
 #include <sstream>
+#include <algorithm>
+#include <limits>
+#include <lochfolk/utility.hpp>
+#include <zlib.h>
 #include <minizip/mz.h>
+#include <minizip/mz_strm.h>
 #include <minizip/mz_zip.h>
 #include <minizip/mz_strm_os.h>
+#include <minizip/mz_strm_mem.h>
 
 namespace lochfolk
 {
@@ -14,15 +20,23 @@ archive::archive() = default;
 archive::~archive() = default;
 
 std::unique_ptr<std::streambuf> archive::getbuf(
-    std::int64_t offset, std::ios_base::openmode mode
+    std::size_t idx, std::ios_base::openmode mode
 ) const
 {
     mode &= ~std::ios_base::out;
     return std::make_unique<std::stringbuf>(
-        read_string(offset), mode
+        read_string(idx), mode
     );
 }
 
+std::optional<std::span<const std::byte>> archive::view_bytes(
+    std::size_t idx
+) const
+{
+    (void)idx;
+    return std::nullopt;
+}
+
 namespace detail
 {
     const mz_zip_file& get_entry_info(void* handle)
@@ -39,6 +53,9 @@ namespace detail
 zip_archive::minizip_error::minizip_error(std::int32_t err)
     : runtime_error(translate_error(err)), m_err(err) {}
 
+zip_archive::minizip_error::minizip_error(std::int32_t err, std::string_view msg)
+    : runtime_error(std::string(msg) + ": " + translate_error(err)), m_err(err) {}
+
 std::string zip_archive::minizip_error::translate_error(std::int32_t err)
 {
 #define LOCHFOLK_TRANSLATE_MZ_ERROR(name) \
@@ -79,82 +96,1035 @@ std::string zip_archive::minizip_error::translate_error(std::int32_t err)
 #undef LOCHFOLK_TRANSLATE_MZ_ERROR
 }
 
-zip_archive::zip_archive()
-    : m_handle(mz_zip_create()),
-      m_stream(mz_stream_os_create())
+std::string zip_archive::compression_method_name(std::uint16_t method)
+{
+    switch(method)
+    {
+    case MZ_COMPRESS_METHOD_STORE: return "store";
+    case MZ_COMPRESS_METHOD_DEFLATE: return "deflate";
+    case MZ_COMPRESS_METHOD_BZIP2: return "bzip2";
+    case MZ_COMPRESS_METHOD_LZMA: return "lzma";
+    case MZ_COMPRESS_METHOD_ZSTD: return "zstd";
+    case MZ_COMPRESS_METHOD_XZ: return "xz";
+    case MZ_COMPRESS_METHOD_AES: return "aes";
+
+    [[unlikely]] default:
+        return "method(" + std::to_string(method) + ')';
+    }
+}
+
+zip_archive::reader::reader()
+    : handle(mz_zip_create())
 {}
 
+zip_archive::reader::~reader()
+{
+    close();
+    handle.reset();
+    stream.reset();
+}
+
+void zip_archive::reader::open(const std::filesystem::path& sys_path)
+{
+    close();
+
+    stream.reset(mz_stream_os_create());
+    std::int32_t err = mz_stream_os_open(
+        stream.get(),
+        reinterpret_cast<const char*>(sys_path.u8string().c_str()),
+        MZ_OPEN_MODE_READ
+    );
+    if(err != MZ_OK)
+    {
+        stream.reset();
+        throw minizip_error(err);
+    }
+
+    err = mz_zip_open(handle.get(), stream.get(), MZ_OPEN_MODE_READ);
+    if(err != MZ_OK)
+    {
+        close();
+        throw minizip_error(err);
+    }
+}
+
+void zip_archive::reader::open(std::span<const std::byte> data)
+{
+    if(data.size() > static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max()))
+        throw minizip_error(MZ_PARAM_ERROR); // Memory stream of minizip uses 32-bit size
+
+    close();
+
+    stream.reset(mz_stream_mem_create());
+    mz_stream_mem_set_buffer(
+        stream.get(),
+        const_cast<std::byte*>(data.data()),
+        static_cast<std::int32_t>(data.size())
+    );
+    std::int32_t err = mz_stream_mem_open(stream.get(), nullptr, MZ_OPEN_MODE_READ);
+    if(err != MZ_OK)
+    {
+        stream.reset();
+        throw minizip_error(err);
+    }
+
+    err = mz_zip_open(handle.get(), stream.get(), MZ_OPEN_MODE_READ);
+    if(err != MZ_OK)
+    {
+        close();
+        throw minizip_error(err);
+    }
+}
+
+void zip_archive::reader::close() noexcept
+{
+    if(!handle || !stream)
+        return;
+    mz_zip_close(handle.get());
+    mz_stream_close(stream.get());
+    stream.reset();
+}
+
+void zip_archive::reader::goto_entry(std::int64_t offset)
+{
+    std::int32_t err = mz_zip_goto_entry(handle.get(), offset);
+    if(err != MZ_OK)
+        throw minizip_error(err);
+}
+
+void zip_archive::reader::open_entry()
+{
+    std::int32_t err = mz_zip_entry_read_open(handle.get(), false, nullptr);
+    if(err == MZ_SUPPORT_ERROR)
+    {
+        // The codec is not built into minizip
+        const auto& info = detail::get_entry_info(handle.get());
+        throw minizip_error(
+            err,
+            "unsupported compression method \"" + compression_method_name(info.compression_method) + '"'
+        );
+    }
+    else if(err != MZ_OK)
+        throw minizip_error(err);
+}
+
+void zip_archive::reader::close_entry() noexcept
+{
+    mz_zip_entry_close(handle.get());
+}
+
+std::size_t zip_archive::reader::read_entry(std::span<std::byte> buf)
+{
+    constexpr std::size_t max_read = std::numeric_limits<std::int32_t>::max();
+
+    std::size_t total = 0;
+    while(total < buf.size())
+    {
+        std::int32_t result = mz_zip_entry_read(
+            handle.get(),
+            buf.data() + total,
+            static_cast<std::int32_t>(std::min(buf.size() - total, max_read))
+        );
+        if(result < 0)
+            throw minizip_error(result);
+        if(result == 0)
+            break;
+
+        total += static_cast<std::size_t>(result);
+    }
+
+    return total;
+}
+
+std::size_t zip_archive::reader::read_raw(std::int64_t pos, std::span<std::byte> buf)
+{
+    constexpr std::size_t max_read = std::numeric_limits<std::int32_t>::max();
+
+    void* raw_stream = nullptr;
+    std::int32_t err = mz_zip_get_stream(handle.get(), &raw_stream);
+    if(err != MZ_OK)
+        throw minizip_error(err);
+    err = mz_stream_seek(raw_stream, pos, MZ_SEEK_SET);
+    if(err != MZ_OK)
+        throw minizip_error(err);
+
+    std::size_t total = 0;
+    while(total < buf.size())
+    {
+        std::int32_t result = mz_stream_read(
+            raw_stream,
+            buf.data() + total,
+            static_cast<std::int32_t>(std::min(buf.size() - total, max_read))
+        );
+        if(result < 0)
+            throw minizip_error(result);
+        if(result == 0)
+            break;
+
+        total += static_cast<std::size_t>(result);
+    }
+
+    return total;
+}
+
+std::uint64_t zip_archive::reader::entry_file_size() const
+{
+    const auto& info = detail::get_entry_info(handle.get());
+
+    return static_cast<std::uint64_t>(info.uncompressed_size);
+}
+
+std::string_view zip_archive::reader::entry_filename() const
+{
+    const auto& info = detail::get_entry_info(handle.get());
+
+    return std::string_view(info.filename, info.filename_size);
+}
+
+void zip_archive::reader_releaser::operator()(reader* r) const noexcept
+{
+    if(!r) [[unlikely]]
+        return;
+
+    std::unique_ptr<reader> ptr(r);
+    ptr->close_entry();
+
+    try
+    {
+        std::lock_guard lock(owner->m_pool_mutex);
+        owner->m_pool.push_back(std::move(ptr));
+    }
+    catch(...)
+    {
+        // Drop the reader if it cannot be put back
+    }
+}
+
+auto zip_archive::acquire_reader() const -> reader_lease
+{
+    {
+        std::lock_guard lock(m_pool_mutex);
+        if(!m_pool.empty())
+        {
+            reader* r = m_pool.back().release();
+            m_pool.pop_back();
+            return reader_lease(r, reader_releaser{this});
+        }
+    }
+
+    // Open a new reader outside of the lock
+    auto r = std::make_unique<reader>();
+    if(m_in_memory)
+        r->open(m_memory);
+    else
+        r->open(m_sys_path);
+    return reader_lease(r.release(), reader_releaser{this});
+}
+
+/**
+ * @brief Stream buffer decompressing an entry chunk by chunk
+ *
+ * It holds a reader from the pool until destroyed, so it won't disturb other reads of the archive.
+ *
+ * If inflate checkpoints are enabled for a large deflated entry, it inflates the raw data of the entry by itself,
+ * so it can record checkpoints and resume from them when seeking.
+ */
+class zip_archive::entry_buf final : public std::streambuf
+{
+public:
+    static constexpr std::size_t chunk_size = 64 * 1024;
+
+    entry_buf(std::shared_ptr<const zip_archive> ar, std::size_t idx)
+        : m_archive(std::move(ar)),
+          m_idx(idx),
+          m_offset(m_archive->entry(idx).cd_offset),
+          m_reader(m_archive->acquire_reader()),
+          m_size(m_archive->entry(idx).uncompressed_size)
+    {
+        const auto& info = m_archive->entry(idx);
+        const std::uint64_t interval = m_archive->m_checkpoint_interval;
+        if(interval != 0 &&
+           info.method == MZ_COMPRESS_METHOD_DEFLATE &&
+           !(info.flag & MZ_ZIP_FLAG_ENCRYPTED) &&
+           info.uncompressed_size > interval)
+        {
+            init_inflate();
+        }
+        else
+            open_entry();
+    }
+
+    ~entry_buf()
+    {
+        if(m_inflate)
+        {
+            try
+            {
+                m_archive->store_checkpoints(m_idx, m_inflate->points);
+            }
+            catch(...)
+            {
+                // Checkpoints are optional
+            }
+
+            inflateEnd(&m_inflate->zs);
+        }
+    }
+
+protected:
+    int_type underflow() override
+    {
+        if(gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+
+        if(!m_buf)
+            m_buf = std::make_unique<char[]>(chunk_size);
+
+        std::size_t n = read_entry(std::span(m_buf.get(), chunk_size));
+        setg(m_buf.get(), m_buf.get(), m_buf.get() + n);
+        if(n == 0)
+            return traits_type::eof();
+
+        return traits_type::to_int_type(*gptr());
+    }
+
+    std::streamsize showmanyc() override
+    {
+        std::uint64_t left = m_size - m_pos;
+        if(left == 0)
+            return -1;
+
+        return static_cast<std::streamsize>(left);
+    }
+
+    std::streamsize xsgetn(char* s, std::streamsize count) override
+    {
+        std::streamsize result = 0;
+
+        std::streamsize buffered = std::min<std::streamsize>(egptr() - gptr(), count);
+        if(buffered > 0)
+        {
+            traits_type::copy(s, gptr(), static_cast<std::size_t>(buffered));
+            gbump(static_cast<int>(buffered));
+            result += buffered;
+        }
+
+        // Large reads bypass the buffer and decompress into the destination directly
+        if(count - result >= static_cast<std::streamsize>(chunk_size))
+        {
+            setg(nullptr, nullptr, nullptr);
+            result += static_cast<std::streamsize>(read_entry(std::span(
+                s + result, static_cast<std::size_t>(count - result)
+            )));
+            return result;
+        }
+
+        if(result < count)
+            result += std::streambuf::xsgetn(s + result, count - result);
+
+        return result;
+    }
+
+    pos_type seekoff(
+        off_type off, std::ios_base::seekdir way, std::ios_base::openmode which
+    ) override
+    {
+        if(!(which & std::ios_base::in))
+            return pos_type(off_type(-1));
+
+        // Position of the next character to read
+        const off_type current = static_cast<off_type>(m_pos) - (egptr() - gptr());
+
+        off_type target = 0;
+        switch(way)
+        {
+        case std::ios_base::beg:
+            target = off;
+            break;
+        case std::ios_base::cur:
+            target = current + off;
+            break;
+        case std::ios_base::end:
+            target = static_cast<off_type>(m_size) + off;
+            break;
+
+        default:
+            return pos_type(off_type(-1));
+        }
+
+        if(target < 0 || static_cast<std::uint64_t>(target) > m_size)
+            return pos_type(off_type(-1));
+
+        const off_type buf_begin = static_cast<off_type>(m_pos) - (egptr() - eback());
+        if(buf_begin <= target && target <= static_cast<off_type>(m_pos))
+        {
+            setg(eback(), eback() + (target - buf_begin), egptr());
+            return pos_type(target);
+        }
+
+        setg(nullptr, nullptr, nullptr);
+        const std::uint64_t target_pos = static_cast<std::uint64_t>(target);
+        if(m_inflate)
+        {
+            // Resume from the nearest checkpoint if it is closer than the current position
+            const inflate_checkpoint* cp = find_checkpoint(target_pos);
+            if(target_pos < m_pos || (cp && cp->out > m_pos))
+                restart_inflate(cp);
+        }
+        else if(target_pos < m_pos)
+        {
+            m_reader->close_entry();
+            open_entry();
+        }
+        skip(target_pos - m_pos);
+
+        return pos_type(target);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+
+private:
+    void open_entry()
+    {
+        m_reader->goto_entry(m_offset);
+        m_reader->open_entry();
+        m_pos = 0;
+    }
+
+    std::size_t read_entry(std::span<char> buf)
+    {
+        std::size_t n = m_inflate ?
+                            inflate_entry(std::as_writable_bytes(buf)) :
+                            m_reader->read_entry(std::as_writable_bytes(buf));
+        m_pos += static_cast<std::uint64_t>(n);
+        return n;
+    }
+
+    /**
+     * @brief Discard decompressed data for forward seeking
+     */
+    void skip(std::uint64_t count)
+    {
+        if(count == 0)
+            return;
+
+        if(!m_buf)
+            m_buf = std::make_unique<char[]>(chunk_size);
+        while(count > 0)
+        {
+            std::size_t n = read_entry(std::span(
+                m_buf.get(), static_cast<std::size_t>(std::min<std::uint64_t>(count, chunk_size))
+            ));
+            if(n == 0) [[unlikely]]
+                break;
+            count -= n;
+        }
+    }
+
+    static constexpr std::uint32_t window_size = 32 * 1024;
+
+    struct inflate_state
+    {
+        z_stream zs{};
+        // Position of the compressed data in the archive
+        std::int64_t data_offset = 0;
+        std::uint64_t compressed_size = 0;
+        // Compressed bytes read into the input buffer
+        std::uint64_t in = 0;
+        // Uncompressed position where the inflate stream was (re)started
+        std::uint64_t out_base = 0;
+        std::uint8_t last_input = 0;
+        bool stream_end = false;
+        std::unique_ptr<std::byte[]> in_buf;
+        checkpoint_list points;
+    };
+
+    void init_inflate()
+    {
+        const auto& info = m_archive->entry(m_idx);
+
+        // Local file header: signature(4), ..., filename length(2) at 26, extra field length(2) at 28
+        std::byte header[30];
+        if(m_reader->read_raw(info.local_header_offset, header) != sizeof(header)) [[unlikely]]
+            throw minizip_error(MZ_FORMAT_ERROR);
+        auto read_u16 = [&](std::size_t off) -> std::uint16_t
+        {
+            return static_cast<std::uint16_t>(
+                std::to_integer<std::uint16_t>(header[off]) |
+                std::to_integer<std::uint16_t>(header[off + 1]) << 8
+            );
+        };
+        if(read_u16(0) != 0x4b50 || read_u16(2) != 0x0403) [[unlikely]]
+            throw minizip_error(MZ_FORMAT_ERROR);
+
+        auto state = std::make_unique<inflate_state>();
+        state->data_offset = info.local_header_offset + sizeof(header) + read_u16(26) + read_u16(28);
+        state->compressed_size = info.compressed_size;
+        state->in_buf = std::make_unique<std::byte[]>(chunk_size);
+        state->points = m_archive->load_checkpoints(m_idx);
+        if(inflateInit2(&state->zs, -MAX_WBITS) != Z_OK) [[unlikely]]
+            throw minizip_error(MZ_MEM_ERROR);
+
+        m_inflate = std::move(state);
+        m_pos = 0;
+    }
+
+    /**
+     * @brief Find the last checkpoint not after the position
+     */
+    const inflate_checkpoint* find_checkpoint(std::uint64_t pos) const noexcept
+    {
+        const auto& points = m_inflate->points;
+        auto it = std::upper_bound(
+            points.begin(),
+            points.end(),
+            pos,
+            [](std::uint64_t p, const inflate_checkpoint& cp)
+            { return p < cp.out; }
+        );
+        if(it == points.begin())
+            return nullptr;
+        return &*std::prev(it);
+    }
+
+    /**
+     * @brief Restart decompression from a checkpoint, or from the beginning if it is null
+     */
+    void restart_inflate(const inflate_checkpoint* cp)
+    {
+        auto& st = *m_inflate;
+        if(inflateReset(&st.zs) != Z_OK) [[unlikely]]
+            throw minizip_error(MZ_INTERNAL_ERROR);
+        st.zs.next_in = nullptr;
+        st.zs.avail_in = 0;
+        st.stream_end = false;
+
+        if(!cp)
+        {
+            st.in = 0;
+            st.out_base = 0;
+            m_pos = 0;
+            return;
+        }
+
+        if(cp->bits != 0)
+            inflatePrime(&st.zs, cp->bits, cp->prime >> (8 - cp->bits));
+        inflateSetDictionary(
+            &st.zs,
+            reinterpret_cast<const Bytef*>(cp->window.get()),
+            cp->window_size
+        );
+        st.in = cp->in;
+        st.out_base = cp->out;
+        m_pos = cp->out;
+    }
+
+    std::size_t inflate_entry(std::span<std::byte> buf)
+    {
+        auto& st = *m_inflate;
+        // The whole entry may be output before zlib decodes the end of the stream
+        if(st.stream_end || buf.empty() || m_pos >= m_size)
+            return 0;
+
+        constexpr std::uint64_t max_out = std::numeric_limits<uInt>::max();
+        st.zs.next_out = reinterpret_cast<Bytef*>(buf.data());
+        st.zs.avail_out = static_cast<uInt>(std::min({static_cast<std::uint64_t>(buf.size()), max_out, m_size - m_pos}));
+        const uInt requested = st.zs.avail_out;
+        while(st.zs.avail_out > 0)
+        {
+            if(st.zs.avail_in == 0)
+            {
+                // Output is still expected here, since it is limited to the rest of the entry
+                if(st.in >= st.compressed_size) [[unlikely]]
+                    throw minizip_error(MZ_DATA_ERROR); // Truncated data
+
+                std::size_t n = static_cast<std::size_t>(
+                    std::min<std::uint64_t>(chunk_size, st.compressed_size - st.in)
+                );
+                n = m_reader->read_raw(
+                    st.data_offset + static_cast<std::int64_t>(st.in),
+                    std::span(st.in_buf.get(), n)
+                );
+                if(n == 0) [[unlikely]]
+                    throw minizip_error(MZ_READ_ERROR);
+
+                if(st.zs.next_in)
+                    st.last_input = static_cast<std::uint8_t>(st.zs.next_in[-1]);
+                st.in += n;
+                st.zs.next_in = reinterpret_cast<Bytef*>(st.in_buf.get());
+                st.zs.avail_in = static_cast<uInt>(n);
+            }
+
+            // Stop at the end of every deflate block if new checkpoints may be needed
+            const bool recording = can_record();
+            int ret = inflate(&st.zs, recording ? Z_BLOCK : Z_NO_FLUSH);
+            if(ret == Z_STREAM_END)
+            {
+                st.stream_end = true;
+                break;
+            }
+            if(ret != Z_OK && ret != Z_BUF_ERROR) [[unlikely]]
+                throw minizip_error(MZ_DATA_ERROR);
+
+            if(recording)
+                record_checkpoint();
+        }
+
+        return requested - st.zs.avail_out;
+    }
+
+    std::uint64_t next_checkpoint() const noexcept
+    {
+        const auto& points = m_inflate->points;
+        std::uint64_t last = points.empty() ? 0 : points.back().out;
+        return last + m_archive->m_checkpoint_interval;
+    }
+
+    bool can_record() const noexcept
+    {
+        return next_checkpoint() < m_size &&
+               (m_inflate->points.size() + 1) * window_size <= m_archive->m_checkpoint_limit;
+    }
+
+    void record_checkpoint()
+    {
+        auto& st = *m_inflate;
+
+        // Only at the end of a block that is not the last one
+        if(!(st.zs.data_type & 128) || (st.zs.data_type & 64))
+            return;
+
+        const std::uint64_t out = st.out_base + st.zs.total_out;
+        if(out < next_checkpoint())
+            return;
+
+        inflate_checkpoint cp;
+        cp.out = out;
+        cp.in = st.in - st.zs.avail_in;
+        cp.bits = st.zs.data_type & 7;
+        if(cp.bits != 0)
+        {
+            cp.prime = st.zs.next_in != reinterpret_cast<Bytef*>(st.in_buf.get()) ?
+                           static_cast<std::uint8_t>(st.zs.next_in[-1]) :
+                           st.last_input;
+        }
+
+        auto window = std::make_shared<std::byte[]>(window_size);
+        uInt size = window_size;
+        if(inflateGetDictionary(&st.zs, reinterpret_cast<Bytef*>(window.get()), &size) != Z_OK) [[unlikely]]
+            return;
+        cp.window = std::move(window);
+        cp.window_size = size;
+
+        st.points.push_back(std::move(cp));
+    }
+
+    std::shared_ptr<const zip_archive> m_archive;
+    std::size_t m_idx;
+    std::int64_t m_offset;
+    // Declared after the archive reference, so it will be returned before the archive is released
+    reader_lease m_reader;
+    std::uint64_t m_size;
+    // Decompressed bytes consumed from the entry, i.e. the position of egptr()
+    std::uint64_t m_pos = 0;
+    std::unique_ptr<char[]> m_buf;
+    std::unique_ptr<inflate_state> m_inflate;
+};
+
+/**
+ * @brief Stream buffer over a stored entry in the archive content in memory
+ *
+ * It keeps the archive alive, so the mapping or the owned buffer won't be released while the buffer is in use.
+ */
+class zip_archive::mapped_buf final : public span_buf
+{
+public:
+    mapped_buf(
+        std::shared_ptr<const zip_archive> ar,
+        std::span<const std::byte> data,
+        std::ios_base::openmode mode
+    )
+        : span_buf(
+              std::span<char>(
+                  const_cast<char*>(reinterpret_cast<const char*>(data.data())),
+                  data.size()
+              ),
+              mode
+          ),
+          m_archive(std::move(ar))
+    {}
+
+private:
+    std::shared_ptr<const zip_archive> m_archive;
+};
+
+zip_archive::zip_archive() = default;
+
 zip_archive::~zip_archive()
 {
     close();
-    m_handle.reset();
-    m_stream.reset();
 }
 
-std::string zip_archive::read_string(std::int64_t offset) const
+std::unique_ptr<std::streambuf> zip_archive::getbuf(
+    std::size_t idx, std::ios_base::openmode mode
+) const
 {
+    auto self = std::static_pointer_cast<const zip_archive>(shared_from_this());
+
+    if(auto data = view_bytes(idx))
+    {
+        mode &= ~std::ios_base::out;
+        return std::make_unique<mapped_buf>(std::move(self), *data, mode);
+    }
+
+    return std::make_unique<entry_buf>(std::move(self), idx);
+}
+
+std::string zip_archive::read_string(std::size_t idx) const
+{
+    if(auto data = view_bytes(idx))
+    {
+        return std::string(
+            reinterpret_cast<const char*>(data->data()), data->size()
+        );
+    }
+
+    const auto& info = entry(idx);
     std::string result;
 
-    goto_entry(offset);
-    auto entry = open_current();
+    auto r = acquire_reader();
+    r->goto_entry(info.cd_offset);
+    r->open_entry();
 
-    std::size_t sz = entry.file_size();
-    result.resize(sz);
-    sz = entry.read(
-        std::span(reinterpret_cast<std::byte*>(result.data()), result.size())
-    );
+    result.resize(info.uncompressed_size);
+    std::size_t sz = r->read_entry(std::as_writable_bytes(std::span(result)));
     if(sz != result.size()) [[unlikely]]
         result.resize(sz);
 
     return result;
 }
 
-std::vector<std::byte> zip_archive::read_bytes(std::int64_t offset) const
+std::vector<std::byte> zip_archive::read_bytes(std::size_t idx) const
 {
+    if(auto data = view_bytes(idx))
+        return std::vector<std::byte>(data->begin(), data->end());
+
+    const auto& info = entry(idx);
     std::vector<std::byte> result;
 
-    goto_entry(offset);
-    auto entry = open_current();
+    auto r = acquire_reader();
+    r->goto_entry(info.cd_offset);
+    r->open_entry();
 
-    std::size_t sz = entry.file_size();
-    result.resize(sz);
-    sz = entry.read(result);
+    result.resize(info.uncompressed_size);
+    std::size_t sz = r->read_entry(result);
     if(sz != result.size()) [[unlikely]]
         result.resize(sz);
 
     return result;
 }
 
-std::uint64_t zip_archive::get_file_size(std::int64_t offset) const
+std::optional<std::span<const std::byte>> zip_archive::view_bytes(
+    std::size_t idx
+) const
 {
-    goto_entry(offset);
-    return entry_file_size();
+    const auto& info = entry(idx);
+    if(info.mapped_offset < 0)
+        return std::nullopt;
+
+    return memory_bytes().subspan(
+        static_cast<std::size_t>(info.mapped_offset),
+        static_cast<std::size_t>(info.uncompressed_size)
+    );
 }
 
-void zip_archive::open(const std::filesystem::path& sys_path)
+std::uint64_t zip_archive::get_file_size(std::size_t idx) const
 {
-    std::int32_t err = mz_stream_os_open(
-        m_stream.get(),
-        reinterpret_cast<const char*>(sys_path.u8string().c_str()),
-        MZ_OPEN_MODE_READ
-    );
-    if(err != MZ_OK)
-        throw minizip_error(err);
+    return entry(idx).uncompressed_size;
+}
 
-    err = mz_zip_open(m_handle.get(), m_stream.get(), MZ_OPEN_MODE_READ);
-    if(err != MZ_OK)
-        throw minizip_error(err);
+void zip_archive::open(const std::filesystem::path& sys_path, bool memory_map)
+{
+    m_reader.open(sys_path);
+    m_sys_path = std::filesystem::absolute(sys_path);
+    m_in_memory = false;
+    if(memory_map)
+        m_mapping.open(m_sys_path);
+
+    build_index();
+}
+
+void zip_archive::open(
+    const std::filesystem::path& sys_path,
+    bool memory_map,
+    std::vector<entry_info> index,
+    std::string names
+)
+{
+    m_sys_path = std::filesystem::absolute(sys_path);
+    m_in_memory = false;
+    if(memory_map)
+        m_mapping.open(m_sys_path);
+
+    m_index = std::move(index);
+    m_names = std::move(names);
+    for(auto& e : m_index)
+        e.mapped_offset = locate_mapped_data(e);
+}
+
+void zip_archive::open(std::span<const std::byte> data)
+{
+    m_reader.open(data);
+    m_memory = data;
+    m_in_memory = true;
+
+    build_index();
+}
+
+void zip_archive::open(std::vector<std::byte> data)
+{
+    m_owned_memory = std::move(data);
+    open(std::span<const std::byte>(m_owned_memory));
+}
+
+void zip_archive::open_nested(std::shared_ptr<const zip_archive> outer, std::size_t idx)
+{
+    if(auto data = outer->view_bytes(idx))
+    {
+        open(*data);
+        // The outer archive owns the memory
+        m_outer = std::move(outer);
+        return;
+    }
+
+    const auto& info = outer->entry(idx);
+    if(info.method == MZ_COMPRESS_METHOD_STORE && !outer->m_in_memory)
+    {
+        // Read the stored entry through a window of the mapped outer file
+        if(m_mapping.open(outer->m_sys_path))
+        {
+            std::int64_t offset = locate_stored_data(m_mapping.bytes(), info);
+            if(offset >= 0)
+            {
+                open(m_mapping.bytes().subspan(
+                    static_cast<std::size_t>(offset),
+                    static_cast<std::size_t>(info.uncompressed_size)
+                ));
+                return;
+            }
+
+            m_mapping.close();
+        }
+    }
+
+    open(outer->read_bytes(idx));
+}
+
+std::span<const std::byte> zip_archive::memory_bytes() const noexcept
+{
+    if(m_in_memory)
+        return m_memory;
+    return m_mapping.bytes();
+}
+
+auto zip_archive::list_dir(std::string_view dir) const -> const dir_children*
+{
+    const dir_map* dirs = nullptr;
+    {
+        std::lock_guard lock(m_dirs_mutex);
+        if(!m_dirs)
+            m_dirs = build_dirs();
+        dirs = m_dirs.get();
+    }
+
+    // The listing is not changed until the archive is closed
+    auto it = dirs->find(dir);
+    if(it == dirs->end())
+        return nullptr;
+    return &it->second;
+}
+
+auto zip_archive::build_dirs() const -> std::unique_ptr<const dir_map>
+{
+    auto dirs = std::make_unique<dir_map>();
+
+    // Register a directory and all of its parents, returns its children
+    auto ensure_dir = [&dirs](std::string_view path, auto& self) -> dir_children&
+    {
+        auto it = dirs->find(path);
+        if(it != dirs->end())
+            return it->second;
+
+        if(!path.empty())
+        {
+            std::size_t sep = path.rfind('/');
+            std::string_view parent = sep == std::string_view::npos ? std::string_view() : path.substr(0, sep);
+            std::string_view name = sep == std::string_view::npos ? path : path.substr(sep + 1);
+            self(parent, self).dirs.push_back(name);
+        }
+
+        return (*dirs)[path];
+    };
+
+    ensure_dir(std::string_view(), ensure_dir);
+    for(std::size_t i = 0; i < m_index.size(); ++i)
+    {
+        if(m_index[i].is_dir)
+            continue;
+
+        std::string_view name = entry_name(i);
+        std::size_t sep = name.rfind('/');
+        std::string_view parent = sep == std::string_view::npos ? std::string_view() : name.substr(0, sep);
+        ensure_dir(parent, ensure_dir).files.push_back(i);
+    }
+
+    return dirs;
+}
+
+void zip_archive::set_inflate_checkpoints(std::uint64_t interval, std::uint64_t memory_limit)
+{
+    m_checkpoint_interval = interval;
+    m_checkpoint_limit = memory_limit;
+}
+
+auto zip_archive::load_checkpoints(std::size_t idx) const -> checkpoint_list
+{
+    std::lock_guard lock(m_checkpoint_mutex);
+    auto it = m_checkpoints.find(idx);
+    if(it == m_checkpoints.end())
+        return checkpoint_list();
+
+    return it->second;
+}
+
+void zip_archive::store_checkpoints(std::size_t idx, const checkpoint_list& points) const
+{
+    std::lock_guard lock(m_checkpoint_mutex);
+    auto& published = m_checkpoints[idx];
+    for(std::size_t i = published.size(); i < points.size(); ++i)
+    {
+        if(m_checkpoint_memory + points[i].window_size > m_checkpoint_limit)
+            break;
+
+        published.push_back(points[i]);
+        m_checkpoint_memory += points[i].window_size;
+    }
+}
+
+std::int64_t zip_archive::locate_mapped_data(const entry_info& info) const noexcept
+{
+    if(!m_in_memory && !m_mapping.is_open())
+        return -1;
+
+    return locate_stored_data(memory_bytes(), info);
+}
+
+std::int64_t zip_archive::locate_stored_data(
+    std::span<const std::byte> bytes, const entry_info& info
+) noexcept
+{
+    if(info.method != MZ_COMPRESS_METHOD_STORE || info.is_dir)
+        return -1;
+    if(info.flag & MZ_ZIP_FLAG_ENCRYPTED)
+        return -1;
+    if(info.compressed_size != info.uncompressed_size)
+        return -1;
+
+    // Local file header: signature(4), ..., filename length(2) at 26, extra field length(2) at 28
+    constexpr std::size_t local_header_size = 30;
+    const std::uint64_t header_offset = static_cast<std::uint64_t>(info.local_header_offset);
+    if(info.local_header_offset < 0 || header_offset + local_header_size > bytes.size())
+        return -1;
+
+    auto read_u16 = [&](std::size_t off) -> std::uint16_t
+    {
+        return static_cast<std::uint16_t>(
+            std::to_integer<std::uint16_t>(bytes[off]) |
+            std::to_integer<std::uint16_t>(bytes[off + 1]) << 8
+        );
+    };
+
+    const std::size_t header = static_cast<std::size_t>(header_offset);
+    if(read_u16(header) != 0x4b50 || read_u16(header + 2) != 0x0403) [[unlikely]]
+        return -1;
+
+    const std::uint64_t data_offset =
+        header_offset +
+        local_header_size +
+        read_u16(header + 26) +
+        read_u16(header + 28);
+    if(data_offset + info.uncompressed_size > bytes.size()) [[unlikely]]
+        return -1;
+
+    return static_cast<std::int64_t>(data_offset);
+}
+
+void zip_archive::build_index()
+{
+    m_index.clear();
+    m_names.clear();
+
+    std::uint64_t count = 0;
+    if(mz_zip_get_number_entry(m_reader.handle.get(), &count) == MZ_OK)
+        m_index.reserve(static_cast<std::size_t>(count));
+
+    if(!goto_first())
+        return; // Empty archive
+    do
+    {
+        const auto& info = detail::get_entry_info(m_reader.handle.get());
+
+        entry_info& e = m_index.emplace_back();
+        e.cd_offset = current_offset();
+        e.local_header_offset = info.disk_offset;
+        e.compressed_size = static_cast<std::uint64_t>(info.compressed_size);
+        e.uncompressed_size = static_cast<std::uint64_t>(info.uncompressed_size);
+        e.crc = info.crc;
+        e.method = info.compression_method;
+        e.flag = info.flag;
+        e.is_dir = current_is_dir();
+        e.name_offset = static_cast<std::uint32_t>(m_names.size());
+        e.name_size = info.filename_size;
+
+        m_names.append(info.filename, info.filename_size);
+    } while(goto_next());
+
+    for(auto& e : m_index)
+        e.mapped_offset = locate_mapped_data(e);
 }
 
 void zip_archive::close() noexcept
 {
-    mz_zip_close(m_handle.get());
-    mz_stream_os_close(m_stream.get());
+    m_reader.close();
+    m_mapping.close();
+    m_memory = {};
+    m_owned_memory.clear();
+    m_in_memory = false;
+    m_outer.reset();
+    m_index.clear();
+    m_names.clear();
+
+    {
+        std::lock_guard lock(m_dirs_mutex);
+        m_dirs.reset();
+    }
+
+    {
+        std::lock_guard lock(m_checkpoint_mutex);
+        m_checkpoints.clear();
+        m_checkpoint_memory = 0;
+    }
+
+    std::lock_guard lock(m_pool_mutex);
+    m_pool.clear();
 }
 
 bool zip_archive::goto_first() const
 {
-    std::int32_t err = mz_zip_goto_first_entry(m_handle.get());
+    std::int32_t err = mz_zip_goto_first_entry(m_reader.handle.get());
     if(err == MZ_END_OF_LIST)
         return false;
     else if(err == MZ_OK)
@@ -165,7 +1135,7 @@ bool zip_archive::goto_first() const
 
 bool zip_archive::goto_next() const
 {
-    std::int32_t err = mz_zip_goto_next_entry(m_handle.get());
+    std::int32_t err = mz_zip_goto_next_entry(m_reader.handle.get());
     if(err == MZ_END_OF_LIST)
         return false;
     else if(err == MZ_OK)
@@ -174,58 +1144,39 @@ bool zip_archive::goto_next() const
         throw minizip_error(err);
 }
 
-void zip_archive::goto_entry(std::int64_t offset) const
-{
-    int err = mz_zip_goto_entry(m_handle.get(), offset);
-    if(err != MZ_OK)
-        throw minizip_error(err);
-}
-
 bool zip_archive::current_is_dir() const
 {
-    return mz_zip_entry_is_dir(m_handle.get()) == MZ_OK;
+    return mz_zip_entry_is_dir(m_reader.handle.get()) == MZ_OK;
 }
 
 std::int64_t zip_archive::current_offset() const
 {
-    return mz_zip_get_entry(m_handle.get());
+    return mz_zip_get_entry(m_reader.handle.get());
 }
 
 void zip_archive::open_entry() const
 {
-    int err = mz_zip_entry_read_open(m_handle.get(), false, nullptr);
-    if(err != MZ_OK)
-        throw minizip_error(err);
+    m_reader.open_entry();
 }
 
 std::size_t zip_archive::read_entry(std::span<std::byte> buf) const
 {
-    std::int32_t result = mz_zip_entry_read(
-        m_handle.get(), buf.data(), static_cast<std::int32_t>(buf.size())
-    );
-    if(result < 0)
-        throw minizip_error(result);
-
-    return static_cast<size_t>(result);
+    return m_reader.read_entry(buf);
 }
 
 std::uint64_t zip_archive::entry_file_size() const
 {
-    const auto& info = detail::get_entry_info(m_handle.get());
-
-    return static_cast<std::uint64_t>(info.uncompressed_size);
+    return m_reader.entry_file_size();
 }
 
 std::string_view zip_archive::entry_filename() const
 {
-    const auto& info = detail::get_entry_info(m_handle.get());
-
-    return std::string_view(info.filename, info.filename_size);
+    return m_reader.entry_filename();
 }
 
 void zip_archive::close_entry() const noexcept
 {
-    mz_zip_entry_close(m_handle.get());
+    m_reader.close_entry();
 }
 
 void zip_archive::handle_deleter::operator()(void* handle) const noexcept
@@ -239,6 +1190,6 @@ void zip_archive::stream_deleter::operator()(void* stream) const noexcept
 {
     if(!stream) [[unlikely]]
         return;
-    mz_stream_os_delete(&stream);
+    mz_stream_delete(&stream);
 }
 } // namespace lochfolk
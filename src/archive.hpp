@@ -6,10 +6,16 @@
 #include <cstdint>
 #include <cstddef>
 #include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 #include <filesystem>
+#include "mapped_file.hpp"
 
 namespace lochfolk
 {
@@ -24,20 +30,37 @@ protected:
 public:
     virtual ~archive();
 
-    std::unique_ptr<std::streambuf> getbuf(
-        std::int64_t offset, std::ios_base::openmode mode
+    /**
+     * @brief Get a stream buffer of an entry
+     *
+     * @note The default implementation reads the whole entry into a string buffer
+     */
+    virtual std::unique_ptr<std::streambuf> getbuf(
+        std::size_t idx, std::ios_base::openmode mode
     ) const;
 
-    virtual std::string read_string(std::int64_t offset) const = 0;
-    virtual std::vector<std::byte> read_bytes(std::int64_t offset) const = 0;
+    virtual std::string read_string(std::size_t idx) const = 0;
+    virtual std::vector<std::byte> read_bytes(std::size_t idx) const = 0;
+
+    /**
+     * @brief Get a view of an entry if its data is available in memory without decompression
+     *
+     * @note The default implementation always returns `std::nullopt`
+     */
+    virtual std::optional<std::span<const std::byte>> view_bytes(
+        std::size_t idx
+    ) const;
 
     virtual std::uint64_t get_file_size(
-        std::int64_t offset
+        std::size_t idx
     ) const = 0;
 };
 
 /**
  * @brief ZIP archive
+ *
+ * @note Reading entries by index is thread-safe, each read checks out its own reader from a pool.
+ *       Enumerating entries (goto_first, goto_next, etc.) shares a single cursor and is not thread-safe.
  */
 class zip_archive : public archive
 {
@@ -47,6 +70,11 @@ public:
     public:
         minizip_error(std::int32_t err);
 
+        /**
+         * @param msg Context of the error, prepended to the translated error code
+         */
+        minizip_error(std::int32_t err, std::string_view msg);
+
         [[nodiscard]]
         static std::string translate_error(std::int32_t err);
 
@@ -60,6 +88,12 @@ public:
         std::int32_t m_err;
     };
 
+    /**
+     * @brief Get a readable name of a ZIP compression method, e.g. "deflate" or "zstd"
+     */
+    [[nodiscard]]
+    static std::string compression_method_name(std::uint16_t method);
+
     zip_archive();
 
     zip_archive(const zip_archive&) = delete;
@@ -67,12 +101,121 @@ public:
 
     ~zip_archive();
 
-    std::string read_string(std::int64_t offset) const override;
-    std::vector<std::byte> read_bytes(std::int64_t offset) const override;
+    /**
+     * @brief Get a stream buffer that decompresses the entry on demand
+     */
+    std::unique_ptr<std::streambuf> getbuf(
+        std::size_t idx, std::ios_base::openmode mode
+    ) const override;
+
+    std::string read_string(std::size_t idx) const override;
+    std::vector<std::byte> read_bytes(std::size_t idx) const override;
+
+    /**
+     * @brief Get a view of a stored (uncompressed) entry if the archive is in memory or memory-mapped
+     *
+     * @return `std::nullopt` if the archive is read from file or the entry is compressed
+     */
+    std::optional<std::span<const std::byte>> view_bytes(std::size_t idx) const override;
+
+    /**
+     * @brief Uncompressed size of an entry, read from the index
+     */
+    std::uint64_t get_file_size(std::size_t idx) const override;
+
+    /**
+     * @brief Central directory record of an entry
+     */
+    struct entry_info
+    {
+        // Position of the record in the central directory, used for seeking to the entry
+        std::int64_t cd_offset = 0;
+        std::int64_t local_header_offset = 0;
+        std::uint64_t compressed_size = 0;
+        std::uint64_t uncompressed_size = 0;
+        // Offset of the entry data in the archive content in memory, or -1 if it cannot be viewed directly
+        std::int64_t mapped_offset = -1;
+        std::uint32_t crc = 0;
+        std::uint16_t method = 0;
+        std::uint16_t flag = 0;
+        bool is_dir = false;
+        // Filename stored in the name buffer of the index
+        std::uint32_t name_offset = 0;
+        std::uint32_t name_size = 0;
+    };
+
+    /**
+     * @brief Open an archive and build the entry index from its central directory
+     *
+     * @param memory_map Map the archive into memory, so stored entries can be read without copying.
+     *                   Falls back to normal reading silently if the mapping fails.
+     */
+    void open(const std::filesystem::path& sys_path, bool memory_map = false);
+
+    /**
+     * @brief Open an archive with an entry index built before, e.g. loaded from a mount manifest
+     *
+     * The central directory is not scanned, and the file is only opened by minizip when an entry is read.
+     * The caller is responsible for the index matching the file.
+     *
+     * @param index Entries of the archive in the order of the central directory. Their mapped offsets are ignored.
+     * @param names Name buffer referred to by the index
+     *
+     * @note Enumerating entries (goto_first, goto_next, etc.) is not available for an archive opened this way
+     */
+    void open(
+        const std::filesystem::path& sys_path,
+        bool memory_map,
+        std::vector<entry_info> index,
+        std::string names
+    );
 
-    std::uint64_t get_file_size(std::int64_t offset) const override;
+    /**
+     * @brief Open an archive in memory
+     *
+     * @param data Content of the archive. It must be kept alive until the archive is closed.
+     *
+     * @note Stored entries are always viewable without copying
+     */
+    void open(std::span<const std::byte> data);
 
-    void open(const std::filesystem::path& sys_path);
+    /**
+     * @brief Open an archive in memory, taking the ownership of the buffer
+     */
+    void open(std::vector<std::byte> data);
+
+    /**
+     * @brief Open an entry of another archive as an archive
+     *
+     * A stored entry is read directly from the memory of the outer archive if available,
+     * otherwise from a window of the outer archive file mapped into memory.
+     * A compressed entry is decompressed into a buffer owned by this archive.
+     */
+    void open_nested(std::shared_ptr<const zip_archive> outer, std::size_t idx);
+
+    [[nodiscard]]
+    bool is_mapped() const noexcept
+    {
+        return m_mapping.is_open();
+    }
+
+    [[nodiscard]]
+    bool is_in_memory() const noexcept
+    {
+        return m_in_memory;
+    }
+
+    /**
+     * @brief Enable inflate checkpoints for seeking inside large deflated entries
+     *
+     * When a stream decompresses an entry larger than the interval, it records a snapshot of the inflate state
+     * about every `interval` bytes of output. Later seeks of any stream of this entry resume from the nearest checkpoint
+     * instead of decompressing from the beginning.
+     *
+     * @param interval Spacing of checkpoints in uncompressed bytes. Zero disables checkpoints.
+     * @param memory_limit Maximum memory used by the checkpoints of this archive
+     */
+    void set_inflate_checkpoints(std::uint64_t interval, std::uint64_t memory_limit);
 
     void close() noexcept;
 
@@ -96,6 +239,48 @@ public:
      */
     std::int64_t current_offset() const;
 
+    [[nodiscard]]
+    std::size_t entry_count() const noexcept
+    {
+        return m_index.size();
+    }
+
+    [[nodiscard]]
+    const entry_info& entry(std::size_t idx) const noexcept
+    {
+        return m_index[idx];
+    }
+
+    [[nodiscard]]
+    std::string_view entry_name(std::size_t idx) const noexcept
+    {
+        const auto& info = m_index[idx];
+        return std::string_view(m_names).substr(info.name_offset, info.name_size);
+    }
+
+    /**
+     * @brief Immediate children of a directory in the archive
+     */
+    struct dir_children
+    {
+        // Indices of files
+        std::vector<std::size_t> files;
+        // Names of subdirectories
+        std::vector<std::string_view> dirs;
+    };
+
+    /**
+     * @brief List a directory derived from the paths of file entries
+     *
+     * @param dir Directory path in the archive without trailing separator, empty for the root directory
+     *
+     * @return nullptr if the directory does not exist
+     *
+     * @note The listing of all directories is built on the first call after opening the archive.
+     *       This function is thread-safe.
+     */
+    const dir_children* list_dir(std::string_view dir) const;
+
     /**
      * @brief RAII helper for opening an entry
      */
@@ -159,6 +344,57 @@ public:
     }
 
 private:
+    class entry_buf;
+    class mapped_buf;
+
+    /**
+     * @brief Saved inflate state for resuming the decompression of a deflated entry
+     */
+    struct inflate_checkpoint
+    {
+        // Position in the uncompressed data
+        std::uint64_t out = 0;
+        // Position in the compressed data of the next byte to feed
+        std::uint64_t in = 0;
+        // Number of unused bits in the byte before `in`
+        int bits = 0;
+        // Value of the byte before `in`
+        std::uint8_t prime = 0;
+        // Sliding window of the last (up to 32 KiB) uncompressed data
+        std::shared_ptr<const std::byte[]> window;
+        std::uint32_t window_size = 0;
+    };
+
+    using checkpoint_list = std::vector<inflate_checkpoint>;
+
+    checkpoint_list load_checkpoints(std::size_t idx) const;
+
+    /**
+     * @brief Publish checkpoints of an entry, so they can be used by other streams
+     *
+     * @note Checkpoints are always recorded from the beginning with the same interval,
+     *       so a longer list extends a shorter one of the same entry.
+     */
+    void store_checkpoints(std::size_t idx, const checkpoint_list& points) const;
+
+    void build_index();
+
+    /**
+     * @brief Content of the archive if it is in memory or mapped, otherwise an empty span
+     */
+    std::span<const std::byte> memory_bytes() const noexcept;
+
+    /**
+     * @brief Locate the data of a stored entry in the archive content in memory
+     *
+     * @return Offset of the data, or -1 if not available
+     */
+    std::int64_t locate_mapped_data(const entry_info& info) const noexcept;
+
+    static std::int64_t locate_stored_data(
+        std::span<const std::byte> bytes, const entry_info& info
+    ) noexcept;
+
     void open_entry() const;
     void close_entry() const noexcept;
 
@@ -171,8 +407,6 @@ private:
 
     std::string_view entry_filename() const;
 
-    void goto_entry(std::int64_t offset) const;
-
     struct handle_deleter
     {
         void operator()(void* stream) const noexcept;
@@ -183,8 +417,103 @@ private:
         void operator()(void* stream) const noexcept;
     };
 
-    std::unique_ptr<void, handle_deleter> m_handle;
-    std::unique_ptr<void, stream_deleter> m_stream;
+    /**
+     * @brief Reader handle of minizip
+     *
+     * @note A reader has its own cursor. It must not be shared between threads.
+     */
+    struct reader
+    {
+        std::unique_ptr<void, handle_deleter> handle;
+        std::unique_ptr<void, stream_deleter> stream;
+
+        reader();
+
+        reader(reader&&) noexcept = default;
+
+        ~reader();
+
+        void open(const std::filesystem::path& sys_path);
+
+        void open(std::span<const std::byte> data);
+
+        void close() noexcept;
+
+        void goto_entry(std::int64_t offset);
+
+        void open_entry();
+
+        void close_entry() noexcept;
+
+        /**
+         * @brief Read data from the opened entry
+         *
+         * @return Bytes read. It is less than the size of buffer only if the end of entry is reached.
+         */
+        std::size_t read_entry(std::span<std::byte> buf);
+
+        /**
+         * @brief Read raw bytes of the archive at a position, bypassing the entry being read
+         *
+         * @return Bytes read
+         */
+        std::size_t read_raw(std::int64_t pos, std::span<std::byte> buf);
+
+        std::uint64_t entry_file_size() const;
+
+        std::string_view entry_filename() const;
+    };
+
+    struct reader_releaser
+    {
+        const zip_archive* owner;
+
+        void operator()(reader* r) const noexcept;
+    };
+
+    using reader_lease = std::unique_ptr<reader, reader_releaser>;
+
+    /**
+     * @brief Check out an idle reader from the pool, or open a new one if all of them are in use
+     *
+     * @note This function is thread-safe. The reader will be put back to the pool when the lease is destroyed.
+     */
+    reader_lease acquire_reader() const;
+
+    using dir_map = std::unordered_map<std::string_view, dir_children>;
+
+    /**
+     * @brief List all directories derived from the paths of file entries
+     */
+    std::unique_ptr<const dir_map> build_dirs() const;
+
+    std::filesystem::path m_sys_path;
+    mapped_file m_mapping;
+    // Archive opened from memory
+    bool m_in_memory = false;
+    std::span<const std::byte> m_memory;
+    std::vector<std::byte> m_owned_memory;
+    // Outer archive owning the memory of a nested archive
+    std::shared_ptr<const zip_archive> m_outer;
+    std::vector<entry_info> m_index;
+    // Filenames of all entries in the index
+    std::string m_names;
+
+    mutable std::mutex m_dirs_mutex;
+    // Built by the first call of `list_dir` after opening. Keys and names are views of the name buffer.
+    mutable std::unique_ptr<const dir_map> m_dirs;
+    // Cursor for enumerating entries when mounting
+    mutable reader m_reader;
+
+    mutable std::mutex m_pool_mutex;
+    mutable std::vector<std::unique_ptr<reader>> m_pool;
+
+    std::uint64_t m_checkpoint_interval = 0;
+    std::uint64_t m_checkpoint_limit = 0;
+    mutable std::mutex m_checkpoint_mutex;
+    mutable std::unordered_map<std::size_t, checkpoint_list> m_checkpoints;
+    // Memory used by all published checkpoints
+    mutable std::uint64_t m_checkpoint_memory = 0;
 };
 } // namespace lochfolk
 
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace lochfolk::detail
+{
+/**
+ * @brief Fold an ASCII letter to lower case. Other bytes, including those of UTF-8 sequences, are kept.
+ *
+ * Folding keeps the size of a string, so a folded name and its original spelling can share offsets.
+ */
+[[nodiscard]]
+constexpr char fold_case(char ch) noexcept
+{
+    return ch >= 'A' && ch <= 'Z' ? static_cast<char>(ch - 'A' + 'a') : ch;
+}
+
+inline void fold_case(std::string& str) noexcept
+{
+    for(char& ch : str)
+        ch = fold_case(ch);
+}
+
+/**
+ * @brief Case-folded form of a string for looking it up
+ *
+ * A string not longer than `inline_size` is folded into an inline buffer, so folding a key does not allocate.
+ */
+class folded_string
+{
+public:
+    static constexpr std::size_t inline_size = 256;
+
+    explicit folded_string(std::string_view str)
+    {
+        char* dst = m_buf;
+        if(str.size() > inline_size) [[unlikely]]
+        {
+            m_long.resize(str.size());
+            dst = m_long.data();
+        }
+
+        for(std::size_t i = 0; i < str.size(); ++i)
+            dst[i] = fold_case(str[i]);
+        m_view = std::string_view(dst, str.size());
+    }
+
+    folded_string(const folded_string&) = delete;
+
+    [[nodiscard]]
+    std::string_view view() const noexcept
+    {
+        return m_view;
+    }
+
+private:
+    std::string_view m_view;
+    std::string m_long;
+    char m_buf[inline_size];
+};
+} // namespace lochfolk::detail
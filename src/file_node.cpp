@@ -1,5 +1,8 @@
 #include "file_node.hpp"
+#include <algorithm>
+#include <limits>
 #include <memory>
+#include <numeric>
 #include <fstream>
 #include <sstream>
 #include <lochfolk/vfs.hpp>
@@ -10,6 +13,67 @@ namespace lochfolk
 {
 namespace file_data
 {
+    file_container::file_container(std::pmr::memory_resource* mr, bool fold_case) noexcept
+        : m_map(mr), m_fold_case(fold_case) {}
+
+    file_container::file_container(file_container&&) noexcept = default;
+
+    file_container::~file_container()
+    {
+        clear();
+    }
+
+    file_container& file_container::operator=(file_container&& rhs) noexcept
+    {
+        if(this == &rhs) [[unlikely]]
+            return *this;
+
+        // Nodes must be freed by the resource allocating them
+        assert(*resource() == *rhs.resource());
+        clear();
+        m_map = std::move(rhs.m_map);
+        m_fold_case = rhs.m_fold_case;
+        rhs.m_map.clear();
+
+        return *this;
+    }
+
+    bool file_container::erase(std::string_view name)
+    {
+        if(m_fold_case) [[unlikely]]
+        {
+            detail::folded_string folded(name);
+            return erase_key(folded.view());
+        }
+
+        return erase_key(name);
+    }
+
+    bool file_container::erase_key(std::string_view key)
+    {
+        auto* found = m_map.find(key);
+        if(!found)
+            return false;
+
+        detail::file_node* node = *found;
+        m_map.erase(key);
+        destroy(node);
+
+        return true;
+    }
+
+    void file_container::clear() noexcept
+    {
+        for(const auto& e : m_map)
+            destroy(e.value());
+        m_map.clear();
+    }
+
+    void file_container::destroy(detail::file_node* node) noexcept
+    {
+        std::pmr::polymorphic_allocator<>(m_map.resource()).delete_object(node);
+    }
+
     std::unique_ptr<std::streambuf> string_constant::open(
         std::ios_base::openmode mode
     ) const
@@ -57,6 +121,11 @@ namespace file_data
         );
     }
 
+    std::optional<std::span<const std::byte>> string_constant::view_bytes() const noexcept
+    {
+        return std::as_bytes(std::span(view()));
+    }
+
     std::unique_ptr<std::filebuf> sys_file::open(
         std::ios_base::openmode mode
     ) const
@@ -91,8 +160,8 @@ namespace file_data
         );
     }
 
-    archive_entry::archive_entry(archive& ar, std::int64_t off)
-        : m_archive_ref(ar.shared_from_this()), m_offset(off)
+    archive_entry::archive_entry(archive& ar, std::size_t idx)
+        : m_archive_ref(ar.shared_from_this()), m_index(idx)
     {}
 
     archive_entry& archive_entry::operator=(
@@ -103,7 +172,7 @@ namespace file_data
             return *this;
 
         m_archive_ref = std::move(rhs.m_archive_ref);
-        m_offset = std::exchange(rhs.m_offset, 0);
+        m_index = std::exchange(rhs.m_index, 0);
 
         return *this;
     }
@@ -112,26 +181,84 @@ namespace file_data
         std::ios_base::openmode mode
     ) const
     {
-        return m_archive_ref->getbuf(m_offset, mode);
+        return m_archive_ref->getbuf(m_index, mode);
     }
 
     std::string archive_entry::read_string(bool convert_crlf) const
     {
         (void)convert_crlf;
-        return m_archive_ref->read_string(m_offset);
+        return m_archive_ref->read_string(m_index);
+    }
+
+    std::optional<std::span<const std::byte>> archive_entry::view_bytes() const
+    {
+        return m_archive_ref->view_bytes(m_index);
     }
 
     std::uint64_t archive_entry::file_size() const
     {
-        return m_archive_ref->get_file_size(m_offset);
+        return m_archive_ref->get_file_size(m_index);
+    }
+
+    file_container_type archive_dir::materialize(const detail::file_node* parent) const
+    {
+        file_container_type result(m_names->resource(), m_names->folds_case());
+
+        const auto* children = m_archive_ref->list_dir(m_dir);
+        if(!children)
+            return result;
+        result.reserve(children->files.size() + children->dirs.size());
+
+        for(std::size_t idx : children->files)
+        {
+            std::string_view name = m_archive_ref->entry_name(idx);
+            name = name.substr(name.rfind('/') + 1);
+
+            result.try_emplace(*m_names, name, parent, std::in_place_type<archive_entry>, *m_archive_ref, idx);
+        }
+
+        for(std::string_view name : children->dirs)
+        {
+            std::string sub_dir = m_dir;
+            if(!sub_dir.empty())
+                sub_dir += '/';
+            sub_dir += name;
+
+            result.try_emplace(
+                *m_names, name, parent, std::in_place_type<archive_dir>, *m_names, m_archive_ref, std::move(sub_dir)
+            );
+        }
+
+        return result;
     }
 } // namespace file_data
 
 namespace detail
 {
+    file_node::file_node(const file_node* parent, leaf_data data)
+        : m_parent(parent),
+          m_data(std::visit(
+              []<typename T>(T& v)
+              { return data_type(std::in_place_type<T>, std::move(v)); },
+              data
+          ))
+    {}
+
     bool file_node::is_directory() const noexcept
     {
-        return std::holds_alternative<file_data::directory>(m_data);
+        return std::holds_alternative<file_data::directory>(m_data) ||
+               std::holds_alternative<file_data::archive_dir>(m_data);
+    }
+
+    file_data::directory* file_node::get_directory() const
+    {
+        if(auto* placeholder = std::get_if<file_data::archive_dir>(&m_data))
+        {
+            file_data::file_container_type children = placeholder->materialize(this);
+            m_data.emplace<file_data::directory>(std::move(children));
+        }
+
+        return std::get_if<file_data::directory>(&m_data);
     }
 
     std::uint64_t file_node::file_size() const
@@ -172,9 +299,326 @@ namespace detail
             }
         );
     }
+
+    std::optional<std::span<const std::byte>> file_node::view_bytes() const
+    {
+        return visit(
+            []<typename T>(const T& v) -> std::optional<std::span<const std::byte>>
+            {
+                constexpr bool has_view_bytes = requires() { v.view_bytes(); };
+                if constexpr(has_view_bytes)
+                    return v.view_bytes();
+                return std::nullopt;
+            }
+        );
+    }
+
+    leaf_data file_node::release_file() const
+    {
+        return std::visit(
+            []<typename T>(T& v) -> leaf_data
+            {
+                if constexpr(std::is_constructible_v<leaf_data, T&&>)
+                    return leaf_data(std::move(v));
+                throw virtual_file_system::error("bad file");
+            },
+            m_data
+        );
+    }
+
+    void file_node::assign_file(leaf_data data) const
+    {
+        std::visit(
+            [this]<typename T>(T& v)
+            { m_data.emplace<T>(std::move(v)); },
+            data
+        );
+    }
+
+    const file_node* path_index::find(std::string_view key) const noexcept
+    {
+        if constexpr(!enabled)
+            return nullptr;
+
+        if(m_fold_case) [[unlikely]]
+        {
+            folded_string folded(key);
+            const auto* found = m_map.find(folded.view());
+            return found ? *found : nullptr;
+        }
+
+        const auto* found = m_map.find(key);
+        return found ? *found : nullptr;
+    }
+
+    void path_index::insert(std::string_view key, const file_node* node)
+    {
+        if constexpr(!enabled)
+            return;
+
+        if(m_fold_case) [[unlikely]]
+        {
+            folded_string folded(key);
+            insert_key(folded.view(), node);
+            return;
+        }
+
+        insert_key(key, node);
+    }
+
+    void path_index::insert_key(std::string_view key, const file_node* node)
+    {
+        auto [value, inserted] = m_map.try_emplace(key, node);
+        if(!inserted)
+            *value = node;
+        if(m_index_extensions)
+            insert_extension(key, node);
+    }
+
+    void path_index::erase(std::string_view key) noexcept
+    {
+        if constexpr(!enabled)
+            return;
+
+        if(m_fold_case) [[unlikely]]
+        {
+            folded_string folded(key);
+            erase_key(folded.view());
+            return;
+        }
+
+        erase_key(key);
+    }
+
+    void path_index::erase_key(std::string_view key) noexcept
+    {
+        if(m_map.erase(key) && m_index_extensions)
+            erase_extension(key);
+    }
+
+    void path_index::erase_descendants(std::string_view key, const file_node& node)
+    {
+        if constexpr(!enabled)
+            return;
+
+        if(!node.get_if<file_data::directory>())
+            return;
+
+        try
+        {
+            std::string buf(key);
+            erase_descendants_impl(buf, node);
+        }
+        catch(...)
+        {
+            // Keys erased before the error still have their nodes in the tree, which is walked for them instead
+            m_complete = false;
+            throw;
+        }
+    }
+
+    void path_index::erase_descendants_impl(std::string& key, const file_node& node)
+    {
+        const auto* dir = node.get_if<file_data::directory>();
+        if(!dir)
+            return;
+
+        const std::size_t size = key.size();
+        for(const auto& e : dir->children())
+        {
+            key.resize(size);
+            if(key.back() != path_view::separator)
+                key += path_view::separator;
+            key += e.key();
+
+            erase_descendants_impl(key, *e.value());
+            erase(key);
+        }
+        key.resize(size);
+    }
+
+    void path_index::clear() noexcept
+    {
+        m_map.clear();
+        m_extensions.clear();
+        m_complete = true;
+    }
+
+    void path_index::index_extensions(bool enable)
+    {
+        if constexpr(!enabled)
+            return;
+
+        if(enable == m_index_extensions)
+            return;
+        m_index_extensions = enable;
+
+        m_extensions.clear();
+        if(enable)
+        {
+            for(const auto& e : m_map)
+                insert_extension(e.key(), e.value());
+        }
+    }
+
+    auto path_index::find_extension(std::string_view ext) const noexcept -> const extension_bucket*
+    {
+        if(!m_index_extensions)
+            return nullptr;
+
+        return m_extensions.find(ext);
+    }
+
+    void path_index::insert_extension(std::string_view key, const file_node* node)
+    {
+        std::string_view ext = extension_of(key);
+        if(ext.empty())
+            return;
+
+        auto* bucket = m_extensions.try_emplace(ext, m_extensions.resource()).first;
+        auto [value, inserted] = bucket->try_emplace(key, node);
+        if(!inserted)
+            *value = node;
+    }
+
+    void path_index::erase_extension(std::string_view key) noexcept
+    {
+        std::string_view ext = extension_of(key);
+        if(ext.empty())
+            return;
+
+        auto* bucket = m_extensions.find(ext);
+        if(!bucket)
+            return;
+        bucket->erase(key);
+        if(bucket->empty())
+            m_extensions.erase(ext);
+    }
+
+    std::size_t path_index::memory_usage() const noexcept
+    {
+        if constexpr(!enabled)
+            return 0;
+
+        std::size_t result = m_map.memory_usage() + m_extensions.memory_usage();
+        for(const auto& e : m_extensions)
+            result += e.value().memory_usage();
+
+        return result;
+    }
+
+    std::string path_index::child_key(std::string_view parent, std::string_view name)
+    {
+        std::string result;
+        result.reserve(parent.size() + name.size() + 1);
+        result += parent;
+        if(result.empty() || result.back() != path_view::separator)
+            result += path_view::separator;
+        result += name;
+
+        return result;
+    }
+
+    std::string path_index::key_of(path_view p)
+    {
+        std::string result = "/";
+        for(path_view subview : p)
+        {
+            if(std::string_view(subview) == "/")
+                continue;
+            if(result.size() > 1)
+                result += path_view::separator;
+            result += std::string_view(subview);
+        }
+
+        return result;
+    }
+
+    std::string_view path_index::extension_of(std::string_view key) noexcept
+    {
+        std::string_view name = key.substr(key.rfind(path_view::separator) + 1);
+        std::size_t pos = name.rfind('.');
+        if(pos == std::string_view::npos)
+            return std::string_view();
+
+        return name.substr(pos);
+    }
+
+    bool path_index::is_key(std::string_view p) noexcept
+    {
+        if(p.empty() || p[0] != path_view::separator)
+            return false;
+        if(p.size() == 1)
+            return true;
+        if(p.back() == path_view::separator)
+            return false;
+
+        std::size_t start = 1;
+        while(start <= p.size())
+        {
+            std::size_t end = p.find(path_view::separator, start);
+            if(end == std::string_view::npos)
+                end = p.size();
+
+            std::string_view component = p.substr(start, end - start);
+            if(component.empty() || component == "." || component == "..")
+                return false;
+
+            start = end + 1;
+        }
+
+        return true;
+    }
+
+    file_tree::file_tree(std::pmr::memory_resource* mr, bool fold_case)
+        : names(mr, fold_case),
+          root(nullptr, std::in_place_type<file_data::directory>, mr, fold_case),
+          index(mr, fold_case)
+    {
+        index.insert("/", &root);
+    }
+
+    std::string file_tree::key_of(path_view p) const
+    {
+        std::string result = path_index::key_of(p);
+        if(names.folds_case())
+            fold_case(result);
+
+        return result;
+    }
 } // namespace detail
 
-const detail::file_node* find_impl(const detail::file_node& root, path_view p)
+/**
+ * @brief Find a child of a node
+ *
+ * @param blocked Null for materializing the placeholder of a lazily mounted archive.
+ *                Otherwise, the lookup stops at a placeholder and sets it to true.
+ */
+static const detail::file_node* child_impl(const detail::file_node& current, std::string_view name, bool* blocked)
+{
+    const file_data::directory* dir = nullptr;
+    if(!blocked)
+        dir = current.get_directory();
+    else if(current.get_if<file_data::archive_dir>())
+    {
+        *blocked = true;
+        return nullptr;
+    }
+    else
+        dir = current.get_if<file_data::directory>();
+    if(!dir)
+        return nullptr;
+
+    return dir->children().find(name);
+}
+
+/**
+ * @brief Walk the tree from the root
+ *
+ * @param blocked Null for materializing placeholders of lazily mounted archives on the way.
+ *                Otherwise, the walk stops at the first placeholder and sets it to true.
+ */
+static const detail::file_node* walk_impl(const detail::file_node& root, path_view p, bool* blocked)
 {
     if(p.empty() || !p.is_absolute()) [[unlikely]]
         return nullptr;
@@ -190,55 +634,432 @@ const detail::file_node* find_impl(const detail::file_node& root, path_view p)
             continue;
         }
 
-        auto* dir = current->get_if<file_data::directory>();
-        if(!dir)
+        current = child_impl(*current, std::string_view(subview), blocked);
+        if(!current)
             return nullptr;
+    }
 
-        auto it = dir->children().find(std::string_view(subview));
-        if(it == dir->children().end())
-            return nullptr;
+    return current;
+}
+
+/**
+ * @brief Probe the path index, and walk the tree only if the index cannot answer
+ */
+static const detail::file_node* find_tree_impl(const detail::file_tree& tree, path_view p, bool* blocked)
+{
+    if(const auto* found = tree.index.find(std::string_view(p)))
+        return found;
+    if(detail::path_index::enabled && tree.index.complete() && detail::path_index::is_key(std::string_view(p)))
+        return nullptr;
+
+    return walk_impl(tree.root, p, blocked);
+}
+
+const detail::file_node* find_impl(const detail::file_tree& tree, path_view p)
+{
+    return find_tree_impl(tree, p, nullptr);
+}
+
+const detail::file_node* try_find_impl(const detail::file_tree& tree, path_view p, bool& blocked)
+{
+    blocked = false;
+    return find_tree_impl(tree, p, &blocked);
+}
+
+const detail::file_node* find_impl(const detail::file_node& root, path_view p)
+{
+    return walk_impl(root, p, nullptr);
+}
+
+const detail::file_node* find_relative_impl(const detail::file_node& dir, path_view p, bool* blocked)
+{
+    assert(!p.is_absolute());
+    if(p.empty())
+        return &dir;
+
+    const auto* current = &dir;
+    for(path_view subview : p)
+    {
+        const std::string_view name(subview);
+        if(name == ".")
+            continue;
+        if(name == "..")
+        {
+            if(current->parent())
+                current = current->parent();
+            continue;
+        }
 
-        current = &it->second;
+        current = child_impl(*current, name, blocked);
+        if(!current)
+            return nullptr;
     }
 
     return current;
 }
 
-const detail::file_node* mkdir_impl(detail::file_node& root, path_view p)
+bool remove_impl(detail::file_tree& tree, path_view p)
 {
-    assert(root.is_directory());
+    if(p.empty() || !p.is_absolute()) [[unlikely]]
+        return false;
 
-    const auto* current = &root;
+    if(p == "/"_pv)
+    {
+        auto* root_dir = tree.root.get_directory();
+        assert(root_dir);
+
+        root_dir->children().clear();
+        tree.index.clear();
+        tree.index.insert("/", &tree.root);
+        return true;
+    }
+
+    auto* parent = find_impl(tree, p.parent_path());
+    if(!parent || !parent->is_directory())
+        return false;
+
+    std::string_view target_sv = [](path_view pv)
+    {
+        std::string_view result(pv);
+        if(result.back() == path_view::separator)
+            result.remove_suffix(1);
+
+        std::size_t pos = result.rfind(path_view::separator);
+        if(pos == std::string_view::npos)
+            pos = 0;
+        return result.substr(pos + 1);
+    }(p);
+
+    auto* parent_dir = parent->get_directory();
+    const auto* target = parent_dir->children().find(target_sv);
+    if(!target)
+        return false;
+
+    if constexpr(detail::path_index::enabled)
+    {
+        std::string key = detail::path_index::key_of(p);
+        tree.index.erase_descendants(key, *target);
+        tree.index.erase(key);
+    }
+
+    return parent_dir->children().erase(target_sv);
+}
+
+const detail::file_node* mkdir_impl(detail::file_tree& tree, path_view p, std::string* key)
+{
+    using detail::path_index;
+
+    assert(tree.root.is_directory());
+
+    std::string current_key = "/";
+    const auto* current = &tree.root;
     for(path_view subview : p)
     {
         if(std::string_view(subview) == "/")
             continue;
 
+        if constexpr(path_index::enabled)
+        {
+            if(current_key.size() > 1)
+                current_key += path_view::separator;
+            current_key += std::string_view(subview);
+        }
+
         assert(current->is_directory());
-        auto* dir = current->get_if<file_data::directory>();
+        auto* dir = current->get_directory();
         assert(dir);
 
-        auto it = dir->children().find(std::string_view(subview));
-        if(it != dir->children().end())
+        auto [child, inserted] = dir->children().try_emplace(
+            tree.names,
+            std::string_view(subview),
+            current,
+            std::in_place_type<file_data::directory>,
+            tree.resource(),
+            tree.names.folds_case()
+        );
+        if(!inserted && !child->is_directory())
+        {
+            throw virtual_file_system::error(vfs_err_msg(subview, " already exists"));
+        }
+        if constexpr(path_index::enabled)
+        {
+            if(inserted)
+                tree.index.insert(current_key, child);
+        }
+
+        current = child;
+    }
+
+    if(key)
+        *key = std::move(current_key);
+    return current;
+}
+
+detail::batch_entry::batch_entry(std::string_view base_key, std::string_view rel, leaf_data d)
+    : key(base_key), name_pos(0), data(std::move(d))
+{
+    assert(detail::path_index::is_key(base_key));
+
+    while(!rel.empty())
+    {
+        std::size_t end = rel.find(path_view::separator);
+        if(end == std::string_view::npos)
+            end = rel.size();
+
+        if(end != 0)
         {
-            if(!it->second.is_directory())
+            if(key.size() > 1)
+                key += path_view::separator;
+            name_pos = key.size();
+            key += rel.substr(0, end);
+        }
+
+        rel.remove_prefix(std::min(end + 1, rel.size()));
+    }
+
+    if(name_pos == 0) [[unlikely]]
+        throw virtual_file_system::error(vfs_err_msg(path_view(key), " is not a file path"));
+}
+
+detail::batch_entry::batch_entry(std::string normalized_key, leaf_data d)
+    : key(std::move(normalized_key)), name_pos(key.rfind(path_view::separator) + 1), data(std::move(d))
+{
+    assert(detail::path_index::is_key(key));
+
+    if(key.size() == 1) [[unlikely]]
+        throw virtual_file_system::error(vfs_err_msg(path_view(key), " is not a file path"));
+}
+
+/**
+ * @brief Throw if mounting a sorted batch would fail partway through, before anything is changed
+ *
+ * Mounting fails when a directory of an entry is a file, either one already in the tree
+ * or one mounted by the batch itself.
+ */
+static void check_batch_conflicts(
+    const detail::file_tree& tree,
+    std::span<const detail::batch_entry> entries,
+    std::span<const std::uint32_t> order,
+    bool overwrite
+)
+{
+    const bool fold = tree.names.folds_case();
+
+    // Keys of the directories the batch needs, including their parents
+    std::vector<std::string> dirs;
+    std::string_view last_dir;
+    for(std::uint32_t idx : order)
+    {
+        const std::string_view dir_key = entries[idx].dir();
+        if(dir_key == last_dir)
+            continue;
+
+        for(std::size_t pos = dir_key.size(); pos > 1; pos = dir_key.rfind(path_view::separator, pos - 1))
+        {
+            const std::string_view prefix = dir_key.substr(0, pos);
+            // Parents shared with the previous directory are checked already
+            if(last_dir.starts_with(prefix) &&
+               (last_dir.size() == prefix.size() || last_dir[prefix.size()] == path_view::separator))
+                break;
+
+            if(const auto* node = find_impl(tree, path_view(prefix)); node && !node->is_directory())
+                throw virtual_file_system::error(vfs_err_msg(path_view(prefix), " already exists"));
+
+            dirs.emplace_back(prefix);
+            if(fold)
+                detail::fold_case(dirs.back());
+        }
+        last_dir = dir_key;
+    }
+    if(dirs.empty())
+        return;
+    std::ranges::sort(dirs);
+
+    for(const auto& e : entries)
+    {
+        const bool is_dir = fold ? std::ranges::binary_search(dirs, detail::folded_string(e.key).view())
+                                 : std::ranges::binary_search(dirs, std::string_view(e.key));
+        if(!is_dir)
+            continue;
+
+        // The file is skipped if the directory is already in the tree and is not overwritten
+        if(overwrite || !find_impl(tree, path_view(std::string_view(e.key))))
+            throw virtual_file_system::error(vfs_err_msg(path_view(std::string_view(e.key)), " already exists"));
+    }
+}
+
+void mount_batch_impl(detail::file_tree& tree, std::span<detail::batch_entry> entries, bool overwrite)
+{
+    using detail::path_index;
+
+    if(entries.size() > std::numeric_limits<std::uint32_t>::max()) [[unlikely]]
+        throw virtual_file_system::error("too many files to mount");
+
+    auto by_dir = [](const detail::batch_entry& lhs, const detail::batch_entry& rhs)
+    {
+        if(auto cmp = lhs.dir() <=> rhs.dir(); cmp != 0)
+            return cmp < 0;
+        return lhs.name() < rhs.name();
+    };
+
+    // Positions are sorted instead of the entries, which are large. Sources like directory iterators and
+    // archives often list files of a directory together already, and the sort is skipped for them.
+    std::vector<std::uint32_t> order(entries.size());
+    std::iota(order.begin(), order.end(), 0u);
+    if(!std::ranges::is_sorted(entries, by_dir))
+    {
+        std::ranges::sort(
+            order,
+            [&](std::uint32_t lhs, std::uint32_t rhs)
             {
-                throw virtual_file_system::error(vfs_err_msg(subview, " already exists"));
+                if(by_dir(entries[lhs], entries[rhs]))
+                    return true;
+                if(by_dir(entries[rhs], entries[lhs]))
+                    return false;
+                // Entries of the same path are mounted in order
+                return lhs < rhs;
+            }
+        );
+    }
+
+    check_batch_conflicts(tree, entries, order, overwrite);
+
+    for(std::size_t i = 0; i < order.size();)
+    {
+        const std::string_view dir_key = entries[order[i]].dir();
+        std::size_t group_end = i + 1;
+        while(group_end < order.size() && entries[order[group_end]].dir() == dir_key)
+            ++group_end;
+
+        const auto* parent = mkdir_impl(tree, path_view(dir_key));
+        auto* dir = parent->get_directory();
+        assert(dir);
+        dir->children().reserve(dir->children().size() + (group_end - i));
+
+        for(; i < group_end; ++i)
+        {
+            detail::batch_entry& e = entries[order[i]];
+            auto [node, inserted] = dir->children().try_emplace(tree.names, e.name(), parent, std::move(e.data));
+            if(inserted)
+            {
+                if constexpr(path_index::enabled)
+                    tree.index.insert(e.key, node);
+            }
+            else if(overwrite)
+            {
+                // The node is reused, but the descendants of a replaced directory are destroyed
+                if constexpr(path_index::enabled)
+                {
+                    if(node->is_directory())
+                        tree.index.erase_descendants(e.key, *node);
+                }
+
+                *node = detail::file_node(parent, std::move(e.data));
             }
         }
-        else
+    }
+}
+
+/**
+ * @brief Merge a directory of a lazily mounted archive into an existing directory
+ */
+static void merge_archive_dir(
+    detail::file_tree& tree,
+    std::string_view key,
+    const detail::file_node& node,
+    const std::shared_ptr<zip_archive>& ar,
+    std::string_view dir,
+    bool overwrite
+)
+{
+    const auto* children = ar->list_dir(dir);
+    if(!children)
+        return;
+
+    auto* target = node.get_directory();
+    assert(target);
+
+    for(std::size_t idx : children->files)
+    {
+        std::string_view name = ar->entry_name(idx);
+        name = name.substr(name.rfind('/') + 1);
+
+        auto [child, inserted] = target->children().try_emplace(
+            tree.names, name, &node, std::in_place_type<file_data::archive_entry>, *ar, idx
+        );
+        if(!inserted && overwrite)
+        {
+            if(child->is_directory())
+            {
+                std::string child_key = detail::path_index::child_key(key, name);
+                tree.index.erase_descendants(child_key, *child);
+            }
+            *child = detail::file_node(
+                &node, std::in_place_type<file_data::archive_entry>, *ar, idx
+            );
+        }
+    }
+
+    for(std::string_view name : children->dirs)
+    {
+        std::string sub_dir(dir);
+        if(!sub_dir.empty())
+            sub_dir += '/';
+        sub_dir += name;
+
+        auto* child = target->children().find(name);
+        if(!child)
         {
-            it = dir->children().emplace_hint(
-                it,
-                subview.string(),
-                detail::file_node(current, std::in_place_type<file_data::directory>)
+            target->children().try_emplace(
+                tree.names, name, &node, std::in_place_type<file_data::archive_dir>, tree.names, ar, std::move(sub_dir)
             );
         }
+        else if(!child->is_directory())
+        {
+            throw virtual_file_system::error(vfs_err_msg(path_view(name), " already exists"));
+        }
+        else
+        {
+            merge_archive_dir(tree, detail::path_index::child_key(key, name), *child, ar, sub_dir, overwrite);
+        }
+    }
+}
+
+void mount_lazy_archive_impl(
+    detail::file_tree& tree,
+    path_view p,
+    std::shared_ptr<zip_archive> ar,
+    bool overwrite
+)
+{
+    assert(p.is_absolute());
 
-        current = &it->second;
+    // Nodes of the archive will be created without being indexed
+    tree.index.mark_incomplete();
+
+    if(const auto* target = find_impl(tree, p))
+    {
+        if(!target->is_directory())
+            throw virtual_file_system::error(vfs_err_msg(p, " already exists"));
+
+        merge_archive_dir(tree, detail::path_index::key_of(p), *target, ar, std::string_view(), overwrite);
+        return;
     }
 
-    return current;
+    std::string_view name(p);
+    if(name.back() == path_view::separator)
+        name.remove_suffix(1);
+    name = name.substr(name.rfind(path_view::separator) + 1);
+
+    std::string parent_key;
+    const auto* parent = mkdir_impl(tree, p.parent_path(), &parent_key);
+    auto* dir = parent->get_directory();
+    assert(dir);
+    auto [placeholder, inserted] = dir->children().try_emplace(
+        tree.names, name, parent, std::in_place_type<file_data::archive_dir>, tree.names, std::move(ar), std::string()
+    );
+    if(inserted)
+        tree.index.insert(detail::path_index::child_key(parent_key, name), placeholder);
 }
 
 void list_files_impl(
@@ -258,11 +1079,11 @@ void list_files_impl(
 
     if(is_dir)
     {
-        auto* dir = f.get_if<file_data::directory>();
+        auto* dir = f.get_directory();
         assert(dir != nullptr);
-        for(const auto& [sub_name, sub_f] : dir->children())
+        for(const auto* sub : dir->children().sorted())
         {
-            list_files_impl(os, sub_name, sub_f, indent + 1);
+            list_files_impl(os, dir->children().spelling(*sub), *sub->value(), indent + 1);
         }
     }
 }
@@ -2,14 +2,24 @@
 
 #include <cassert>
 #include <cstdint>
+#include <functional>
 #include <iosfwd>
 #include <map>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <variant>
+#include <vector>
 #include <memory>
 #include <filesystem>
 #include <lochfolk/path.hpp>
 #include "archive.hpp"
+#include "case_fold.hpp"
+#include "flat_string_map.hpp"
+#include "name_pool.hpp"
 
 namespace lochfolk
 {
@@ -18,34 +28,202 @@ namespace detail
     class file_node;
 }
 
-struct string_compare
+namespace file_data
 {
-    using is_transparent = void;
-
-    bool operator()(std::string_view lhs, std::string_view rhs) const
+    /**
+     * @brief Children of a directory
+     *
+     * Names are kept in a flat hash map, so a lookup probes a flat array and compares the keys
+     * without touching the nodes. Nodes are allocated separately, so pointers to them stay valid until they are removed.
+     * The keys are views of names interned in the `name_pool` of the tree, which outlives the container.
+     * Nodes and the map are allocated from the memory resource of the tree.
+     *
+     * A container of a case-insensitive tree keys on case-folded names, which are computed once on insertion.
+     * Lookups fold the name into a stack buffer, so they stay allocation-free. The original spelling is interned
+     * right after the folded name, and `spelling` gets it for display.
+     *
+     * @note Iteration follows no particular order. Use `sorted()` for the order of names.
+     */
+    class file_container
     {
-        return lhs < rhs;
-    }
+        // Values are owning pointers, destroyed by the container
+        using map_type = detail::flat_string_map<detail::file_node*, std::string_view>;
 
-    bool operator()(path_view lhs, std::string_view rhs) const
-    {
-        return std::string_view(lhs) < rhs;
-    }
+    public:
+        using entry = map_type::entry;
+        using const_iterator = map_type::const_iterator;
 
-    bool operator()(std::string_view lhs, path_view rhs) const
-    {
-        return lhs < std::string_view(rhs);
-    }
-};
+        /**
+         * @param fold_case True for keying on case-folded names
+         */
+        file_container(std::pmr::memory_resource* mr, bool fold_case) noexcept;
 
-namespace file_data
-{
-    using file_container_type = std::map<std::string, detail::file_node, string_compare>;
+        file_container(file_container&&) noexcept;
+
+        ~file_container();
+
+        /**
+         * @note Both containers must use the same memory resource
+         */
+        file_container& operator=(file_container&&) noexcept;
+
+        [[nodiscard]]
+        detail::file_node* find(std::string_view name) const noexcept
+        {
+            if(m_fold_case) [[unlikely]]
+                return find_key(detail::folded_string(name).view());
+            return find_key(name);
+        }
+
+        /**
+         * @brief Insert a node if the name does not exist
+         *
+         * @param names Pool for interning the name of the new node
+         *
+         * @return The node of the name, and whether it is newly inserted
+         */
+        template <typename... Args>
+        std::pair<detail::file_node*, bool> try_emplace(detail::name_pool& names, std::string_view name, Args&&... args)
+        {
+            if(m_fold_case) [[unlikely]]
+            {
+                detail::folded_string folded(name);
+                return emplace_key(names, folded.view(), name, std::forward<Args>(args)...);
+            }
+
+            return emplace_key(names, name, name, std::forward<Args>(args)...);
+        }
+
+        /**
+         * @brief Find the entry of a name, for getting its spelling along with its node
+         */
+        [[nodiscard]]
+        const entry* find_entry(std::string_view name) const noexcept
+        {
+            if(m_fold_case) [[unlikely]]
+            {
+                detail::folded_string folded(name);
+                return m_map.find_entry(folded.view(), map_type::hash_key(folded.view()));
+            }
+
+            return m_map.find_entry(name, map_type::hash_key(name));
+        }
+
+        bool erase(std::string_view name);
+
+        void clear() noexcept;
+
+        /**
+         * @brief Original spelling of the name of an entry
+         */
+        [[nodiscard]]
+        std::string_view spelling(const entry& e) const noexcept
+        {
+            if(m_fold_case)
+                return detail::name_pool::spelling_of(e.key());
+            return e.key();
+        }
+
+        [[nodiscard]]
+        bool folds_case() const noexcept
+        {
+            return m_fold_case;
+        }
+
+        [[nodiscard]]
+        std::pmr::memory_resource* resource() const noexcept
+        {
+            return m_map.resource();
+        }
+
+        void reserve(std::size_t n)
+        {
+            m_map.reserve(n);
+        }
+
+        [[nodiscard]]
+        std::size_t size() const noexcept
+        {
+            return m_map.size();
+        }
+
+        [[nodiscard]]
+        bool empty() const noexcept
+        {
+            return m_map.empty();
+        }
+
+        const_iterator begin() const noexcept
+        {
+            return m_map.begin();
+        }
+
+        const_iterator end() const noexcept
+        {
+            return m_map.end();
+        }
+
+        /**
+         * @brief Entries sorted by name
+         */
+        [[nodiscard]]
+        std::vector<const entry*> sorted() const
+        {
+            return m_map.sorted();
+        }
+
+    private:
+        [[nodiscard]]
+        detail::file_node* find_key(std::string_view key) const noexcept
+        {
+            const auto* found = m_map.find(key);
+            return found ? *found : nullptr;
+        }
+
+        /**
+         * @param key Name in the form of the keys, i.e. folded if this container folds case
+         */
+        template <typename... Args>
+        std::pair<detail::file_node*, bool> emplace_key(
+            detail::name_pool& names, std::string_view key, std::string_view spelling, Args&&... args
+        )
+        {
+            // The name is hashed once for both the lookup and the pool
+            const std::size_t hash = map_type::hash_key(key);
+            if(auto* found = m_map.find_entry(key, hash))
+                return std::make_pair(found->value(), false);
+
+            std::string_view stored = m_fold_case ? names.intern_spelled(key, spelling) : names.intern(key, hash);
+            std::pmr::polymorphic_allocator<> alloc(m_map.resource());
+            auto* node = alloc.new_object<detail::file_node>(std::forward<Args>(args)...);
+            try
+            {
+                m_map.emplace_new(stored, hash, node);
+            }
+            catch(...)
+            {
+                destroy(node);
+                throw;
+            }
+
+            return std::make_pair(node, true);
+        }
+
+        bool erase_key(std::string_view key);
+
+        void destroy(detail::file_node* node) noexcept;
+
+        map_type m_map;
+        bool m_fold_case;
+    };
+
+    using file_container_type = file_container;
 
     class directory
     {
     public:
-        directory() = default;
+        directory(std::pmr::memory_resource* mr, bool fold_case) noexcept
+            : m_children(mr, fold_case) {}
 
         directory(directory&&) noexcept = default;
 
@@ -83,6 +261,8 @@ namespace file_data
             std::string,
             std::string_view>;
 
+        string_constant(const string_constant&) = default;
+
         string_constant(string_constant&&) noexcept = default;
 
         string_constant(std::string str) noexcept
@@ -102,6 +282,8 @@ namespace file_data
         [[nodiscard]]
         std::string_view view() const noexcept;
 
+        std::optional<std::span<const std::byte>> view_bytes() const noexcept;
+
     private:
         string_data m_str_data;
     };
@@ -109,6 +291,8 @@ namespace file_data
     class sys_file
     {
     public:
+        sys_file(const sys_file&) = default;
+
         sys_file(sys_file&&) noexcept = default;
 
         sys_file(std::filesystem::path sys_path)
@@ -135,9 +319,11 @@ namespace file_data
     struct archive_entry
     {
     public:
+        archive_entry(const archive_entry&) = default;
+
         archive_entry(archive_entry&&) noexcept = default;
 
-        archive_entry(archive& ar, std::int64_t off);
+        archive_entry(archive& ar, std::size_t idx);
 
         archive_entry& operator=(archive_entry&& rhs) noexcept;
 
@@ -145,16 +331,87 @@ namespace file_data
 
         std::string read_string(bool convert_crlf) const;
 
+        std::optional<std::span<const std::byte>> view_bytes() const;
+
         std::uint64_t file_size() const;
 
+        const std::shared_ptr<archive>& get_archive() const noexcept
+        {
+            return m_archive_ref;
+        }
+
+        std::size_t index() const noexcept
+        {
+            return m_index;
+        }
+
     private:
         std::shared_ptr<archive> m_archive_ref;
-        std::int64_t m_offset;
+        // Index of the entry in the archive
+        std::size_t m_index;
+    };
+
+    /**
+     * @brief Placeholder of a directory in a lazily mounted archive
+     *
+     * It will be replaced by a directory when its children are accessed for the first time.
+     */
+    class archive_dir
+    {
+    public:
+        archive_dir(archive_dir&&) noexcept = default;
+
+        archive_dir(detail::name_pool& names, std::shared_ptr<zip_archive> ar, std::string dir)
+            : m_names(&names), m_archive_ref(std::move(ar)), m_dir(std::move(dir)) {}
+
+        archive_dir& operator=(archive_dir&& rhs) noexcept = default;
+
+        /**
+         * @brief Always returns 0 as a placeholder
+         */
+        std::uint64_t file_size() const noexcept
+        {
+            return 0;
+        }
+
+        /**
+         * @brief Create nodes for the children of this directory
+         *
+         * Subdirectories are created as placeholders, too. Names are interned in the pool of the tree,
+         * and nodes are allocated from its memory resource.
+         */
+        file_container_type materialize(const detail::file_node* parent) const;
+
+        const std::shared_ptr<zip_archive>& get_archive() const noexcept
+        {
+            return m_archive_ref;
+        }
+
+        /**
+         * @brief Path of this directory in the archive, empty for the root directory
+         */
+        std::string_view dir() const noexcept
+        {
+            return m_dir;
+        }
+
+    private:
+        detail::name_pool* m_names;
+        std::shared_ptr<zip_archive> m_archive_ref;
+        std::string m_dir;
     };
 } // namespace file_data
 
 namespace detail
 {
+    /**
+     * @brief Data of a file, i.e. a node that is not a directory
+     */
+    using leaf_data = std::variant<
+        file_data::string_constant,
+        file_data::sys_file,
+        file_data::archive_entry>;
+
     class file_node
     {
     public:
@@ -166,6 +423,8 @@ namespace detail
               m_data(std::in_place_type<T>, std::forward<Args>(args)...)
         {}
 
+        file_node(const file_node* parent, leaf_data data);
+
         file_node(file_node&&) noexcept = default;
 
         file_node& operator=(file_node&& rhs) noexcept
@@ -182,7 +441,8 @@ namespace detail
             file_data::directory,
             file_data::string_constant,
             file_data::sys_file,
-            file_data::archive_entry>;
+            file_data::archive_entry,
+            file_data::archive_dir>;
 
         template <typename Visitor>
         decltype(auto) visit(Visitor&& vis) const
@@ -196,70 +456,386 @@ namespace detail
             return std::get_if<T>(&m_data);
         }
 
+        /**
+         * @brief Directory containing this node, or null for the root
+         */
+        [[nodiscard]]
+        const file_node* parent() const noexcept
+        {
+            return m_parent;
+        }
+
         [[nodiscard]]
         bool is_directory() const noexcept;
 
+        /**
+         * @brief Get the directory data, materializing the placeholder of a lazily mounted archive if necessary
+         *
+         * @return nullptr if this node is not a directory
+         */
+        file_data::directory* get_directory() const;
+
         std::uint64_t file_size() const;
 
         std::unique_ptr<std::streambuf> getbuf(std::ios_base::openmode mode) const;
 
         std::string read_string(bool convert_crlf = true) const;
 
+        /**
+         * @brief Get a view of the content if it is available in memory without copying
+         */
+        std::optional<std::span<const std::byte>> view_bytes() const;
+
+        /**
+         * @brief Move the data of a file out of this node
+         *
+         * @note The node must be a file. It is left in a valid but unspecified state until `assign_file` is called.
+         */
+        leaf_data release_file() const;
+
+        /**
+         * @brief Replace the data of this node with a file, keeping its parent and address
+         */
+        void assign_file(leaf_data data) const;
+
     private:
         const file_node* m_parent;
         mutable data_type m_data;
     };
+
+    /**
+     * @brief Hash index from normalized absolute paths to nodes, so a lookup is a single probe
+     *
+     * Nodes created by mounting are indexed. Nodes created when materializing a lazily mounted archive are not,
+     * so the index becomes incomplete after mounting an archive lazily and a missed lookup must walk the tree.
+     *
+     * @note Define `LOCHFOLK_NO_PATH_INDEX` when building the library to disable it for saving memory
+     */
+    class path_index
+    {
+    public:
+#ifdef LOCHFOLK_NO_PATH_INDEX
+        static constexpr bool enabled = false;
+#else
+        static constexpr bool enabled = true;
+#endif
+
+        /**
+         * @param fold_case True for keying on case-folded paths. Keys passed to the index are folded by it.
+         */
+        path_index(std::pmr::memory_resource* mr, bool fold_case)
+            : m_map(mr), m_extensions(mr), m_fold_case(fold_case) {}
+
+        /**
+         * @brief Find an indexed node by its normalized absolute path
+         */
+        [[nodiscard]]
+        const file_node* find(std::string_view key) const noexcept;
+
+        void insert(std::string_view key, const file_node* node);
+
+        void erase(std::string_view key) noexcept;
+
+        /**
+         * @brief Remove the indices of all descendants of a node
+         *
+         * Directories that have not been materialized are skipped, because their descendants are not indexed.
+         * Keys of the descendants are built in a single buffer.
+         *
+         * @note If allocating the buffer throws, the index is marked incomplete, since some keys may have been erased
+         */
+        void erase_descendants(std::string_view key, const file_node& node);
+
+        void clear() noexcept;
+
+        /**
+         * @brief Indexed nodes by their full paths
+         */
+        using extension_bucket = flat_string_map<const file_node*, std::pmr::string>;
+
+        /**
+         * @brief Also index the keys by the extensions of their names, so a query of an extension needs no walk
+         *
+         * Enabling it indexes the existing keys. Keys without an extension are not indexed.
+         */
+        void index_extensions(bool enable);
+
+        /**
+         * @brief Indexed nodes whose names have an extension
+         *
+         * @return nullptr if there is none or extensions are not indexed
+         */
+        [[nodiscard]]
+        const extension_bucket* find_extension(std::string_view ext) const noexcept;
+
+        [[nodiscard]]
+        bool indexes_extensions() const noexcept
+        {
+            return m_index_extensions;
+        }
+
+        /**
+         * @brief True if all nodes of the tree are indexed, so a missed lookup of a normalized path can fail directly
+         */
+        [[nodiscard]]
+        bool complete() const noexcept
+        {
+            return m_complete;
+        }
+
+        void mark_incomplete() noexcept
+        {
+            m_complete = false;
+        }
+
+        /**
+         * @brief Estimated heap memory used by the index in bytes
+         */
+        [[nodiscard]]
+        std::size_t memory_usage() const noexcept;
+
+        /**
+         * @brief Path of a child in the index
+         */
+        [[nodiscard]]
+        static std::string child_key(std::string_view parent, std::string_view name);
+
+        /**
+         * @brief Normalized form of an absolute path used as the key
+         */
+        [[nodiscard]]
+        static std::string key_of(path_view p);
+
+        /**
+         * @brief Check if a path is in the form of the keys
+         *
+         * i.e. absolute without ".", "..", empty components or a trailing separator.
+         */
+        [[nodiscard]]
+        static bool is_key(std::string_view p) noexcept;
+
+        /**
+         * @brief Part of the last name of a key from its last dot, or empty if it has no dot
+         */
+        [[nodiscard]]
+        static std::string_view extension_of(std::string_view key) noexcept;
+
+    private:
+        void insert_key(std::string_view key, const file_node* node);
+
+        void erase_key(std::string_view key) noexcept;
+
+        /**
+         * @param key Key of the node, which is restored before returning
+         */
+        void erase_descendants_impl(std::string& key, const file_node& node);
+
+        void insert_extension(std::string_view key, const file_node* node);
+
+        void erase_extension(std::string_view key) noexcept;
+
+        flat_string_map<const file_node*, std::pmr::string> m_map;
+        flat_string_map<extension_bucket, std::pmr::string> m_extensions;
+        bool m_complete = true;
+        bool m_index_extensions = false;
+        bool m_fold_case;
+    };
+
+    /**
+     * @brief Root of the tree with the path index of its nodes
+     *
+     * Nodes, directory containers, names and the index are allocated from the memory resource of the tree.
+     */
+    struct file_tree
+    {
+        // Declared before the root, so the names outlive the nodes referring to them
+        name_pool names;
+        file_node root;
+        path_index index;
+
+        /**
+         * @param fold_case True for looking up names ignoring the case of ASCII letters
+         */
+        file_tree(std::pmr::memory_resource* mr, bool fold_case = false);
+
+        [[nodiscard]]
+        std::pmr::memory_resource* resource() const noexcept
+        {
+            return names.resource();
+        }
+
+        /**
+         * @brief Normalized absolute path in the form of the keys of the index, i.e. also folded if the tree folds case
+         */
+        [[nodiscard]]
+        std::string key_of(path_view p) const;
+    };
 } // namespace detail
 
+/**
+ * @brief Find a node by walking the tree from the root
+ */
 const detail::file_node* find_impl(const detail::file_node& root, path_view p);
 
-const detail::file_node* mkdir_impl(detail::file_node& root, path_view p);
+/**
+ * @brief Find a node, probing the path index before walking the tree
+ */
+const detail::file_node* find_impl(const detail::file_tree& tree, path_view p);
+
+/**
+ * @brief Find a node without modifying the tree, so it can run concurrently with other lookups
+ *
+ * @param blocked Set to true if the lookup needs to materialize a directory of a lazily mounted archive.
+ *                The result is null in this case, and the caller should retry with `find_impl` exclusively.
+ */
+const detail::file_node* try_find_impl(const detail::file_tree& tree, path_view p, bool& blocked);
+
+/**
+ * @brief Find a node by a path relative to a directory
+ *
+ * Leading "." and ".." components are resolved from the directory like `path::lexically_normal` does,
+ * so ".." of the root is the root.
+ *
+ * @param blocked Null for materializing directories of lazily mounted archives on the way.
+ *                Otherwise, the lookup stops at the first placeholder and sets it to true like `try_find_impl`.
+ *
+ * @pre The path is relative, and it does not go up after a name
+ */
+const detail::file_node* find_relative_impl(const detail::file_node& dir, path_view p, bool* blocked);
+
+/**
+ * @brief Create directories of a path if they do not exist
+ *
+ * @param key Receives the path of the directory in the index if it is not null
+ */
+const detail::file_node* mkdir_impl(detail::file_tree& tree, path_view p, std::string* key = nullptr);
+
+/**
+ * @brief Remove a node with its descendants
+ *
+ * @return False if the node does not exist
+ */
+bool remove_impl(detail::file_tree& tree, path_view p);
 
 template <typename T, typename... Args>
 std::pair<const detail::file_node*, bool> mount_impl(
-    detail::file_node& root,
+    detail::file_tree& tree,
     path_view p,
     bool overwrite,
     std::in_place_type_t<T>,
     Args&&... args
 )
 {
+    using detail::path_index;
+
     static_assert(!std::same_as<T, file_data::directory>, "Cannot mount a directory");
     assert(p.is_absolute());
-    const auto* current = mkdir_impl(root, p.parent_path());
+    std::string parent_key;
+    const auto* current = mkdir_impl(tree, p.parent_path(), path_index::enabled ? &parent_key : nullptr);
     path_view filename = p.filename();
 
-    auto* dir = current->get_if<file_data::directory>();
+    auto* dir = current->get_directory();
     assert(dir);
-    auto it = dir->children().find(filename);
-    if(it != dir->children().end())
+    if(auto* found = dir->children().find(std::string_view(filename)))
     {
         if(overwrite)
         {
-            it->second = detail::file_node(
+            // The node is reused, but the descendants of a replaced directory are destroyed
+            if constexpr(path_index::enabled)
+            {
+                if(found->is_directory())
+                    tree.index.erase_descendants(path_index::child_key(parent_key, std::string_view(filename)), *found);
+            }
+
+            *found = detail::file_node(
                 current, std::in_place_type<T>, std::forward<Args>(args)...
             );
 
-            return std::make_pair(&it->second, true);
+            return std::make_pair(found, true);
         }
 
-        return std::make_pair(&it->second, false);
+        return std::make_pair(found, false);
     }
     else
     {
-        auto result = dir->children().emplace(
-            filename.string(),
-            detail::file_node(current, std::in_place_type<T>, std::forward<Args>(args)...)
+        auto result = dir->children().try_emplace(
+            tree.names,
+            std::string_view(filename),
+            current,
+            std::in_place_type<T>,
+            std::forward<Args>(args)...
         );
         assert(result.second); // Emplacement should be successful here
 
-        return std::make_pair(
-            &result.first->second,
-            true
-        );
+        if constexpr(path_index::enabled)
+            tree.index.insert(path_index::child_key(parent_key, std::string_view(filename)), result.first);
+
+        return std::make_pair(result.first, true);
     }
 }
 
+namespace detail
+{
+    /**
+     * @brief File to be mounted by `mount_batch_impl`
+     */
+    struct batch_entry
+    {
+        // Normalized absolute path of the file
+        std::string key;
+        // Position of the file name in the key
+        std::size_t name_pos;
+        leaf_data data;
+
+        /**
+         * @param base_key Normalized absolute path of the directory the entry is relative to
+         * @param rel Relative path of the entry. Empty components are skipped like `path_index::key_of` does.
+         */
+        batch_entry(std::string_view base_key, std::string_view rel, leaf_data d);
+
+        /**
+         * @param normalized_key Normalized absolute path of the file, which must not be the root
+         */
+        batch_entry(std::string normalized_key, leaf_data d);
+
+        /**
+         * @brief Key of the parent directory
+         */
+        [[nodiscard]]
+        std::string_view dir() const noexcept
+        {
+            return name_pos == 1 ? std::string_view("/") : std::string_view(key).substr(0, name_pos - 1);
+        }
+
+        [[nodiscard]]
+        std::string_view name() const noexcept
+        {
+            return std::string_view(key).substr(name_pos);
+        }
+    };
+} // namespace detail
+
+/**
+ * @brief Mount many files, creating each directory once
+ *
+ * Entries are sorted by their directories, so the files of a directory are inserted together
+ * after a single walk to it. Entries of the same path are mounted in their original order.
+ */
+void mount_batch_impl(detail::file_tree& tree, std::span<detail::batch_entry> entries, bool overwrite);
+
+/**
+ * @brief Mount an archive lazily
+ *
+ * If the mount point does not exist, a placeholder is created there. Otherwise, the archive is merged into the
+ * existing directory level by level, and only the directories existing on both sides are materialized.
+ */
+void mount_lazy_archive_impl(
+    detail::file_tree& tree,
+    path_view p,
+    std::shared_ptr<zip_archive> ar,
+    bool overwrite
+);
+
 void list_files_impl(
     std::ostream& os,
     std::string_view name,
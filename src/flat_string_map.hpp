@@ -0,0 +1,374 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <functional>
+#include <limits>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace lochfolk::detail
+{
+/**
+ * @brief Hash map from strings to values, built for lookup speed
+ *
+ * Entries are stored contiguously with an open-addressing hash index over them,
+ * so a lookup probes a flat array and compares inline keys. Maps not larger than `linear_limit`
+ * are scanned linearly without the index. Erasing moves the last entry into the hole.
+ *
+ * All memory, including the buffers of `std::pmr::string` keys, is allocated from the memory resource of the map.
+ *
+ * @tparam Key `std::string` or `std::pmr::string` for owning the keys,
+ * or `std::string_view` if the storage of keys is managed elsewhere
+ *
+ * @note Iteration follows no particular order. Pointers to values are invalidated by insertion and erasure.
+ */
+template <typename T, typename Key = std::string>
+class flat_string_map
+{
+public:
+    class entry
+    {
+    public:
+        entry(Key key, std::size_t hash, T value)
+            : m_key(std::move(key)), m_hash(hash), m_value(std::move(value)) {}
+
+        [[nodiscard]]
+        const Key& key() const noexcept
+        {
+            return m_key;
+        }
+
+        [[nodiscard]]
+        const T& value() const noexcept
+        {
+            return m_value;
+        }
+
+    private:
+        friend class flat_string_map;
+
+        Key m_key;
+        std::size_t m_hash;
+        T m_value;
+    };
+
+    using const_iterator = typename std::pmr::vector<entry>::const_iterator;
+
+    // Maps not larger than this are scanned linearly
+    static constexpr std::size_t linear_limit = 8;
+
+    flat_string_map() = default;
+
+    explicit flat_string_map(std::pmr::memory_resource* mr)
+        : m_entries(mr), m_slots(mr) {}
+
+    [[nodiscard]]
+    std::pmr::memory_resource* resource() const noexcept
+    {
+        return m_entries.get_allocator().resource();
+    }
+
+    [[nodiscard]]
+    static std::size_t hash_key(std::string_view key) noexcept
+    {
+        return std::hash<std::string_view>{}(key);
+    }
+
+    [[nodiscard]]
+    T* find(std::string_view key) noexcept
+    {
+        entry* found = find_entry(key, hash_key(key));
+        return found ? &found->m_value : nullptr;
+    }
+
+    [[nodiscard]]
+    const T* find(std::string_view key) const noexcept
+    {
+        return const_cast<flat_string_map*>(this)->find(key);
+    }
+
+    /**
+     * @brief Find the entry of a key, for getting the stored key
+     *
+     * @param hash Result of `hash_key(key)`, so a caller can reuse it for several maps
+     */
+    [[nodiscard]]
+    entry* find_entry(std::string_view key, std::size_t hash) noexcept
+    {
+        if(m_slots.empty())
+        {
+            for(auto& e : m_entries)
+            {
+                if(e.m_hash == hash && e.m_key == key)
+                    return &e;
+            }
+
+            return nullptr;
+        }
+
+        std::size_t pos = find_slot(key, hash);
+        if(pos == m_slots.size())
+            return nullptr;
+        return &m_entries[m_slots[pos].index - 1];
+    }
+
+    [[nodiscard]]
+    const entry* find_entry(std::string_view key, std::size_t hash) const noexcept
+    {
+        return const_cast<flat_string_map*>(this)->find_entry(key, hash);
+    }
+
+    /**
+     * @brief Insert a value if the key does not exist
+     *
+     * @return The value of the key, and whether it is newly inserted
+     */
+    template <typename... Args>
+    std::pair<T*, bool> try_emplace(std::string_view key, Args&&... args)
+    {
+        const std::size_t hash = hash_key(key);
+        if(entry* found = find_entry(key, hash))
+            return std::make_pair(&found->m_value, false);
+
+        return std::make_pair(emplace_new(key, hash, std::forward<Args>(args)...), true);
+    }
+
+    /**
+     * @brief Insert a value of a key known to be absent
+     *
+     * @param hash Result of `hash_key(key)`
+     */
+    template <typename... Args>
+    T* emplace_new(std::string_view key, std::size_t hash, Args&&... args)
+    {
+        assert(!find_entry(key, hash));
+        insert(entry(make_key(key), hash, T(std::forward<Args>(args)...)));
+        return &m_entries.back().m_value;
+    }
+
+    bool erase(std::string_view key)
+    {
+        const std::size_t hash = hash_key(key);
+
+        std::size_t idx = 0;
+        if(m_slots.empty())
+        {
+            auto it = std::ranges::find_if(
+                m_entries,
+                [&](const entry& e)
+                { return e.m_hash == hash && e.m_key == key; }
+            );
+            if(it == m_entries.end())
+                return false;
+            idx = static_cast<std::size_t>(it - m_entries.begin());
+        }
+        else
+        {
+            std::size_t pos = find_slot(key, hash);
+            if(pos == m_slots.size())
+                return false;
+            idx = m_slots[pos].index - 1;
+            remove_slot(pos);
+        }
+
+        // Move the last entry into the hole, so the entries stay contiguous
+        const std::size_t last = m_entries.size() - 1;
+        if(idx != last)
+        {
+            if(!m_slots.empty())
+            {
+                const entry& moved = m_entries[last];
+                std::size_t pos = find_slot(moved.m_key, moved.m_hash);
+                assert(pos != m_slots.size());
+                m_slots[pos].index = static_cast<std::uint32_t>(idx + 1);
+            }
+            m_entries[idx] = std::move(m_entries[last]);
+        }
+        m_entries.pop_back();
+
+        return true;
+    }
+
+    void clear() noexcept
+    {
+        m_entries.clear();
+        m_slots.clear();
+    }
+
+    void reserve(std::size_t n)
+    {
+        m_entries.reserve(n);
+        if(n > linear_limit && m_slots.size() < n * 2)
+            rehash(std::bit_ceil(n * 2));
+    }
+
+    [[nodiscard]]
+    std::size_t size() const noexcept
+    {
+        return m_entries.size();
+    }
+
+    [[nodiscard]]
+    bool empty() const noexcept
+    {
+        return m_entries.empty();
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return m_entries.begin();
+    }
+
+    const_iterator end() const noexcept
+    {
+        return m_entries.end();
+    }
+
+    /**
+     * @brief Entries sorted by key
+     */
+    [[nodiscard]]
+    std::vector<const entry*> sorted() const
+    {
+        std::vector<const entry*> result;
+        result.reserve(m_entries.size());
+        for(const auto& e : m_entries)
+            result.push_back(&e);
+
+        std::ranges::sort(
+            result,
+            [](const entry* lhs, const entry* rhs)
+            { return lhs->m_key < rhs->m_key; }
+        );
+
+        return result;
+    }
+
+    /**
+     * @brief Heap memory used by the map in bytes, including the buffers of long keys if it owns them
+     */
+    [[nodiscard]]
+    std::size_t memory_usage() const noexcept
+    {
+        std::size_t result = m_entries.capacity() * sizeof(entry) + m_slots.capacity() * sizeof(slot);
+        if constexpr(!std::same_as<Key, std::string_view>)
+        {
+            for(const auto& e : m_entries)
+            {
+                if(e.m_key.capacity() > Key().capacity())
+                    result += e.m_key.capacity() + 1;
+            }
+        }
+
+        return result;
+    }
+
+private:
+    struct slot
+    {
+        // Lower bits of the hash of the key
+        std::uint32_t hash = 0;
+        // Index of the entry plus one, zero for an empty slot
+        std::uint32_t index = 0;
+    };
+
+    /**
+     * @brief Position of the slot referring to the entry of a key, or the size of slots if not found
+     */
+    [[nodiscard]]
+    Key make_key(std::string_view key) const
+    {
+        if constexpr(std::same_as<Key, std::pmr::string>)
+            return Key(key, m_entries.get_allocator());
+        else
+            return Key(key);
+    }
+
+    [[nodiscard]]
+    std::size_t find_slot(std::string_view key, std::size_t hash) const noexcept
+    {
+        assert(!m_slots.empty());
+
+        const std::size_t mask = m_slots.size() - 1;
+        const auto short_hash = static_cast<std::uint32_t>(hash);
+        for(std::size_t pos = hash & mask;; pos = (pos + 1) & mask)
+        {
+            const slot& s = m_slots[pos];
+            if(s.index == 0)
+                return m_slots.size();
+            if(s.hash == short_hash && m_entries[s.index - 1].m_key == key)
+                return pos;
+        }
+    }
+
+    void insert(entry e)
+    {
+        const std::size_t hash = e.m_hash;
+        m_entries.push_back(std::move(e));
+
+        // The index is kept once built, even if erasing shrinks the map
+        if(m_slots.empty() && m_entries.size() <= linear_limit)
+            return;
+        // Keep the load factor not greater than 1/2, so probe sequences are short
+        if(m_slots.size() < m_entries.size() * 2)
+        {
+            rehash(std::max<std::size_t>(m_slots.size() * 2, std::bit_ceil(m_entries.size() * 2)));
+            return;
+        }
+
+        insert_slot(hash, m_entries.size() - 1);
+    }
+
+    void insert_slot(std::size_t hash, std::size_t index) noexcept
+    {
+        const std::size_t mask = m_slots.size() - 1;
+        std::size_t pos = hash & mask;
+        while(m_slots[pos].index != 0)
+            pos = (pos + 1) & mask;
+
+        m_slots[pos].hash = static_cast<std::uint32_t>(hash);
+        m_slots[pos].index = static_cast<std::uint32_t>(index + 1);
+    }
+
+    void remove_slot(std::size_t pos) noexcept
+    {
+        // Backward shift deletion of linear probing, so no tombstone is needed
+        const std::size_t mask = m_slots.size() - 1;
+        std::size_t hole = pos;
+        for(std::size_t i = (pos + 1) & mask; m_slots[i].index != 0; i = (i + 1) & mask)
+        {
+            std::size_t home = m_slots[i].hash & mask;
+            bool stays = hole < i ? (home > hole && home <= i) : (home > hole || home <= i);
+            if(stays)
+                continue;
+
+            m_slots[hole] = m_slots[i];
+            hole = i;
+        }
+
+        m_slots[hole] = slot();
+    }
+
+    void rehash(std::size_t slot_count)
+    {
+        assert(std::has_single_bit(slot_count));
+        assert(m_entries.size() < std::numeric_limits<std::uint32_t>::max());
+
+        m_slots.assign(slot_count, slot());
+        for(std::size_t i = 0; i < m_entries.size(); ++i)
+            insert_slot(m_entries[i].m_hash, i);
+    }
+
+    std::pmr::vector<entry> m_entries;
+    // Size is zero or a power of two
+    std::pmr::vector<slot> m_slots;
+};
+} // namespace lochfolk::detail
@@ -0,0 +1,318 @@
+#include <lochfolk/vfs.hpp>
+#include <cassert>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <variant>
+#include <vector>
+#include "errmsg.hpp"
+#include "file_node.hpp"
+#include "perfect_hash.hpp"
+
+namespace lochfolk
+{
+struct frozen_vfs::frozen_data
+{
+    using backend_type = detail::leaf_data;
+
+    static constexpr std::uint32_t no_backend = std::numeric_limits<std::uint32_t>::max();
+
+    struct node
+    {
+        // Full path in `paths`. Zero size for an empty slot.
+        std::uint32_t path_offset = 0;
+        std::uint32_t path_size = 0;
+        std::uint32_t fingerprint = 0;
+        // Range of children in `order` for a directory
+        std::uint32_t first_child = 0;
+        std::uint32_t child_count = 0;
+        // Index in `backends` for a file, or `no_backend` for a directory
+        std::uint32_t backend = no_backend;
+
+        [[nodiscard]]
+        bool is_directory() const noexcept
+        {
+            return backend == no_backend;
+        }
+    };
+
+    // Nodes indexed by their slots in the perfect hash, so a lookup reads the node directly
+    std::vector<node> slots;
+    // Slots of nodes in breadth-first order, so children of a directory are contiguous. The root is the first one.
+    std::vector<std::uint32_t> order;
+    std::vector<backend_type> backends;
+    // Concatenated full paths of the nodes, which are folded if the tree is case-insensitive
+    std::string paths;
+    // Full paths in the original spellings at the same offsets as `paths`, only for a case-insensitive tree
+    std::string spellings;
+    detail::perfect_hash table;
+    bool fold_case = false;
+
+    explicit frozen_data(const detail::file_tree& tree);
+
+    [[nodiscard]]
+    std::string_view path_of(const node& n) const noexcept
+    {
+        return std::string_view(paths).substr(n.path_offset, n.path_size);
+    }
+
+    [[nodiscard]]
+    std::string_view spelling_of(const node& n) const noexcept
+    {
+        if(!fold_case)
+            return path_of(n);
+        return std::string_view(spellings).substr(n.path_offset, n.path_size);
+    }
+
+    [[nodiscard]]
+    std::string_view name_of(const node& n) const noexcept
+    {
+        std::string_view p = spelling_of(n);
+        if(p.size() == 1)
+            return p;
+        return p.substr(p.rfind(path_view::separator) + 1);
+    }
+
+    [[nodiscard]]
+    const node* find(path_view p) const;
+
+    [[nodiscard]]
+    const backend_type& get_file(path_view p) const
+    {
+        const node* n = find(p);
+        if(!n)
+            throw virtual_file_system::error(vfs_err_msg(p, " is not found"));
+        if(n->is_directory())
+            throw virtual_file_system::error("bad file");
+
+        return backends[n->backend];
+    }
+
+    void list_files(std::ostream& os, const node& n, unsigned int indent) const;
+};
+
+frozen_vfs::frozen_data::frozen_data(const detail::file_tree& tree)
+    : fold_case(tree.names.folds_case())
+{
+    std::vector<node> nodes;
+    std::vector<const detail::file_node*> sources;
+
+    auto append = [&](std::string_view path, std::string_view spelling, const detail::file_node& source)
+    {
+        if(paths.size() + path.size() > std::numeric_limits<std::uint32_t>::max())
+            throw virtual_file_system::error("too many paths to freeze");
+
+        node n;
+        n.path_offset = static_cast<std::uint32_t>(paths.size());
+        n.path_size = static_cast<std::uint32_t>(path.size());
+        n.fingerprint = detail::perfect_hash::fingerprint_of(path);
+        paths += path;
+        if(fold_case)
+            spellings += spelling;
+
+        nodes.push_back(n);
+        sources.push_back(&source);
+    };
+
+    append("/", "/", tree.root);
+    for(std::size_t i = 0; i < nodes.size(); ++i)
+    {
+        const detail::file_node& source = *sources[i];
+
+        if(source.is_directory())
+        {
+            // The caller holds the tree exclusively, so lazy directories can be materialized here
+            const auto* dir = source.get_directory();
+            assert(dir);
+
+            std::string parent(path_of(nodes[i]));
+            std::string spelled_parent(spelling_of(nodes[i]));
+            nodes[i].first_child = static_cast<std::uint32_t>(nodes.size());
+            nodes[i].child_count = static_cast<std::uint32_t>(dir->children().size());
+            for(const auto* e : dir->children().sorted())
+            {
+                append(
+                    detail::path_index::child_key(parent, e->key()),
+                    detail::path_index::child_key(spelled_parent, dir->children().spelling(*e)),
+                    *e->value()
+                );
+            }
+
+            continue;
+        }
+
+        nodes[i].backend = static_cast<std::uint32_t>(backends.size());
+        source.visit(
+            [&]<typename T>(const T& v)
+            {
+                if constexpr(std::is_constructible_v<backend_type, const T&>)
+                    backends.emplace_back(v);
+            }
+        );
+        assert(nodes[i].backend + 1 == backends.size());
+    }
+
+    std::vector<std::string_view> keys;
+    keys.reserve(nodes.size());
+    for(const auto& n : nodes)
+        keys.push_back(path_of(n));
+    order = table.build(keys);
+
+    slots.resize(table.slot_count());
+    for(std::size_t i = 0; i < nodes.size(); ++i)
+        slots[order[i]] = nodes[i];
+}
+
+auto frozen_vfs::frozen_data::find(path_view p) const -> const node*
+{
+    auto probe = [this](std::string_view key) -> const node*
+    {
+        auto [slot, fingerprint] = table.find(key);
+        const node& n = slots[slot];
+        if(n.fingerprint != fingerprint || path_of(n) != key)
+            return nullptr;
+        return &n;
+    };
+
+    if(fold_case) [[unlikely]]
+    {
+        detail::folded_string folded{std::string_view(p)};
+        if(const node* found = probe(folded.view()))
+            return found;
+        if(detail::path_index::is_key(folded.view()))
+            return nullptr;
+    }
+    // Most paths are already normalized, so they are probed before checking
+    else if(const node* found = probe(std::string_view(p)))
+        return found;
+    else if(detail::path_index::is_key(std::string_view(p)))
+        return nullptr;
+    if(p.empty() || !p.is_absolute()) [[unlikely]]
+        return nullptr;
+
+    std::string key = detail::path_index::key_of(p);
+    if(fold_case)
+        detail::fold_case(key);
+    return probe(key);
+}
+
+void frozen_vfs::frozen_data::list_files(std::ostream& os, const node& n, unsigned int indent) const
+{
+    for(unsigned int i = 0; i < indent; ++i)
+        os << "  ";
+    std::string_view name = name_of(n);
+    os << "- " << name;
+    if(n.is_directory() && name != "/")
+        os << '/';
+    os << '\n';
+
+    for(std::uint32_t i = 0; i < n.child_count; ++i)
+        list_files(os, slots[order[n.first_child + i]], indent + 1);
+}
+
+frozen_vfs::frozen_vfs(const detail::file_tree& tree)
+    : m_data(new frozen_data(tree)) {}
+
+frozen_vfs::frozen_vfs(frozen_vfs&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)) {}
+
+frozen_vfs::~frozen_vfs()
+{
+    delete m_data;
+}
+
+frozen_vfs& frozen_vfs::operator=(frozen_vfs&& rhs) noexcept
+{
+    if(this == &rhs) [[unlikely]]
+        return *this;
+
+    delete m_data;
+    m_data = std::exchange(rhs.m_data, nullptr);
+    return *this;
+}
+
+bool frozen_vfs::exists(path_view p) const
+{
+    return m_data->find(p) != nullptr;
+}
+
+bool frozen_vfs::is_directory(path_view p) const
+{
+    const auto* n = m_data->find(p);
+    return n && n->is_directory();
+}
+
+std::uint64_t frozen_vfs::file_size(path_view p) const
+{
+    const auto* n = m_data->find(p);
+    if(!n) [[unlikely]]
+        throw virtual_file_system::error(vfs_err_msg(p, " is not found"));
+    if(n->is_directory())
+        return 0;
+
+    return std::visit(
+        [](const auto& v) -> std::uint64_t
+        { return v.file_size(); },
+        m_data->backends[n->backend]
+    );
+}
+
+ivfstream frozen_vfs::open(path_view p, std::ios_base::openmode mode) const
+{
+    mode |= std::ios_base::in;
+    return ivfstream(std::visit(
+        [mode](const auto& v) -> std::unique_ptr<std::streambuf>
+        { return v.open(mode); },
+        m_data->get_file(p)
+    ));
+}
+
+std::string frozen_vfs::read_string(path_view p, bool convert_crlf) const
+{
+    return std::visit(
+        [convert_crlf](const auto& v) -> std::string
+        { return v.read_string(convert_crlf); },
+        m_data->get_file(p)
+    );
+}
+
+std::optional<std::span<const std::byte>> frozen_vfs::view_bytes(path_view p) const
+{
+    const auto* n = m_data->find(p);
+    if(!n)
+        throw virtual_file_system::error(vfs_err_msg(p, " is not found"));
+    if(n->is_directory())
+        return std::nullopt;
+
+    return std::visit(
+        []<typename T>(const T& v) -> std::optional<std::span<const std::byte>>
+        {
+            constexpr bool has_view_bytes = requires() { v.view_bytes(); };
+            if constexpr(has_view_bytes)
+                return v.view_bytes();
+            return std::nullopt;
+        },
+        m_data->backends[n->backend]
+    );
+}
+
+std::size_t frozen_vfs::size() const noexcept
+{
+    return m_data->order.size();
+}
+
+std::size_t frozen_vfs::memory_usage() const noexcept
+{
+    return m_data->slots.capacity() * sizeof(frozen_data::node) +
+           m_data->order.capacity() * sizeof(std::uint32_t) +
+           m_data->backends.capacity() * sizeof(frozen_data::backend_type) +
+           m_data->paths.capacity() +
+           m_data->spellings.capacity() +
+           m_data->table.memory_usage();
+}
+
+void frozen_vfs::list_files(std::ostream& os) const
+{
+    m_data->list_files(os, m_data->slots[m_data->order[0]], 0);
+}
+} // namespace lochfolk
@@ -0,0 +1,325 @@
+#include "glob.hpp"
+#include <cassert>
+#include <algorithm>
+#include <utility>
+#include "case_fold.hpp"
+#include "errmsg.hpp"
+
+namespace lochfolk
+{
+/**
+ * @brief Parse a component of a pattern
+ */
+auto glob_pattern::pattern_data::parse_component(
+    std::string_view pattern,
+    std::string_view component,
+    std::vector<std::bitset<256>>& classes
+) -> segment
+{
+    segment result{.kind = segment::wildcard, .text = {}, .tokens = {}};
+    if(component == "**")
+    {
+        result.kind = segment::any_depth;
+        return result;
+    }
+
+    auto push_char = [&](char ch)
+    {
+        if(result.tokens.empty() || result.tokens.back().kind != token::literal)
+            result.tokens.push_back(token{token::literal, static_cast<std::uint32_t>(result.text.size()), 0});
+        result.text += ch;
+        ++result.tokens.back().size;
+    };
+
+    bool has_wildcard = false;
+    for(std::size_t i = 0; i < component.size();)
+    {
+        const char ch = component[i];
+        if(ch == '\\' && i + 1 < component.size())
+        {
+            push_char(component[i + 1]);
+            i += 2;
+        }
+        else if(ch == '*')
+        {
+            has_wildcard = true;
+            if(result.tokens.empty() || result.tokens.back().kind != token::any_string)
+                result.tokens.push_back(token{token::any_string});
+            ++i;
+        }
+        else if(ch == '?')
+        {
+            has_wildcard = true;
+            result.tokens.push_back(token{token::any_char});
+            ++i;
+        }
+        else if(ch == '[')
+        {
+            has_wildcard = true;
+
+            std::size_t j = i + 1;
+            bool negated = false;
+            if(j < component.size() && (component[j] == '!' || component[j] == '^'))
+            {
+                negated = true;
+                ++j;
+            }
+
+            std::bitset<256> set;
+            // A closing bracket right after the opening one is a member
+            for(bool first = true; j < component.size() && (first || component[j] != ']'); first = false)
+            {
+                auto lo = static_cast<unsigned char>(component[j]);
+                if(j + 2 < component.size() && component[j + 1] == '-' && component[j + 2] != ']')
+                {
+                    auto hi = static_cast<unsigned char>(component[j + 2]);
+                    for(unsigned int c = lo; c <= hi; ++c)
+                        set.set(c);
+                    j += 3;
+                }
+                else
+                {
+                    set.set(lo);
+                    ++j;
+                }
+            }
+            if(j >= component.size()) [[unlikely]]
+                throw virtual_file_system::error(vfs_err_msg(path_view(pattern), " has an unclosed character class"));
+
+            if(negated)
+                set.flip();
+            result.tokens.push_back(token{token::char_class, static_cast<std::uint32_t>(classes.size())});
+            classes.push_back(set);
+            i = j + 1;
+        }
+        else
+        {
+            push_char(ch);
+            ++i;
+        }
+    }
+
+    if(!has_wildcard)
+    {
+        result.kind = segment::literal;
+        result.tokens.clear();
+    }
+
+    return result;
+}
+
+glob_pattern::pattern_data::pattern_data(std::string_view pattern)
+    : source(pattern)
+{
+    if(pattern.empty() || pattern[0] != path_view::separator) [[unlikely]]
+        throw virtual_file_system::error(vfs_err_msg(path_view(pattern), " is not an absolute path"));
+
+    // Empty components are skipped like `path_index::key_of` does
+    for(std::size_t start = 1; start < pattern.size();)
+    {
+        std::size_t end = pattern.find(path_view::separator, start);
+        if(end == std::string_view::npos)
+            end = pattern.size();
+
+        std::string_view component = pattern.substr(start, end - start);
+        start = end + 1;
+        if(component.empty())
+            continue;
+
+        segment s = parse_component(pattern, component, classes);
+        // Consecutive `**` match the same names as one
+        if(s.kind == segment::any_depth && !segments.empty() && segments.back().kind == segment::any_depth)
+            continue;
+        segments.push_back(std::move(s));
+    }
+
+    while(prefix < segments.size() && segments[prefix].kind == segment::literal)
+        ++prefix;
+
+    if(segments.size() == prefix + 2 && segments[prefix].kind == segment::any_depth)
+    {
+        const segment& last = segments.back();
+        if(last.kind == segment::wildcard &&
+           last.tokens.size() == 2 &&
+           last.tokens[0].kind == token::any_string &&
+           last.tokens[1].kind == token::literal &&
+           last.text.starts_with('.') &&
+           last.text.find('.', 1) == std::string::npos)
+        {
+            extension = last.text;
+        }
+    }
+
+    // Compiled eagerly, so matching against a case-insensitive tree needs no compilation per query
+    std::string folded_source(pattern);
+    detail::fold_case(folded_source);
+    if(folded_source != pattern)
+        m_folded = std::make_unique<const pattern_data>(folded_source);
+}
+
+bool glob_pattern::pattern_data::match(const segment& s, std::string_view name) const noexcept
+{
+    switch(s.kind)
+    {
+    case segment::any_depth:
+        return true;
+    case segment::literal:
+        return name == s.text;
+    case segment::wildcard:
+        break;
+    }
+
+    auto match_token = [&](const token& t, std::size_t pos) -> std::size_t
+    {
+        // Returns the size of the matched characters, or npos
+        switch(t.kind)
+        {
+        case token::literal:
+            if(name.substr(pos, t.size) == std::string_view(s.text).substr(t.pos, t.size))
+                return t.size;
+            return std::string_view::npos;
+        case token::any_char:
+            return pos < name.size() ? 1 : std::string_view::npos;
+        case token::char_class:
+            if(pos < name.size() && classes[t.pos].test(static_cast<unsigned char>(name[pos])))
+                return 1;
+            return std::string_view::npos;
+        default:
+            assert(false);
+            return std::string_view::npos;
+        }
+    };
+
+    // Backtracking to the last star is enough, because a star never matches a separator
+    std::size_t ti = 0;
+    std::size_t pos = 0;
+    std::size_t star_ti = std::string_view::npos;
+    std::size_t star_pos = 0;
+    while(true)
+    {
+        if(ti < s.tokens.size())
+        {
+            const token& t = s.tokens[ti];
+            if(t.kind == token::any_string)
+            {
+                star_ti = ++ti;
+                star_pos = pos;
+                continue;
+            }
+
+            if(std::size_t len = match_token(t, pos); len != std::string_view::npos)
+            {
+                pos += len;
+                ++ti;
+                continue;
+            }
+        }
+        else if(pos == name.size())
+            return true;
+
+        if(star_ti == std::string_view::npos || star_pos >= name.size())
+            return false;
+        ti = star_ti;
+        pos = ++star_pos;
+    }
+}
+
+void glob_pattern::pattern_data::close(state_set& states) const
+{
+    for(std::size_t i = 0; i < states.size(); ++i)
+    {
+        const std::uint32_t s = states[i];
+        if(s < segments.size() && segments[s].kind == segment::any_depth)
+            states.push_back(s + 1);
+    }
+
+    if(states.size() > 1)
+    {
+        std::ranges::sort(states);
+        states.erase(std::unique(states.begin(), states.end()), states.end());
+    }
+}
+
+auto glob_pattern::pattern_data::start() const -> state_set
+{
+    state_set result{0};
+    close(result);
+    return result;
+}
+
+void glob_pattern::pattern_data::step(const state_set& from, std::string_view name, state_set& to) const
+{
+    to.clear();
+    for(std::uint32_t s : from)
+    {
+        if(s == segments.size())
+            continue;
+
+        const segment& seg = segments[s];
+        if(seg.kind == segment::any_depth)
+            to.push_back(s);
+        else if(match(seg, name))
+            to.push_back(s + 1);
+    }
+
+    close(to);
+}
+
+const std::string* glob_pattern::pattern_data::lookup_name(const state_set& states) const noexcept
+{
+    if(states.empty() || states.front() == segments.size())
+        return nullptr;
+    if(states.size() > 1 && states[1] != segments.size())
+        return nullptr;
+
+    const segment& seg = segments[states.front()];
+    return seg.kind == segment::literal ? &seg.text : nullptr;
+}
+
+glob_pattern::glob_pattern(std::string_view pattern)
+    : m_data(new pattern_data(pattern)) {}
+
+glob_pattern::glob_pattern(glob_pattern&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)) {}
+
+glob_pattern::~glob_pattern()
+{
+    delete m_data;
+}
+
+glob_pattern& glob_pattern::operator=(glob_pattern&& rhs) noexcept
+{
+    if(this == &rhs) [[unlikely]]
+        return *this;
+
+    delete m_data;
+    m_data = std::exchange(rhs.m_data, nullptr);
+    return *this;
+}
+
+bool glob_pattern::match(path_view p) const
+{
+    if(p.empty() || !p.is_absolute()) [[unlikely]]
+        return false;
+
+    pattern_data::state_set states = m_data->start();
+    pattern_data::state_set next;
+    for(path_view subview : p)
+    {
+        if(std::string_view(subview) == "/")
+            continue;
+
+        m_data->step(states, std::string_view(subview), next);
+        if(next.empty())
+            return false;
+        states.swap(next);
+    }
+
+    return m_data->accepts(states);
+}
+
+std::string_view glob_pattern::str() const noexcept
+{
+    return m_data->source;
+}
+} // namespace lochfolk
@@ -0,0 +1,138 @@
+#ifndef LOCHFOLK_GLOB_HPP
+#define LOCHFOLK_GLOB_HPP
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <bitset>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <lochfolk/vfs.hpp>
+
+namespace lochfolk
+{
+struct glob_pattern::pattern_data
+{
+    struct token
+    {
+        enum kind_type : std::uint8_t
+        {
+            literal,
+            any_char,
+            any_string,
+            char_class
+        };
+
+        kind_type kind;
+        // Range of the text of the segment for a literal, or the index of a character class
+        std::uint32_t pos = 0;
+        std::uint32_t size = 0;
+    };
+
+    struct segment
+    {
+        enum kind_type : std::uint8_t
+        {
+            // Matches a name equal to the text
+            literal,
+            // Matches a name by the tokens
+            wildcard,
+            // `**`, matches zero or more names
+            any_depth
+        };
+
+        kind_type kind;
+        // Unescaped name of a literal, or the literal characters referred to by the tokens
+        std::string text;
+        std::vector<token> tokens;
+    };
+
+    // A state is the index of the next segment to match, and the size of segments is the accepting state
+    using state_set = std::vector<std::uint32_t>;
+
+    std::string source;
+    std::vector<segment> segments;
+    std::vector<std::bitset<256>> classes;
+
+    // Number of leading literal segments
+    std::size_t prefix = 0;
+    // Extension for the extension index if the pattern is the prefix, `**` and `*` followed by it, otherwise empty
+    std::string extension;
+
+    /**
+     * @exception virtual_file_system::error The pattern is invalid
+     */
+    explicit pattern_data(std::string_view pattern);
+
+    /**
+     * @brief The pattern compiled from the case-folded source, for matching the folded names of a case-insensitive tree
+     */
+    [[nodiscard]]
+    const pattern_data& folded() const noexcept
+    {
+        return m_folded ? *m_folded : *this;
+    }
+
+    [[nodiscard]]
+    bool match(const segment& s, std::string_view name) const noexcept;
+
+    /**
+     * @brief Initial states at the root
+     */
+    [[nodiscard]]
+    state_set start() const;
+
+    /**
+     * @brief States after matching a name from some states
+     *
+     * @param to Receives the states, which are sorted and unique
+     */
+    void step(const state_set& from, std::string_view name, state_set& to) const;
+
+    [[nodiscard]]
+    bool accepts(const state_set& states) const noexcept
+    {
+        return !states.empty() && states.back() == segments.size();
+    }
+
+    /**
+     * @brief Check if some states can still match names below a directory
+     */
+    [[nodiscard]]
+    bool can_descend(const state_set& states) const noexcept
+    {
+        return !states.empty() && states.front() < segments.size();
+    }
+
+    /**
+     * @brief The literal to look up if the only state expecting a name is a literal segment
+     *
+     * @return nullptr if the children must be compared one by one
+     */
+    [[nodiscard]]
+    const std::string* lookup_name(const state_set& states) const noexcept;
+
+private:
+    /**
+     * @param classes Receives the character classes of the component
+     */
+    static segment parse_component(
+        std::string_view pattern,
+        std::string_view component,
+        std::vector<std::bitset<256>>& classes
+    );
+
+    /**
+     * @brief Add the states reachable by matching `**` with no name, then sort them
+     */
+    void close(state_set& states) const;
+
+    // Null if folding does not change the source
+    std::unique_ptr<const pattern_data> m_folded;
+};
+} // namespace lochfolk
+
+#endif
@@ -0,0 +1,228 @@
+#include "layer_table.hpp"
+#include <cassert>
+#include <algorithm>
+#include "errmsg.hpp"
+
+namespace lochfolk::detail
+{
+/**
+ * @brief Remove the ancestors of a removed node while they are empty directories
+ */
+static void prune_empty_dirs(file_tree& tree, path_view p)
+{
+    using namespace vfs_literals;
+
+    for(path_view parent = p.parent_path(); parent != "/"_pv; parent = parent.parent_path())
+    {
+        const auto* node = find_impl(tree, parent);
+        if(!node)
+            break;
+        const auto* dir = node->get_if<file_data::directory>();
+        if(!dir || !dir->children().empty())
+            break;
+
+        remove_impl(tree, parent);
+    }
+}
+
+/**
+ * @brief Check if a key is the same as a directory or under it
+ */
+static bool is_under(std::string_view key, std::string_view dir) noexcept
+{
+    if(dir == "/")
+        return true;
+    if(!key.starts_with(dir))
+        return false;
+    return key.size() == dir.size() || key[dir.size()] == path_view::separator;
+}
+
+layer_table::layer_table(std::pmr::memory_resource* mr)
+    : m_stacks(mr), m_layers(mr)
+{
+    // The base layer
+    m_layers.push_back(layer_info{0, true, std::pmr::vector<std::pmr::string>(mr)});
+}
+
+layer_id layer_table::add(int priority)
+{
+    if(m_layers.size() > static_cast<std::uint32_t>(-1)) [[unlikely]]
+        throw virtual_file_system::error("too many layers");
+
+    const auto id = static_cast<layer_id>(m_layers.size());
+    m_layers.push_back(layer_info{priority, true, std::pmr::vector<std::pmr::string>(m_layers.get_allocator())});
+    return id;
+}
+
+bool layer_table::active(layer_id layer) const noexcept
+{
+    const auto idx = static_cast<std::size_t>(layer);
+    return idx < m_layers.size() && m_layers[idx].active;
+}
+
+void layer_table::mount(file_tree& tree, path_view p, layer_id layer, bool overwrite, leaf_data data)
+{
+    assert(active(layer));
+    assert(p.is_absolute());
+
+    auto mount_base = [&]()
+    {
+        std::visit(
+            [&]<typename T>(T& v)
+            { mount_impl(tree, p, overwrite, std::in_place_type<T>, std::move(v)); },
+            data
+        );
+    };
+
+    const std::string key = tree.key_of(p);
+    stack_type* stack = m_stacks.find(key);
+    const file_node* node = find_impl(tree, p);
+    if(!stack)
+    {
+        if(node && node->is_directory())
+        {
+            // Replacing a directory would destroy the files of other layers in it
+            if(layer != base_layer || has_stacks_under(key))
+                throw virtual_file_system::error(vfs_err_msg(p, " is a directory"));
+            mount_base();
+            return;
+        }
+        if(layer == base_layer)
+        {
+            mount_base();
+            return;
+        }
+
+        if(!node)
+        {
+            // The first file at this path, which wins directly
+            mount_base();
+            m_stacks.try_emplace(key, m_stacks.resource()).first->push_back(entry{layer, std::nullopt});
+            record_path(layer, key);
+            return;
+        }
+
+        // The existing file belongs to the base layer
+        stack = m_stacks.try_emplace(key, m_stacks.resource()).first;
+        stack->push_back(entry{base_layer, std::nullopt});
+    }
+    assert(node && !node->is_directory());
+
+    auto it = std::ranges::find(*stack, layer, &entry::layer);
+    if(it != stack->end())
+    {
+        if(!overwrite)
+            return;
+
+        if(it + 1 == stack->end())
+            node->assign_file(std::move(data));
+        else
+            it->data = std::move(data);
+        return;
+    }
+
+    it = std::ranges::find_if(
+        *stack,
+        [&](const entry& e)
+        { return ranks_below(layer, e.layer); }
+    );
+    if(it == stack->end())
+    {
+        // The new file wins, so the previous winner is moved out of the tree
+        stack->back().data = node->release_file();
+        node->assign_file(std::move(data));
+        stack->push_back(entry{layer, std::nullopt});
+    }
+    else
+        stack->insert(it, entry{layer, std::move(data)});
+
+    if(layer != base_layer)
+        record_path(layer, key);
+}
+
+bool layer_table::unmount(file_tree& tree, layer_id layer)
+{
+    if(layer == base_layer || !active(layer))
+        return false;
+
+    layer_info& info = m_layers[static_cast<std::size_t>(layer)];
+    for(const auto& key : info.paths)
+    {
+        stack_type* stack = m_stacks.find(key);
+        if(!stack)
+            continue;
+        auto it = std::ranges::find(*stack, layer, &entry::layer);
+        if(it == stack->end())
+            continue;
+
+        if(it + 1 != stack->end())
+            stack->erase(it);
+        else
+        {
+            stack->pop_back();
+
+            const path_view p{std::string_view(key)};
+            if(stack->empty())
+            {
+                remove_impl(tree, p);
+                prune_empty_dirs(tree, p);
+            }
+            else
+            {
+                const file_node* node = find_impl(tree, p);
+                assert(node && !node->is_directory());
+                node->assign_file(std::move(*stack->back().data));
+                stack->back().data.reset();
+            }
+        }
+
+        // A path only having the base layer needs no stack
+        if(stack->empty() || (stack->size() == 1 && stack->front().layer == base_layer))
+            m_stacks.erase(key);
+    }
+
+    info.active = false;
+    info.paths = std::pmr::vector<std::pmr::string>(m_layers.get_allocator());
+
+    return true;
+}
+
+void layer_table::erase_under(std::string_view key)
+{
+    if(m_stacks.empty())
+        return;
+
+    // Keys are copied before erasing, since erasing moves the entries
+    std::vector<std::string> erased;
+    for(const auto& e : m_stacks)
+    {
+        if(is_under(e.key(), key))
+            erased.emplace_back(e.key());
+    }
+    for(const auto& k : erased)
+        m_stacks.erase(k);
+}
+
+bool layer_table::ranks_below(layer_id lhs, layer_id rhs) const noexcept
+{
+    const int lhs_priority = m_layers[static_cast<std::size_t>(lhs)].priority;
+    const int rhs_priority = m_layers[static_cast<std::size_t>(rhs)].priority;
+    if(lhs_priority != rhs_priority)
+        return lhs_priority < rhs_priority;
+    return lhs < rhs;
+}
+
+bool layer_table::has_stacks_under(std::string_view key) const noexcept
+{
+    return std::ranges::any_of(
+        m_stacks,
+        [key](const auto& e)
+        { return e.key() != key && is_under(e.key(), key); }
+    );
+}
+
+void layer_table::record_path(layer_id layer, std::string_view key)
+{
+    m_layers[static_cast<std::size_t>(layer)].paths.emplace_back(key);
+}
+} // namespace lochfolk::detail
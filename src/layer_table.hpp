@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include <lochfolk/vfs.hpp>
+#include "file_node.hpp"
+#include "flat_string_map.hpp"
+
+namespace lochfolk::detail
+{
+/**
+ * @brief Files of overlay layers hidden by higher layers
+ *
+ * The tree always holds the winner of each path, so lookups never consult this table.
+ * Each path mounted into a layer other than the base has a stack of the files mounted there,
+ * ordered by the ranks of their layers. The winner is the top of the stack, and its data lives in the tree node.
+ * Paths without a stack belong to the base layer only.
+ *
+ * All memory except the data of hidden files is allocated from the memory resource given on construction.
+ */
+class layer_table
+{
+public:
+    explicit layer_table(std::pmr::memory_resource* mr);
+
+    [[nodiscard]]
+    layer_id add(int priority);
+
+    /**
+     * @brief Check if a layer can be mounted into
+     */
+    [[nodiscard]]
+    bool active(layer_id layer) const noexcept;
+
+    /**
+     * @brief True if no file is mounted into a layer other than the base, so mounting can skip this table
+     */
+    [[nodiscard]]
+    bool empty() const noexcept
+    {
+        return m_stacks.empty();
+    }
+
+    /**
+     * @brief Mount a file into a layer, putting it into the tree if it wins
+     *
+     * @param p Absolute path
+     */
+    void mount(file_tree& tree, path_view p, layer_id layer, bool overwrite, leaf_data data);
+
+    /**
+     * @brief Remove the files of a layer, restoring the hidden files of lower layers into the tree
+     */
+    bool unmount(file_tree& tree, layer_id layer);
+
+    /**
+     * @brief Forget the stacks of a node removed from the tree and its descendants
+     */
+    void erase_under(std::string_view key);
+
+private:
+    struct entry
+    {
+        layer_id layer;
+        // Empty for the winner, whose data is in the tree
+        std::optional<leaf_data> data;
+    };
+
+    using stack_type = std::pmr::vector<entry>;
+
+    struct layer_info
+    {
+        int priority = 0;
+        bool active = true;
+        // Keys of the paths with files of this layer. They may be stale after removing nodes.
+        std::pmr::vector<std::pmr::string> paths;
+    };
+
+    /**
+     * @brief Compare by priorities, then by creation order
+     */
+    [[nodiscard]]
+    bool ranks_below(layer_id lhs, layer_id rhs) const noexcept;
+
+    /**
+     * @brief Check if any stack is at a path under a directory
+     */
+    [[nodiscard]]
+    bool has_stacks_under(std::string_view key) const noexcept;
+
+    void record_path(layer_id layer, std::string_view key);
+
+    flat_string_map<stack_type, std::pmr::string> m_stacks;
+    // Indexed by layer identifiers. Unmounted layers are kept inactive, so identifiers are never reused.
+    std::pmr::vector<layer_info> m_layers;
+};
+} // namespace lochfolk::detail
@@ -0,0 +1,116 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    ifndef WIN32_LEAN_AND_MEAN
+#        define WIN32_LEAN_AND_MEAN
+#    endif
+#    include <Windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace lochfolk
+{
+mapped_file::~mapped_file()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool mapped_file::open(const std::filesystem::path& sys_path)
+{
+    close();
+
+    HANDLE file = CreateFileW(
+        sys_path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr
+    );
+    if(file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if(!mapping)
+        return false;
+
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    // The view keeps a reference to the mapping object
+    CloseHandle(mapping);
+    if(!data)
+        return false;
+
+    m_data = data;
+    m_size = static_cast<std::size_t>(size.QuadPart);
+    return true;
+}
+
+void mapped_file::close() noexcept
+{
+    if(!m_data)
+        return;
+
+    UnmapViewOfFile(m_data);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#else
+
+bool mapped_file::open(const std::filesystem::path& sys_path)
+{
+    close();
+
+    int fd = ::open(sys_path.c_str(), O_RDONLY);
+    if(fd == -1)
+        return false;
+
+    struct stat st;
+    if(::fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    std::size_t size = static_cast<std::size_t>(st.st_size);
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after closing the descriptor
+    ::close(fd);
+    if(data == MAP_FAILED)
+        return false;
+
+    m_data = data;
+    m_size = size;
+    return true;
+}
+
+void mapped_file::close() noexcept
+{
+    if(!m_data)
+        return;
+
+    ::munmap(const_cast<void*>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
+} // namespace lochfolk
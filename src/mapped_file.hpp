@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <filesystem>
+
+namespace lochfolk
+{
+/**
+ * @brief Read-only memory mapping of a system file
+ */
+class mapped_file
+{
+public:
+    mapped_file() noexcept = default;
+
+    mapped_file(const mapped_file&) = delete;
+
+    ~mapped_file();
+
+    /**
+     * @brief Map the whole file into memory
+     *
+     * @return false Failed to map the file
+     */
+    bool open(const std::filesystem::path& sys_path);
+
+    void close() noexcept;
+
+    [[nodiscard]]
+    bool is_open() const noexcept
+    {
+        return m_data != nullptr;
+    }
+
+    [[nodiscard]]
+    std::span<const std::byte> bytes() const noexcept
+    {
+        return std::span<const std::byte>(
+            static_cast<const std::byte*>(m_data), m_size
+        );
+    }
+
+private:
+    const void* m_data = nullptr;
+    std::size_t m_size = 0;
+};
+} // namespace lochfolk
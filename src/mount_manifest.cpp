@@ -0,0 +1,547 @@
+#include "mount_manifest.hpp"
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <utility>
+#include <zlib.h>
+#include "errmsg.hpp"
+#include "mapped_file.hpp"
+
+namespace lochfolk
+{
+namespace manifest_format
+{
+    /**
+     * @brief Append little-endian integers and sized strings to a buffer
+     */
+    class writer
+    {
+    public:
+        explicit writer(std::string& out) noexcept
+            : m_out(&out) {}
+
+        template <std::integral T>
+        void put(T val)
+        {
+            using U = std::make_unsigned_t<T>;
+            const U u = static_cast<U>(val);
+            for(std::size_t i = 0; i < sizeof(T); ++i)
+                m_out->push_back(static_cast<char>((u >> (i * 8)) & 0xFF));
+        }
+
+        void put_string(std::string_view str)
+        {
+            if(str.size() > std::numeric_limits<std::uint32_t>::max()) [[unlikely]]
+                throw virtual_file_system::error("string is too long for manifest");
+
+            put(static_cast<std::uint32_t>(str.size()));
+            m_out->append(str);
+        }
+
+    private:
+        std::string* m_out;
+    };
+
+    /**
+     * @brief Read little-endian integers and sized strings with bounds checking
+     *
+     * Reading past the end fails the reader, and all later reads fail, too.
+     */
+    class reader
+    {
+    public:
+        explicit reader(std::span<const std::byte> in) noexcept
+            : m_in(in) {}
+
+        template <std::integral T>
+        bool get(T& val) noexcept
+        {
+            if(!require(sizeof(T)))
+                return false;
+
+            using U = std::make_unsigned_t<T>;
+            U u = 0;
+            for(std::size_t i = 0; i < sizeof(T); ++i)
+                u |= static_cast<U>(std::to_integer<U>(m_in[m_pos + i]) << (i * 8));
+            val = static_cast<T>(u);
+            m_pos += sizeof(T);
+            return true;
+        }
+
+        bool get_string(std::string_view& str) noexcept
+        {
+            std::uint32_t size = 0;
+            if(!get(size) || !require(size))
+                return false;
+
+            str = std::string_view(reinterpret_cast<const char*>(m_in.data()) + m_pos, size);
+            m_pos += size;
+            return true;
+        }
+
+        /**
+         * @brief Check if a count of records is possible, so it can be used for reserving memory
+         */
+        bool check_count(std::uint64_t count, std::size_t min_record_size) noexcept
+        {
+            if(count > remaining() / min_record_size)
+                m_failed = true;
+            return !m_failed;
+        }
+
+        [[nodiscard]]
+        std::size_t remaining() const noexcept
+        {
+            return m_failed ? 0 : m_in.size() - m_pos;
+        }
+
+    private:
+        bool require(std::size_t n) noexcept
+        {
+            if(m_failed || n > m_in.size() - m_pos)
+            {
+                m_failed = true;
+                return false;
+            }
+            return true;
+        }
+
+        std::span<const std::byte> m_in;
+        std::size_t m_pos = 0;
+        bool m_failed = false;
+    };
+
+    // Time, size of name
+    inline constexpr std::size_t min_dir_size = 8 + 4;
+    // Size of name
+    inline constexpr std::size_t min_file_size = 4;
+    // Offsets, sizes, CRC, method, flag, directory flag and size of name
+    inline constexpr std::size_t min_entry_size = 8 * 4 + 4 + 2 + 2 + 1 + 4;
+} // namespace manifest_format
+
+void name_list::push_back(std::string_view name)
+{
+    m_buf.append(name);
+    m_ends.push_back(m_buf.size());
+}
+
+void name_list::reserve(std::size_t count, std::size_t bytes)
+{
+    m_ends.reserve(count);
+    m_buf.reserve(bytes);
+}
+
+void name_list::clear() noexcept
+{
+    m_buf.clear();
+    m_ends.clear();
+}
+
+std::filesystem::path normalized_dir(const std::filesystem::path& dir)
+{
+    std::filesystem::path result = std::filesystem::absolute(dir).lexically_normal();
+    if(!result.has_filename() && result.has_relative_path())
+        result = result.parent_path();
+    return result;
+}
+
+static std::string generic_key(const std::filesystem::path& p)
+{
+    std::u8string str = p.generic_u8string();
+    return std::string(reinterpret_cast<const char*>(str.data()), str.size());
+}
+
+static std::filesystem::path from_generic(std::string_view str)
+{
+    return std::filesystem::path(
+        std::u8string_view(reinterpret_cast<const char8_t*>(str.data()), str.size())
+    );
+}
+
+static std::int64_t time_ticks(std::filesystem::file_time_type t) noexcept
+{
+    return static_cast<std::int64_t>(t.time_since_epoch().count());
+}
+
+/**
+ * @brief CRC-32 of the end of an archive, which holds the end of central directory record
+ *
+ * @return Zero if the archive cannot be read
+ */
+static std::uint32_t archive_tail_crc(const std::filesystem::path& sys_path, std::uint64_t size)
+{
+    const std::size_t n = static_cast<std::size_t>(
+        std::min<std::uint64_t>(size, manifest_format::archive_tail_size)
+    );
+
+    std::ifstream ifs(sys_path, std::ios_base::in | std::ios_base::binary);
+    if(!ifs.is_open())
+        return 0;
+    std::vector<char> buf(n);
+    ifs.seekg(static_cast<std::streamoff>(size - n));
+    if(!ifs.read(buf.data(), static_cast<std::streamsize>(n)))
+        return 0;
+
+    return static_cast<std::uint32_t>(
+        crc32(crc32(0, nullptr, 0), reinterpret_cast<const Bytef*>(buf.data()), static_cast<uInt>(n))
+    );
+}
+
+auto mount_manifest::manifest_data::list_dir(const std::filesystem::path& abs_dir) -> const dir_record&
+{
+    namespace stdfs = std::filesystem;
+
+    std::string key = generic_key(abs_dir);
+
+    auto is_valid = [&](const dir_record& rec)
+    {
+        for(std::size_t i = 0; i < rec.dirs.size(); ++i)
+        {
+            std::error_code ec;
+            const std::string_view name = rec.dirs[i];
+            const auto t = stdfs::last_write_time(name.empty() ? abs_dir : abs_dir / from_generic(name), ec);
+            if(ec || time_ticks(t) != rec.dir_times[i])
+                return false;
+        }
+        return true;
+    };
+
+    auto it = dirs.find(key);
+    if(it != dirs.end() && is_valid(it->second))
+    {
+        ++hits;
+        return it->second;
+    }
+
+    dir_record rec;
+    // Times are read before listing the directories, so changes during the scan invalidate the record next time
+    rec.dirs.push_back(std::string_view());
+    rec.dir_times.push_back(time_ticks(stdfs::last_write_time(abs_dir)));
+    for(const auto& i : stdfs::recursive_directory_iterator(abs_dir))
+    {
+        std::u8string rel = i.path().lexically_relative(abs_dir).generic_u8string();
+        std::string_view name(reinterpret_cast<const char*>(rel.data()), rel.size());
+        if(i.is_directory())
+        {
+            rec.dirs.push_back(name);
+            rec.dir_times.push_back(time_ticks(i.last_write_time()));
+        }
+        else
+            rec.files.push_back(name);
+    }
+
+    ++misses;
+    if(it != dirs.end())
+    {
+        it->second = std::move(rec);
+        return it->second;
+    }
+    return dirs.emplace(std::move(key), std::move(rec)).first->second;
+}
+
+void mount_manifest::manifest_data::open_archive(
+    zip_archive& ar, const std::filesystem::path& sys_path, bool memory_map
+)
+{
+    namespace stdfs = std::filesystem;
+
+    const stdfs::path abs_path = stdfs::absolute(sys_path).lexically_normal();
+
+    std::error_code ec;
+    const std::uint64_t file_size = stdfs::file_size(abs_path, ec);
+    const auto write_time = ec ? stdfs::file_time_type() : stdfs::last_write_time(abs_path, ec);
+    if(ec)
+    {
+        // Let opening report the error
+        ar.open(sys_path, memory_map);
+        return;
+    }
+    const std::uint32_t tail_crc = archive_tail_crc(abs_path, file_size);
+
+    std::string key = generic_key(abs_path);
+    auto it = archives.find(key);
+    if(it != archives.end())
+    {
+        const archive_record& rec = it->second;
+        if(rec.file_size == file_size && rec.write_time == time_ticks(write_time) && rec.tail_crc == tail_crc)
+        {
+            ar.open(abs_path, memory_map, rec.index, rec.names);
+            ++hits;
+            return;
+        }
+    }
+
+    ar.open(abs_path, memory_map);
+
+    archive_record rec;
+    rec.file_size = file_size;
+    rec.write_time = time_ticks(write_time);
+    rec.tail_crc = tail_crc;
+    rec.index.reserve(ar.entry_count());
+    for(std::size_t i = 0; i < ar.entry_count(); ++i)
+    {
+        const std::string_view name = ar.entry_name(i);
+
+        auto& e = rec.index.emplace_back(ar.entry(i));
+        e.mapped_offset = -1;
+        e.name_offset = static_cast<std::uint32_t>(rec.names.size());
+        e.name_size = static_cast<std::uint32_t>(name.size());
+        rec.names += name;
+    }
+
+    ++misses;
+    archives.insert_or_assign(std::move(key), std::move(rec));
+}
+
+std::string mount_manifest::manifest_data::serialize() const
+{
+    using namespace manifest_format;
+
+    std::string payload;
+    writer w(payload);
+    for(const auto& [key, rec] : dirs)
+    {
+        w.put(static_cast<std::uint8_t>(record_dir));
+        w.put_string(key);
+
+        w.put(static_cast<std::uint32_t>(rec.dirs.size()));
+        for(std::size_t i = 0; i < rec.dirs.size(); ++i)
+        {
+            w.put(rec.dir_times[i]);
+            w.put_string(rec.dirs[i]);
+        }
+        w.put(static_cast<std::uint32_t>(rec.files.size()));
+        for(std::size_t i = 0; i < rec.files.size(); ++i)
+            w.put_string(rec.files[i]);
+    }
+    for(const auto& [key, rec] : archives)
+    {
+        w.put(static_cast<std::uint8_t>(record_archive));
+        w.put_string(key);
+
+        w.put(rec.file_size);
+        w.put(rec.write_time);
+        w.put(rec.tail_crc);
+        w.put(static_cast<std::uint32_t>(rec.index.size()));
+        for(const auto& e : rec.index)
+        {
+            w.put(e.cd_offset);
+            w.put(e.local_header_offset);
+            w.put(e.compressed_size);
+            w.put(e.uncompressed_size);
+            w.put(e.crc);
+            w.put(e.method);
+            w.put(e.flag);
+            w.put(static_cast<std::uint8_t>(e.is_dir));
+            w.put_string(std::string_view(rec.names).substr(e.name_offset, e.name_size));
+        }
+    }
+
+    std::string result;
+    result.reserve(header_size + payload.size());
+    result.append(magic, sizeof(magic));
+    writer h(result);
+    h.put(version);
+    h.put(static_cast<std::uint32_t>(dirs.size() + archives.size()));
+    h.put(static_cast<std::uint64_t>(payload.size()));
+    h.put(static_cast<std::uint32_t>(
+        crc32_z(crc32(0, nullptr, 0), reinterpret_cast<const Bytef*>(payload.data()), payload.size())
+    ));
+    h.put(std::uint32_t(0)); // Reserved
+    result += payload;
+
+    return result;
+}
+
+bool mount_manifest::manifest_data::deserialize(std::span<const std::byte> data)
+{
+    using namespace manifest_format;
+
+    if(data.size() < header_size || std::memcmp(data.data(), magic, sizeof(magic)) != 0)
+        return false;
+
+    reader h(data.subspan(sizeof(magic), header_size - sizeof(magic)));
+    std::uint32_t file_version = 0;
+    std::uint32_t record_count = 0;
+    std::uint64_t payload_size = 0;
+    std::uint32_t payload_crc = 0;
+    h.get(file_version);
+    h.get(record_count);
+    h.get(payload_size);
+    h.get(payload_crc);
+    if(file_version != version || payload_size != data.size() - header_size)
+        return false;
+
+    const auto payload = data.subspan(header_size);
+    const auto crc = crc32_z(
+        crc32(0, nullptr, 0), reinterpret_cast<const Bytef*>(payload.data()), payload.size()
+    );
+    if(crc != payload_crc)
+        return false;
+
+    reader r(payload);
+    for(std::uint32_t n = 0; n < record_count; ++n)
+    {
+        std::uint8_t kind = 0;
+        std::string_view key;
+        if(!r.get(kind) || !r.get_string(key))
+            return false;
+
+        if(kind == record_dir)
+        {
+            dir_record rec;
+
+            std::uint32_t dir_count = 0;
+            if(!r.get(dir_count) || !r.check_count(dir_count, min_dir_size))
+                return false;
+            rec.dirs.reserve(dir_count, 0);
+            rec.dir_times.reserve(dir_count);
+            for(std::uint32_t i = 0; i < dir_count; ++i)
+            {
+                std::int64_t t = 0;
+                std::string_view name;
+                if(!r.get(t) || !r.get_string(name))
+                    return false;
+                rec.dir_times.push_back(t);
+                rec.dirs.push_back(name);
+            }
+            // The first directory is the recorded one itself
+            if(dir_count == 0 || !rec.dirs[0].empty())
+                return false;
+
+            std::uint32_t file_count = 0;
+            if(!r.get(file_count) || !r.check_count(file_count, min_file_size))
+                return false;
+            rec.files.reserve(file_count, 0);
+            for(std::uint32_t i = 0; i < file_count; ++i)
+            {
+                std::string_view name;
+                if(!r.get_string(name))
+                    return false;
+                rec.files.push_back(name);
+            }
+
+            dirs.insert_or_assign(std::string(key), std::move(rec));
+        }
+        else if(kind == record_archive)
+        {
+            archive_record rec;
+
+            std::uint32_t entry_count = 0;
+            if(!r.get(rec.file_size) || !r.get(rec.write_time) || !r.get(rec.tail_crc) ||
+               !r.get(entry_count) || !r.check_count(entry_count, min_entry_size))
+                return false;
+            rec.index.reserve(entry_count);
+            for(std::uint32_t i = 0; i < entry_count; ++i)
+            {
+                auto& e = rec.index.emplace_back();
+                std::uint8_t is_dir = 0;
+                std::string_view name;
+                r.get(e.cd_offset);
+                r.get(e.local_header_offset);
+                r.get(e.compressed_size);
+                r.get(e.uncompressed_size);
+                r.get(e.crc);
+                r.get(e.method);
+                r.get(e.flag);
+                r.get(is_dir);
+                if(!r.get_string(name) || rec.names.size() + name.size() > std::numeric_limits<std::uint32_t>::max())
+                    return false;
+
+                e.is_dir = is_dir != 0;
+                e.name_offset = static_cast<std::uint32_t>(rec.names.size());
+                e.name_size = static_cast<std::uint32_t>(name.size());
+                rec.names += name;
+            }
+
+            archives.insert_or_assign(std::string(key), std::move(rec));
+        }
+        else
+            return false;
+    }
+
+    return r.remaining() == 0;
+}
+
+mount_manifest::mount_manifest()
+    : m_data(new manifest_data()) {}
+
+mount_manifest::mount_manifest(mount_manifest&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)) {}
+
+mount_manifest::~mount_manifest()
+{
+    delete m_data;
+}
+
+mount_manifest& mount_manifest::operator=(mount_manifest&& rhs) noexcept
+{
+    if(this == &rhs) [[unlikely]]
+        return *this;
+
+    delete m_data;
+    m_data = std::exchange(rhs.m_data, nullptr);
+    return *this;
+}
+
+bool mount_manifest::load(const std::filesystem::path& sys_path)
+{
+    clear();
+
+    mapped_file file;
+    if(!file.open(sys_path))
+        return false;
+
+    if(!m_data->deserialize(file.bytes()))
+    {
+        clear();
+        return false;
+    }
+
+    return true;
+}
+
+void mount_manifest::save(const std::filesystem::path& sys_path) const
+{
+    const std::string data = m_data->serialize();
+
+    std::filesystem::path tmp_path = sys_path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream ofs(tmp_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        if(!ofs.is_open())
+            throw virtual_file_system::error(stdfs_err_msg("failed to open ", tmp_path));
+        ofs.write(data.data(), static_cast<std::streamsize>(data.size()));
+        ofs.close();
+        if(!ofs)
+            throw virtual_file_system::error(stdfs_err_msg("failed to write ", tmp_path));
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, sys_path, ec);
+    if(ec)
+        throw virtual_file_system::error(stdfs_err_msg("failed to write ", sys_path));
+}
+
+void mount_manifest::clear() noexcept
+{
+    m_data->dirs.clear();
+    m_data->archives.clear();
+}
+
+std::size_t mount_manifest::size() const noexcept
+{
+    return m_data->dirs.size() + m_data->archives.size();
+}
+
+std::size_t mount_manifest::hits() const noexcept
+{
+    return m_data->hits;
+}
+
+std::size_t mount_manifest::misses() const noexcept
+{
+    return m_data->misses;
+}
+} // namespace lochfolk
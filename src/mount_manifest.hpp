@@ -0,0 +1,139 @@
+#ifndef LOCHFOLK_MOUNT_MANIFEST_HPP
+#define LOCHFOLK_MOUNT_MANIFEST_HPP
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <filesystem>
+#include <lochfolk/vfs.hpp>
+#include "archive.hpp"
+
+namespace lochfolk
+{
+/**
+ * @brief Layout of mount manifests
+ *
+ * All integers are little-endian. Strings are stored as a 32-bit size followed by their bytes.
+ *
+ * | Part    | Content                                                         |
+ * | ------- | --------------------------------------------------------------- |
+ * | Header  | `header_size` bytes: magic, version, record count, payload size |
+ * |         | and the CRC-32 of the payload                                   |
+ * | Payload | Records, each starting with its kind and its key                |
+ *
+ * A directory record holds the relative paths and modification times of its directories,
+ * followed by the relative paths of its files.
+ * An archive record holds the size, the modification time and the tail CRC of the archive,
+ * followed by the central directory records of its entries and their names.
+ */
+namespace manifest_format
+{
+    inline constexpr char magic[8] = {'L', 'O', 'C', 'H', 'M', 'N', 'F', 'T'};
+    inline constexpr std::uint32_t version = 1;
+
+    inline constexpr std::size_t header_size = 32;
+
+    enum record_kind : std::uint8_t
+    {
+        record_dir = 0,
+        record_archive = 1
+    };
+
+    /**
+     * @brief Bytes at the end of an archive covered by its tail CRC
+     *
+     * It is large enough for the end of central directory record with the longest comment.
+     */
+    inline constexpr std::size_t archive_tail_size = 64 * 1024 + 22;
+} // namespace manifest_format
+
+/**
+ * @brief Relative paths stored in a single buffer
+ */
+class name_list
+{
+public:
+    [[nodiscard]]
+    std::size_t size() const noexcept
+    {
+        return m_ends.size();
+    }
+
+    [[nodiscard]]
+    std::string_view operator[](std::size_t i) const noexcept
+    {
+        const std::size_t begin = i == 0 ? 0 : m_ends[i - 1];
+        return std::string_view(m_buf).substr(begin, m_ends[i] - begin);
+    }
+
+    void push_back(std::string_view name);
+
+    void reserve(std::size_t count, std::size_t bytes);
+
+    void clear() noexcept;
+
+private:
+    std::string m_buf;
+    std::vector<std::size_t> m_ends;
+};
+
+struct mount_manifest::manifest_data
+{
+    struct dir_record
+    {
+        // Relative paths of all directories including the root (empty), and their modification times
+        name_list dirs;
+        std::vector<std::int64_t> dir_times;
+        name_list files;
+    };
+
+    struct archive_record
+    {
+        std::uint64_t file_size = 0;
+        std::int64_t write_time = 0;
+        std::uint32_t tail_crc = 0;
+        std::vector<zip_archive::entry_info> index;
+        std::string names;
+    };
+
+    // Keyed by normalized absolute paths of the sources in generic format
+    std::unordered_map<std::string, dir_record> dirs;
+    std::unordered_map<std::string, archive_record> archives;
+
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+
+    /**
+     * @brief List the files of a directory from its record, refreshing the record if it is not valid
+     *
+     * @param abs_dir Normalized absolute path of the directory
+     */
+    const dir_record& list_dir(const std::filesystem::path& abs_dir);
+
+    /**
+     * @brief Open an archive with the index of its record, refreshing the record if it is not valid
+     */
+    void open_archive(zip_archive& ar, const std::filesystem::path& sys_path, bool memory_map);
+
+    [[nodiscard]]
+    std::string serialize() const;
+
+    /**
+     * @return False if the data is not a valid manifest
+     */
+    bool deserialize(std::span<const std::byte> data);
+};
+
+/**
+ * @brief Normalized absolute path of a directory without trailing separator
+ */
+std::filesystem::path normalized_dir(const std::filesystem::path& dir);
+} // namespace lochfolk
+
+#endif
@@ -0,0 +1,82 @@
+#include "name_pool.hpp"
+#include <cassert>
+#include <algorithm>
+#include <string>
+
+namespace lochfolk::detail
+{
+name_pool::name_pool(std::pmr::memory_resource* mr, bool fold_case)
+    : m_names(mr), m_blocks(mr), m_large_names(mr), m_fold_case(fold_case) {}
+
+name_pool::~name_pool()
+{
+    std::pmr::memory_resource* mr = resource();
+    for(char* block : m_blocks)
+        mr->deallocate(block, block_size, 1);
+    for(std::span<char> name : m_large_names)
+        mr->deallocate(name.data(), name.size(), 1);
+}
+
+std::string_view name_pool::intern(std::string_view name, std::size_t hash)
+{
+    if(const auto* found = m_names.find_entry(name, hash))
+        return found->key();
+
+    std::string_view stored = store(name);
+    m_names.emplace_new(stored, hash);
+    return stored;
+}
+
+std::string_view name_pool::intern_spelled(std::string_view folded, std::string_view spelling)
+{
+    assert(folded.size() == spelling.size());
+
+    std::string combined;
+    combined.reserve(folded.size() * 2);
+    combined += folded;
+    combined += spelling;
+
+    return intern(combined).substr(0, folded.size());
+}
+
+std::size_t name_pool::memory_usage() const noexcept
+{
+    return m_names.memory_usage() +
+           m_blocks.capacity() * sizeof(m_blocks[0]) +
+           m_blocks.size() * block_size +
+           m_large_names.capacity() * sizeof(m_large_names[0]) +
+           m_large_size;
+}
+
+std::string_view name_pool::store(std::string_view name)
+{
+    if(name.empty())
+        return std::string_view();
+
+    std::pmr::memory_resource* mr = resource();
+
+    char* dst = nullptr;
+    if(name.size() > block_size / 16)
+    {
+        m_large_names.reserve(m_large_names.size() + 1);
+        dst = static_cast<char*>(mr->allocate(name.size(), 1));
+        m_large_names.emplace_back(dst, name.size());
+        m_large_size += name.size();
+    }
+    else
+    {
+        if(block_size - m_block_used < name.size())
+        {
+            m_blocks.reserve(m_blocks.size() + 1);
+            m_blocks.push_back(static_cast<char*>(mr->allocate(block_size, 1)));
+            m_block_used = 0;
+        }
+
+        dst = m_blocks.back() + m_block_used;
+        m_block_used += name.size();
+    }
+
+    std::ranges::copy(name, dst);
+    return std::string_view(dst, name.size());
+}
+} // namespace lochfolk::detail
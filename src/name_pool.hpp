@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "flat_string_map.hpp"
+
+namespace lochfolk::detail
+{
+/**
+ * @brief Monotonic arena of interned names
+ *
+ * Each distinct name is stored once in large blocks, so nodes can refer to their names by views
+ * instead of owning a string each. Views returned by `intern` stay valid until the pool is destroyed.
+ * Names are never freed when the nodes using them are removed.
+ * All memory is allocated from the memory resource given on construction.
+ *
+ * The pool also carries the case sensitivity of its tree, since every insertion into the tree goes through it.
+ */
+class name_pool
+{
+    struct empty_value
+    {};
+
+public:
+    /**
+     * @param fold_case True if the tree looks up names by their case-folded forms
+     */
+    explicit name_pool(std::pmr::memory_resource* mr, bool fold_case = false);
+
+    name_pool(const name_pool&) = delete;
+
+    ~name_pool();
+
+    /**
+     * @brief Get the stored copy of a name, storing it if it is new
+     */
+    [[nodiscard]]
+    std::string_view intern(std::string_view name)
+    {
+        return intern(name, flat_string_map<empty_value, std::string_view>::hash_key(name));
+    }
+
+    /**
+     * @brief Same as above, reusing the hash of the name computed by `flat_string_map::hash_key`
+     */
+    [[nodiscard]]
+    std::string_view intern(std::string_view name, std::size_t hash);
+
+    /**
+     * @brief Store a folded name followed by its original spelling, so the view of the folded name refers to both
+     *
+     * @param spelling Must be as long as the folded name
+     *
+     * @return The stored folded name. Use `spelling_of` to get the spelling.
+     */
+    [[nodiscard]]
+    std::string_view intern_spelled(std::string_view folded, std::string_view spelling);
+
+    /**
+     * @brief Original spelling of a name returned by `intern_spelled`
+     */
+    [[nodiscard]]
+    static std::string_view spelling_of(std::string_view folded) noexcept
+    {
+        return std::string_view(folded.data() + folded.size(), folded.size());
+    }
+
+    [[nodiscard]]
+    std::pmr::memory_resource* resource() const noexcept
+    {
+        return m_names.resource();
+    }
+
+    [[nodiscard]]
+    bool folds_case() const noexcept
+    {
+        return m_fold_case;
+    }
+
+    [[nodiscard]]
+    std::size_t size() const noexcept
+    {
+        return m_names.size();
+    }
+
+    /**
+     * @brief Heap memory used by the pool in bytes
+     */
+    [[nodiscard]]
+    std::size_t memory_usage() const noexcept;
+
+private:
+    static constexpr std::size_t block_size = 16 * 1024;
+
+    [[nodiscard]]
+    std::string_view store(std::string_view name);
+
+    // Keys are the stored copies
+    flat_string_map<empty_value, std::string_view> m_names;
+    // Blocks of `block_size` bytes
+    std::pmr::vector<char*> m_blocks;
+    std::size_t m_block_used = block_size;
+    // Names too long for sharing a block are stored separately
+    std::pmr::vector<std::span<char>> m_large_names;
+    std::size_t m_large_size = 0;
+    bool m_fold_case;
+};
+} // namespace lochfolk::detail
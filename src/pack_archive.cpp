@@ -0,0 +1,614 @@
+#include "pack_archive.hpp"
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include <lochfolk/utility.hpp>
+#include <lz4.h>
+#include <zstd.h>
+#include "errmsg.hpp"
+#include "worker_pool.hpp"
+
+namespace lochfolk
+{
+namespace pack_format
+{
+    template <std::unsigned_integral T>
+    static void store_le(std::byte* out, T val) noexcept
+    {
+        for(std::size_t i = 0; i < sizeof(T); ++i)
+            out[i] = static_cast<std::byte>((val >> (i * 8)) & 0xFF);
+    }
+
+    template <std::unsigned_integral T>
+    static T load_le(const std::byte* in) noexcept
+    {
+        T val = 0;
+        for(std::size_t i = 0; i < sizeof(T); ++i)
+            val |= static_cast<T>(std::to_integer<T>(in[i]) << (i * 8));
+        return val;
+    }
+
+    void write_header(std::span<std::byte, header_size> out, const pack_header& h) noexcept
+    {
+        std::ranges::fill(out, std::byte(0));
+        std::memcpy(out.data(), magic, sizeof(magic));
+        store_le(out.data() + 8, h.version);
+        store_le(out.data() + 12, h.alignment);
+        store_le(out.data() + 16, h.entry_count);
+        store_le(out.data() + 24, h.index_offset);
+        store_le(out.data() + 32, h.names_offset);
+        store_le(out.data() + 40, h.names_size);
+        store_le(out.data() + 48, h.file_size);
+        store_le(out.data() + 56, h.chunk_size);
+    }
+
+    pack_header read_header(std::span<const std::byte, header_size> in) noexcept
+    {
+        pack_header h;
+        h.version = load_le<std::uint32_t>(in.data() + 8);
+        h.alignment = load_le<std::uint32_t>(in.data() + 12);
+        h.entry_count = load_le<std::uint64_t>(in.data() + 16);
+        h.index_offset = load_le<std::uint64_t>(in.data() + 24);
+        h.names_offset = load_le<std::uint64_t>(in.data() + 32);
+        h.names_size = load_le<std::uint64_t>(in.data() + 40);
+        h.file_size = load_le<std::uint64_t>(in.data() + 48);
+        h.chunk_size = load_le<std::uint32_t>(in.data() + 56);
+        return h;
+    }
+
+    void write_entry(std::span<std::byte, entry_record_size> out, const entry_record& e) noexcept
+    {
+        store_le(out.data(), e.offset);
+        store_le(out.data() + 8, e.stored_size);
+        store_le(out.data() + 16, e.size);
+        store_le(out.data() + 24, e.name_offset);
+        store_le(out.data() + 28, e.name_size);
+        out[30] = static_cast<std::byte>(e.encoding);
+        out[31] = static_cast<std::byte>(e.flags);
+    }
+
+    entry_record read_entry(std::span<const std::byte, entry_record_size> in) noexcept
+    {
+        entry_record e;
+        e.offset = load_le<std::uint64_t>(in.data());
+        e.stored_size = load_le<std::uint64_t>(in.data() + 8);
+        e.size = load_le<std::uint64_t>(in.data() + 16);
+        e.name_offset = load_le<std::uint32_t>(in.data() + 24);
+        e.name_size = load_le<std::uint16_t>(in.data() + 28);
+        e.encoding = static_cast<pack_encoding>(in[30]);
+        e.flags = std::to_integer<std::uint8_t>(in[31]);
+        return e;
+    }
+} // namespace pack_format
+
+/**
+ * @brief Stream buffer over a raw entry in the mapped pack
+ *
+ * It keeps the archive alive, so the mapping won't be released while the buffer is in use.
+ */
+class pack_archive::mapped_buf final : public span_buf
+{
+public:
+    mapped_buf(
+        std::shared_ptr<const pack_archive> ar,
+        std::span<const std::byte> data,
+        std::ios_base::openmode mode
+    )
+        : span_buf(
+              std::span<char>(
+                  const_cast<char*>(reinterpret_cast<const char*>(data.data())),
+                  data.size()
+              ),
+              mode
+          ),
+          m_archive(std::move(ar))
+    {}
+
+private:
+    std::shared_ptr<const pack_archive> m_archive;
+};
+
+pack_archive::pack_archive() = default;
+
+pack_archive::~pack_archive()
+{
+    close();
+}
+
+void pack_archive::open(const std::filesystem::path& sys_path)
+{
+    using namespace pack_format;
+
+    close();
+
+    if(!m_mapping.open(sys_path))
+        throw virtual_file_system::error(stdfs_err_msg("failed to map ", sys_path));
+
+    auto invalid = [&](std::string_view reason)
+    {
+        close();
+        std::string suffix = " is not a valid pack: ";
+        suffix += reason;
+        return virtual_file_system::error(stdfs_err_msg(sys_path, suffix));
+    };
+
+    std::span<const std::byte> bytes = m_mapping.bytes();
+    if(bytes.size() < header_size ||
+       std::memcmp(bytes.data(), magic, sizeof(magic)) != 0)
+        throw invalid("bad magic");
+
+    const pack_header h = read_header(bytes.first<header_size>());
+    if(h.version != version)
+        throw invalid("unsupported version " + std::to_string(h.version));
+    if(h.file_size != bytes.size())
+        throw invalid("truncated");
+    if(!std::has_single_bit(h.alignment))
+        throw invalid("bad alignment");
+
+    // All ranges are checked against the mapped size, so entries can be accessed without checking later
+    const std::uint64_t size = bytes.size();
+    if(h.index_offset > size ||
+       h.entry_count > (size - h.index_offset) / entry_record_size)
+        throw invalid("index out of range");
+    if(h.names_offset > size || h.names_size > size - h.names_offset)
+        throw invalid("names out of range");
+
+    m_entry_count = static_cast<std::size_t>(h.entry_count);
+    m_chunk_size = h.chunk_size;
+    m_index = bytes.subspan(
+        static_cast<std::size_t>(h.index_offset),
+        m_entry_count * entry_record_size
+    );
+    m_names = std::string_view(
+        reinterpret_cast<const char*>(bytes.data()) + h.names_offset,
+        static_cast<std::size_t>(h.names_size)
+    );
+
+    std::string_view prev_name;
+    for(std::size_t i = 0; i < m_entry_count; ++i)
+    {
+        const entry_record e = entry(i);
+
+        if(e.name_size == 0 || e.name_offset > m_names.size() || e.name_size > m_names.size() - e.name_offset)
+            throw invalid("name out of range");
+        if(e.offset > size || e.stored_size > size - e.offset)
+            throw invalid("data out of range");
+
+        switch(e.encoding)
+        {
+        case pack_encoding::raw:
+            if(e.stored_size != e.size)
+                throw invalid("size mismatch");
+            break;
+        case pack_encoding::lz4:
+            // Sizes of a chunked entry are checked by its blocks
+            if(!e.is_chunked() &&
+               (e.stored_size > std::numeric_limits<int>::max() || e.size > std::numeric_limits<int>::max()))
+                throw invalid("size mismatch");
+            if(e.is_chunked() && h.chunk_size > std::numeric_limits<int>::max())
+                throw invalid("bad chunk size");
+            break;
+        case pack_encoding::zstd:
+            break;
+        default:
+            throw invalid("unknown encoding");
+        }
+
+        if(e.is_chunked())
+        {
+            // The block table must fit in the data, while the blocks are checked when decoding
+            if(h.chunk_size == 0 || e.encoding == pack_encoding::raw)
+                throw invalid("bad chunked entry");
+            std::uint64_t block_count = (e.size + h.chunk_size - 1) / h.chunk_size;
+            if(block_count > e.stored_size / sizeof(std::uint64_t))
+                throw invalid("block table out of range");
+        }
+
+        std::string_view name = entry_name(i);
+        if(i != 0 && !(prev_name < name))
+            throw invalid("index is not sorted");
+        prev_name = name;
+    }
+}
+
+void pack_archive::close() noexcept
+{
+    m_entry_count = 0;
+    m_chunk_size = 0;
+    m_index = std::span<const std::byte>();
+    m_names = std::string_view();
+    m_mapping.close();
+}
+
+std::unique_ptr<std::streambuf> pack_archive::getbuf(
+    std::size_t idx, std::ios_base::openmode mode
+) const
+{
+    if(auto data = view_bytes(idx))
+    {
+        mode &= ~std::ios_base::out;
+        return std::make_unique<mapped_buf>(
+            std::static_pointer_cast<const pack_archive>(shared_from_this()),
+            *data,
+            mode
+        );
+    }
+
+    return archive::getbuf(idx, mode);
+}
+
+std::string pack_archive::read_string(std::size_t idx) const
+{
+    const auto e = entry(idx);
+
+    std::string result;
+    result.resize(static_cast<std::size_t>(e.size));
+    decode(e, std::as_writable_bytes(std::span(result)));
+
+    return result;
+}
+
+std::vector<std::byte> pack_archive::read_bytes(std::size_t idx) const
+{
+    const auto e = entry(idx);
+
+    std::vector<std::byte> result;
+    result.resize(static_cast<std::size_t>(e.size));
+    decode(e, result);
+
+    return result;
+}
+
+std::optional<std::span<const std::byte>> pack_archive::view_bytes(std::size_t idx) const
+{
+    const auto e = entry(idx);
+    if(e.encoding != pack_encoding::raw)
+        return std::nullopt;
+
+    return m_mapping.bytes().subspan(
+        static_cast<std::size_t>(e.offset),
+        static_cast<std::size_t>(e.stored_size)
+    );
+}
+
+std::uint64_t pack_archive::get_file_size(std::size_t idx) const
+{
+    return entry(idx).size;
+}
+
+pack_format::entry_record pack_archive::entry(std::size_t idx) const noexcept
+{
+    assert(idx < m_entry_count);
+    return pack_format::read_entry(
+        m_index.subspan(idx * pack_format::entry_record_size)
+            .first<pack_format::entry_record_size>()
+    );
+}
+
+std::string_view pack_archive::entry_name(std::size_t idx) const noexcept
+{
+    const auto e = entry(idx);
+    return m_names.substr(e.name_offset, e.name_size);
+}
+
+namespace
+{
+    void decode_data(pack_encoding encoding, std::span<const std::byte> in, std::span<std::byte> out)
+    {
+        switch(encoding)
+        {
+        case pack_encoding::raw:
+            if(in.size() != out.size())
+                throw virtual_file_system::error("corrupted raw data in pack: size mismatch");
+            std::ranges::copy(in, out.begin());
+            return;
+
+        case pack_encoding::lz4:
+            {
+                int n = LZ4_decompress_safe(
+                    reinterpret_cast<const char*>(in.data()),
+                    reinterpret_cast<char*>(out.data()),
+                    static_cast<int>(in.size()),
+                    static_cast<int>(out.size())
+                );
+                if(n < 0 || static_cast<std::size_t>(n) != out.size())
+                    throw virtual_file_system::error("corrupted LZ4 data in pack");
+                return;
+            }
+
+        case pack_encoding::zstd:
+            {
+                std::size_t n = ZSTD_decompress(out.data(), out.size(), in.data(), in.size());
+                if(ZSTD_isError(n))
+                    throw virtual_file_system::error(std::string("corrupted zstd data in pack: ") + ZSTD_getErrorName(n));
+                if(n != out.size())
+                    throw virtual_file_system::error("corrupted zstd data in pack: size mismatch");
+                return;
+            }
+        }
+
+        assert(false && "unreachable");
+    }
+} // namespace
+
+void pack_archive::decode(const pack_format::entry_record& e, std::span<std::byte> out) const
+{
+    assert(out.size() == e.size);
+
+    auto in = m_mapping.bytes().subspan(
+        static_cast<std::size_t>(e.offset),
+        static_cast<std::size_t>(e.stored_size)
+    );
+
+    if(e.is_chunked())
+        decode_chunked(e, in, out);
+    else
+        decode_data(e.encoding, in, out);
+}
+
+void pack_archive::decode_chunked(
+    const pack_format::entry_record& e,
+    std::span<const std::byte> in,
+    std::span<std::byte> out
+) const
+{
+    const std::size_t chunk_size = m_chunk_size;
+    const std::size_t block_count = (out.size() + chunk_size - 1) / chunk_size;
+
+    auto table = in.first(block_count * sizeof(std::uint64_t));
+    auto blocks = in.subspan(table.size());
+
+    auto decode_block = [&](std::size_t i)
+    {
+        std::uint64_t begin = i == 0 ? 0 : pack_format::load_le<std::uint64_t>(table.data() + (i - 1) * sizeof(std::uint64_t));
+        std::uint64_t end = pack_format::load_le<std::uint64_t>(table.data() + i * sizeof(std::uint64_t));
+        if(begin > end || end > blocks.size())
+            throw virtual_file_system::error("corrupted block table in pack");
+
+        auto block_in = blocks.subspan(begin, end - begin);
+        auto block_out = out.subspan(i * chunk_size, std::min(chunk_size, out.size() - i * chunk_size));
+        decode_data(
+            block_in.size() == block_out.size() ? pack_encoding::raw : e.encoding,
+            block_in,
+            block_out
+        );
+    };
+
+    unsigned int max_threads = m_decode_threads;
+    if(max_threads == 0)
+        max_threads = std::max(1u, std::thread::hardware_concurrency());
+    if(max_threads <= 1 || block_count <= 1)
+    {
+        for(std::size_t i = 0; i < block_count; ++i)
+            decode_block(i);
+        return;
+    }
+
+    // Blocks are written straight into their place of the output, so the calling thread and the workers only share the counter
+    detail::worker_pool::shared().parallel_for(block_count, max_threads - 1, decode_block);
+}
+
+namespace
+{
+    /**
+     * @brief Encode data with the preferred encoding, falling back to raw if it does not make the data smaller
+     *
+     * @return Encoding actually used. The encoded data is appended to `out` unless the encoding is raw.
+     */
+    pack_encoding encode_data(
+        std::string_view data,
+        const pack_options& opts,
+        std::string& out
+    )
+    {
+        if(data.empty())
+            return pack_encoding::raw;
+
+        const std::size_t base = out.size();
+        switch(opts.encoding)
+        {
+        case pack_encoding::lz4:
+            {
+                if(data.size() > LZ4_MAX_INPUT_SIZE)
+                    break;
+
+                const std::size_t bound = static_cast<std::size_t>(LZ4_compressBound(static_cast<int>(data.size())));
+                out.resize(base + bound);
+                int n = LZ4_compress_default(
+                    data.data(),
+                    out.data() + base,
+                    static_cast<int>(data.size()),
+                    static_cast<int>(bound)
+                );
+                if(n <= 0 || static_cast<std::size_t>(n) >= data.size())
+                    break;
+
+                out.resize(base + static_cast<std::size_t>(n));
+                return pack_encoding::lz4;
+            }
+
+        case pack_encoding::zstd:
+            {
+                const std::size_t bound = ZSTD_compressBound(data.size());
+                out.resize(base + bound);
+                std::size_t n = ZSTD_compress(out.data() + base, bound, data.data(), data.size(), opts.level);
+                if(ZSTD_isError(n) || n >= data.size())
+                    break;
+
+                out.resize(base + n);
+                return pack_encoding::zstd;
+            }
+
+        default:
+            break;
+        }
+
+        out.resize(base);
+        return pack_encoding::raw;
+    }
+
+    /**
+     * @brief Encode data in blocks of `opts.chunk_size` bytes, each of which can be decoded independently
+     *
+     * @return false if it does not make the data smaller
+     */
+    bool encode_chunked(
+        std::string_view data,
+        const pack_options& opts,
+        std::string& out
+    )
+    {
+        const std::size_t block_count = (data.size() + opts.chunk_size - 1) / opts.chunk_size;
+
+        out.assign(block_count * sizeof(std::uint64_t), '\0');
+        const std::size_t table_size = out.size();
+        for(std::size_t i = 0; i < block_count; ++i)
+        {
+            std::string_view block = data.substr(i * opts.chunk_size, opts.chunk_size);
+            if(encode_data(block, opts, out) == pack_encoding::raw)
+                out += block;
+
+            pack_format::store_le<std::uint64_t>(
+                reinterpret_cast<std::byte*>(out.data()) + i * sizeof(std::uint64_t),
+                out.size() - table_size
+            );
+            if(out.size() >= data.size())
+                return false;
+        }
+
+        return true;
+    }
+
+    std::uint64_t align_up(std::uint64_t pos, std::uint64_t alignment) noexcept
+    {
+        return (pos + alignment - 1) & ~(alignment - 1);
+    }
+} // namespace
+
+void write_pack_file(
+    const std::filesystem::path& sys_path,
+    std::span<const pack_source> files,
+    const pack_options& opts
+)
+{
+    using namespace pack_format;
+
+    if(!std::has_single_bit(opts.alignment))
+        throw virtual_file_system::error("alignment of pack must be a power of two");
+    if(opts.encoding == pack_encoding::lz4 && opts.chunk_size > LZ4_MAX_INPUT_SIZE)
+        throw virtual_file_system::error("chunk size is too large for LZ4");
+
+    // The index is sorted by name for binary search, while the payloads follow the given order
+    std::vector<std::size_t> by_name(files.size());
+    std::iota(by_name.begin(), by_name.end(), std::size_t(0));
+    std::ranges::sort(
+        by_name,
+        [&](std::size_t lhs, std::size_t rhs)
+        { return files[lhs].name < files[rhs].name; }
+    );
+
+    std::vector<entry_record> records(files.size());
+    std::string names;
+    for(std::size_t i : by_name)
+    {
+        const auto& name = files[i].name;
+        if(name.empty() || name.size() > std::numeric_limits<std::uint16_t>::max())
+            throw virtual_file_system::error("invalid name of pack entry: \"" + name + '"');
+
+        records[i].name_offset = static_cast<std::uint32_t>(names.size());
+        records[i].name_size = static_cast<std::uint16_t>(name.size());
+        names += name;
+    }
+    if(names.size() > std::numeric_limits<std::uint32_t>::max())
+        throw virtual_file_system::error("too many names in pack");
+
+    pack_header h;
+    h.version = version;
+    h.alignment = opts.alignment;
+    h.entry_count = files.size();
+    h.index_offset = header_size;
+    h.names_offset = h.index_offset + files.size() * entry_record_size;
+    h.names_size = names.size();
+    h.chunk_size = opts.chunk_size;
+
+    std::ofstream ofs(sys_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if(!ofs.is_open())
+        throw virtual_file_system::error(stdfs_err_msg("failed to open ", sys_path));
+
+    const std::vector<char> padding(opts.alignment, '\0');
+    std::uint64_t pos = 0;
+    auto write_padding = [&](std::uint64_t to)
+    {
+        while(pos < to)
+        {
+            std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(to - pos, padding.size()));
+            ofs.write(padding.data(), static_cast<std::streamsize>(n));
+            pos += n;
+        }
+    };
+
+    // Reserve space for the header, index and names. They are written after the payloads.
+    write_padding(h.names_offset + h.names_size);
+    write_padding(align_up(pos, opts.alignment));
+
+    std::string encoded;
+    for(std::size_t i = 0; i < files.size(); ++i)
+    {
+        std::string data = files[i].read();
+        auto& e = records[i];
+
+        e.size = data.size();
+        encoded.clear();
+        if(opts.encoding != pack_encoding::raw && opts.chunk_size != 0 && data.size() > opts.chunk_size)
+        {
+            if(encode_chunked(data, opts, encoded))
+            {
+                e.encoding = opts.encoding;
+                e.flags |= entry_chunked;
+            }
+            else
+            {
+                e.encoding = pack_encoding::raw;
+            }
+        }
+        else
+        {
+            e.encoding = encode_data(data, opts, encoded);
+        }
+        std::string_view stored = e.encoding == pack_encoding::raw ? std::string_view(data) : encoded;
+        e.stored_size = stored.size();
+
+        if(stored.size() >= opts.alignment || pos % opts.alignment + stored.size() > opts.alignment)
+            write_padding(align_up(pos, opts.alignment));
+
+        e.offset = pos;
+        ofs.write(stored.data(), static_cast<std::streamsize>(stored.size()));
+        pos += stored.size();
+    }
+    h.file_size = pos;
+
+    std::vector<std::byte> head(static_cast<std::size_t>(h.names_offset));
+    write_header(std::span(head).first<header_size>(), h);
+    for(std::size_t i = 0; i < files.size(); ++i)
+    {
+        write_entry(
+            std::span(head)
+                .subspan(header_size + i * entry_record_size)
+                .first<entry_record_size>(),
+            records[by_name[i]]
+        );
+    }
+
+    ofs.seekp(0);
+    ofs.write(reinterpret_cast<const char*>(head.data()), static_cast<std::streamsize>(head.size()));
+    ofs.write(names.data(), static_cast<std::streamsize>(names.size()));
+    ofs.close();
+    if(!ofs)
+        throw virtual_file_system::error(stdfs_err_msg("failed to write ", sys_path));
+}
+} // namespace lochfolk
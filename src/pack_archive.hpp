@@ -0,0 +1,206 @@
+#ifndef LOCHFOLK_PACK_ARCHIVE_HPP
+#define LOCHFOLK_PACK_ARCHIVE_HPP
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <filesystem>
+#include <lochfolk/vfs.hpp>
+#include "archive.hpp"
+#include "mapped_file.hpp"
+
+namespace lochfolk
+{
+/**
+ * @brief Layout of the native pack format
+ *
+ * All integers are little-endian.
+ *
+ * | Part    | Content                                                            |
+ * | ------- | ------------------------------------------------------------------ |
+ * | Header  | `header_size` bytes, see `pack_header`                             |
+ * | Index   | `entry_count` records of `entry_record_size` bytes, sorted by name |
+ * | Names   | Concatenated entry names without separators                        |
+ * | Payload | Entry data, ordered by the access order given to the packer        |
+ *
+ * A chunked entry is split into blocks of `chunk_size` bytes that are encoded independently.
+ * Its data starts with a block table of little-endian 64-bit end offsets of the blocks,
+ * relative to the end of the table. A block whose stored size equals its decoded size is raw.
+ *
+ * The index and names are placed at the beginning, so mounting a pack only touches the first pages of the file.
+ * Payloads are aligned to the page size, so an entry is served by touching as few pages as possible.
+ */
+namespace pack_format
+{
+    inline constexpr char magic[8] = {'L', 'O', 'C', 'H', 'P', 'A', 'C', 'K'};
+    inline constexpr std::uint32_t version = 1;
+
+    inline constexpr std::size_t header_size = 64;
+    inline constexpr std::size_t entry_record_size = 32;
+
+    struct pack_header
+    {
+        std::uint32_t version = 0;
+        std::uint32_t alignment = 0;
+        std::uint64_t entry_count = 0;
+        std::uint64_t index_offset = 0;
+        std::uint64_t names_offset = 0;
+        std::uint64_t names_size = 0;
+        // Size of the whole pack, used for detecting truncated files
+        std::uint64_t file_size = 0;
+        // Decoded size of blocks of chunked entries
+        std::uint32_t chunk_size = 0;
+    };
+
+    enum entry_flags : std::uint8_t
+    {
+        entry_chunked = 1 << 0
+    };
+
+    struct entry_record
+    {
+        std::uint64_t offset = 0;
+        // Size of the data in the pack
+        std::uint64_t stored_size = 0;
+        // Size of the data after decoding
+        std::uint64_t size = 0;
+        // Offset of the name relative to the beginning of the names
+        std::uint32_t name_offset = 0;
+        std::uint16_t name_size = 0;
+        pack_encoding encoding = pack_encoding::raw;
+        std::uint8_t flags = 0;
+
+        [[nodiscard]]
+        bool is_chunked() const noexcept
+        {
+            return flags & entry_chunked;
+        }
+    };
+
+    void write_header(std::span<std::byte, header_size> out, const pack_header& h) noexcept;
+    pack_header read_header(std::span<const std::byte, header_size> in) noexcept;
+
+    void write_entry(std::span<std::byte, entry_record_size> out, const entry_record& e) noexcept;
+    entry_record read_entry(std::span<const std::byte, entry_record_size> in) noexcept;
+} // namespace pack_format
+
+/**
+ * @brief Archive of the native pack format
+ *
+ * The pack is always memory-mapped. Raw entries are served directly from the mapping without copying.
+ *
+ * @note All member functions are thread-safe after opening
+ */
+class pack_archive : public archive
+{
+public:
+    pack_archive();
+
+    pack_archive(const pack_archive&) = delete;
+    pack_archive(pack_archive&&) = delete;
+
+    ~pack_archive();
+
+    /**
+     * @brief Map a pack into memory and validate its header and index
+     *
+     * @exception virtual_file_system::error The file cannot be mapped or is not a valid pack
+     */
+    void open(const std::filesystem::path& sys_path);
+
+    void close() noexcept;
+
+    /**
+     * @brief Set the maximum number of threads decoding the blocks of a chunked entry
+     *
+     * @param max_threads Zero for the number of hardware threads
+     */
+    void set_decode_threads(unsigned int max_threads) noexcept
+    {
+        m_decode_threads = max_threads;
+    }
+
+    std::unique_ptr<std::streambuf> getbuf(
+        std::size_t idx, std::ios_base::openmode mode
+    ) const override;
+
+    std::string read_string(std::size_t idx) const override;
+    std::vector<std::byte> read_bytes(std::size_t idx) const override;
+
+    /**
+     * @brief Get a view of a raw entry in the mapped pack
+     *
+     * @return `std::nullopt` if the entry is compressed
+     */
+    std::optional<std::span<const std::byte>> view_bytes(std::size_t idx) const override;
+
+    std::uint64_t get_file_size(std::size_t idx) const override;
+
+    [[nodiscard]]
+    std::size_t entry_count() const noexcept
+    {
+        return m_entry_count;
+    }
+
+    [[nodiscard]]
+    pack_format::entry_record entry(std::size_t idx) const noexcept;
+
+    [[nodiscard]]
+    std::string_view entry_name(std::size_t idx) const noexcept;
+
+private:
+    class mapped_buf;
+
+    /**
+     * @brief Decode an entry into a buffer of its decoded size
+     *
+     * Blocks of a chunked entry are decoded on multiple threads.
+     */
+    void decode(const pack_format::entry_record& e, std::span<std::byte> out) const;
+
+    void decode_chunked(
+        const pack_format::entry_record& e,
+        std::span<const std::byte> in,
+        std::span<std::byte> out
+    ) const;
+
+    mapped_file m_mapping;
+    std::uint32_t m_chunk_size = 0;
+    unsigned int m_decode_threads = 0;
+    std::size_t m_entry_count = 0;
+    std::span<const std::byte> m_index;
+    std::string_view m_names;
+};
+
+/**
+ * @brief A file to be written into a pack
+ */
+struct pack_source
+{
+    // Path of the entry in the pack, without the leading separator
+    std::string name;
+    // Read the content of the file. It is called once when the file is being written.
+    std::function<std::string()> read;
+};
+
+/**
+ * @brief Write files into a pack
+ *
+ * @param files Files in the access order. Their payloads are laid out in this order.
+ *
+ * @exception virtual_file_system::error Failed to write the pack
+ */
+void write_pack_file(
+    const std::filesystem::path& sys_path,
+    std::span<const pack_source> files,
+    const pack_options& opts
+);
+} // namespace lochfolk
+
+#endif
@@ -0,0 +1,127 @@
+#include "perfect_hash.hpp"
+#include <algorithm>
+#include <bit>
+#include <numeric>
+#include <lochfolk/vfs.hpp>
+
+namespace lochfolk::detail
+{
+std::uint64_t perfect_hash::hash_key(std::string_view key) noexcept
+{
+    // FNV-1a is 64-bit on every target, unlike std::hash. The upper half is used as the fingerprint.
+    // Its result is mixed, since buckets are chosen by the lower bits.
+    std::uint64_t h = 0xCBF29CE484222325ull;
+    for(char ch : key)
+    {
+        h ^= static_cast<unsigned char>(ch);
+        h *= 0x100000001B3ull;
+    }
+
+    return mix(h, 0);
+}
+
+std::vector<std::uint32_t> perfect_hash::build(std::span<const std::string_view> keys)
+{
+    m_seeds.clear();
+    m_slot_count = 0;
+    std::vector<std::uint32_t> result(keys.size());
+    if(keys.empty())
+        return result;
+
+    std::vector<std::uint64_t> hashes(keys.size());
+    std::ranges::transform(keys, hashes.begin(), &perfect_hash::hash_key);
+
+    // Load factor between 0.4 and 0.8. A larger table is tried if seeds are hard to find.
+    std::size_t slot_count = std::bit_ceil(keys.size() + keys.size() / 4);
+    for(int attempt = 0; attempt < 4; ++attempt, slot_count *= 2)
+    {
+        if(try_build(hashes, slot_count, result))
+        {
+            m_slot_count = slot_count;
+            return result;
+        }
+    }
+
+    m_seeds.clear();
+    throw virtual_file_system::error("failed to build the perfect hash of paths");
+}
+
+bool perfect_hash::try_build(
+    std::span<const std::uint64_t> hashes,
+    std::size_t slot_count,
+    std::span<std::uint32_t> result
+)
+{
+    // Limit of seeds tried for a bucket before giving up on this table size
+    constexpr std::uint32_t max_seed = 1 << 16;
+
+    // About four keys per bucket
+    const std::size_t bucket_count = std::bit_ceil(std::max<std::size_t>(1, hashes.size() / 4));
+    m_seeds.assign(bucket_count, 0);
+    auto bucket_of = [&](std::uint32_t k)
+    { return hashes[k] & (bucket_count - 1); };
+    std::vector<bool> occupied(slot_count);
+
+    // Keys sorted by bucket, then buckets placed from the largest, since they are the hardest to place
+    std::vector<std::uint32_t> order(hashes.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::ranges::sort(
+        order,
+        [&](std::uint32_t lhs, std::uint32_t rhs)
+        { return bucket_of(lhs) < bucket_of(rhs); }
+    );
+
+    std::vector<std::span<const std::uint32_t>> buckets;
+    for(std::size_t i = 0; i < order.size();)
+    {
+        std::size_t j = i + 1;
+        const std::size_t b = bucket_of(order[i]);
+        while(j < order.size() && bucket_of(order[j]) == b)
+            ++j;
+        buckets.emplace_back(order.data() + i, j - i);
+        i = j;
+    }
+    std::ranges::stable_sort(
+        buckets,
+        [](const auto& lhs, const auto& rhs)
+        { return lhs.size() > rhs.size(); }
+    );
+
+    const std::size_t mask = slot_count - 1;
+    std::vector<std::size_t> positions;
+    for(const auto& bucket : buckets)
+    {
+        bool placed = false;
+        for(std::uint32_t seed = 0; seed < max_seed && !placed; ++seed)
+        {
+            positions.clear();
+            placed = true;
+            for(std::uint32_t k : bucket)
+            {
+                std::size_t pos = mix(hashes[k], seed) & mask;
+                if(occupied[pos] || std::ranges::find(positions, pos) != positions.end())
+                {
+                    placed = false;
+                    break;
+                }
+                positions.push_back(pos);
+            }
+
+            if(placed)
+            {
+                m_seeds[bucket_of(bucket[0])] = seed;
+                for(std::size_t i = 0; i < bucket.size(); ++i)
+                {
+                    occupied[positions[i]] = true;
+                    result[bucket[i]] = static_cast<std::uint32_t>(positions[i]);
+                }
+            }
+        }
+
+        if(!placed)
+            return false;
+    }
+
+    return true;
+}
+} // namespace lochfolk::detail
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace lochfolk::detail
+{
+/**
+ * @brief Perfect hash over a fixed set of strings
+ *
+ * It uses hash-and-displace: keys are grouped into buckets by their hash, and each bucket gets a seed
+ * that places all of its keys into free slots. A lookup reads one seed to get the only candidate slot,
+ * so it never probes a sequence of slots like open addressing does.
+ *
+ * The table only stores the seeds. The caller keeps its own array of `slot_count()` records
+ * indexed by slot, and compares the key in the record to confirm a hit.
+ */
+class perfect_hash
+{
+public:
+    struct probe
+    {
+        // The only slot that may hold the key
+        std::size_t slot;
+        // Upper bits of the hash, for rejecting most misses without comparing the key
+        std::uint32_t fingerprint;
+    };
+
+    /**
+     * @brief Build the table for distinct keys
+     *
+     * @return Slot of each key
+     */
+    std::vector<std::uint32_t> build(std::span<const std::string_view> keys);
+
+    /**
+     * @brief Size of the table. Zero before building or for an empty set.
+     */
+    [[nodiscard]]
+    std::size_t slot_count() const noexcept
+    {
+        return m_slot_count;
+    }
+
+    [[nodiscard]]
+    probe find(std::string_view key) const noexcept
+    {
+        assert(m_slot_count != 0);
+
+        const std::uint64_t h = hash_key(key);
+        const std::uint32_t seed = m_seeds[h & (m_seeds.size() - 1)];
+        return {mix(h, seed) & (m_slot_count - 1), fingerprint_of(h)};
+    }
+
+    [[nodiscard]]
+    static std::uint32_t fingerprint_of(std::string_view key) noexcept
+    {
+        return fingerprint_of(hash_key(key));
+    }
+
+    [[nodiscard]]
+    std::size_t memory_usage() const noexcept
+    {
+        return m_seeds.capacity() * sizeof(std::uint32_t);
+    }
+
+private:
+    [[nodiscard]]
+    static std::uint64_t hash_key(std::string_view key) noexcept;
+
+    [[nodiscard]]
+    static std::uint64_t mix(std::uint64_t h, std::uint32_t seed) noexcept
+    {
+        // Finalizer of splitmix64
+        std::uint64_t x = h + (static_cast<std::uint64_t>(seed) + 1) * 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    [[nodiscard]]
+    static std::uint32_t fingerprint_of(std::uint64_t h) noexcept
+    {
+        return static_cast<std::uint32_t>(h >> 32);
+    }
+
+    bool try_build(
+        std::span<const std::uint64_t> hashes,
+        std::size_t slot_count,
+        std::span<std::uint32_t> result
+    );
+
+    // Size is a power of two
+    std::vector<std::uint32_t> m_seeds;
+    // Zero or a power of two
+    std::size_t m_slot_count = 0;
+};
+} // namespace lochfolk::detail
@@ -1,37 +1,493 @@
 #include <lochfolk/vfs.hpp>
 #include <memory>
 #include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
 #include <lochfolk/utility.hpp>
 #include "errmsg.hpp"
 #include "file_node.hpp"
+#include "glob.hpp"
+#include "layer_table.hpp"
+#include "mount_manifest.hpp"
+#include "pack_archive.hpp"
+#include "worker_pool.hpp"
 
 namespace lochfolk
 {
+namespace detail
+{
+    /**
+     * @brief Collect the files of an archive for mounting them at a path
+     */
+    static std::vector<batch_entry> archive_batch(path_view p, zip_archive& ar)
+    {
+        const std::string base_key = path_index::key_of(p);
+
+        std::vector<batch_entry> result;
+        result.reserve(ar.entry_count());
+        for(std::size_t i = 0; i < ar.entry_count(); ++i)
+        {
+            if(ar.entry(i).is_dir)
+                continue;
+
+            result.emplace_back(
+                base_key,
+                ar.entry_name(i),
+                leaf_data(std::in_place_type<file_data::archive_entry>, ar, i)
+            );
+        }
+
+        return result;
+    }
+} // namespace detail
+
+struct mount_batch::batch_data
+{
+    std::vector<detail::batch_entry> entries;
+};
+
 struct virtual_file_system::vfs_data
 {
-    detail::file_node root;
+    detail::file_tree tree;
+    detail::layer_table layers;
+    // Lookups hold it shared. Modifications of the tree, including materializing lazy directories, hold it exclusively.
+    mutable std::shared_mutex mutex;
+    // Incremented by mounting and removing, which may replace or destroy nodes, so nodes cached by access contexts can be revalidated.
+    // It starts from 1, so a context that has not cached any node never matches it.
+    std::uint64_t generation = 1;
+
+    vfs_data(std::pmr::memory_resource* mr, bool fold_case)
+        : tree(mr, fold_case), layers(mr) {}
+
+    /**
+     * @brief Throw if a layer cannot be mounted into. The tree must be locked.
+     */
+    void check_layer(layer_id layer) const
+    {
+        if(!layers.active(layer)) [[unlikely]]
+            throw error("layer is not found");
+    }
+
+    /**
+     * @brief Mount a file into a layer. The tree must be locked exclusively.
+     */
+    template <typename T, typename... Args>
+    void mount(layer_id layer, path_view p, bool overwrite, std::in_place_type_t<T>, Args&&... args)
+    {
+        // Without layers, the base layer mounts destructively as the tree always did
+        ++generation;
+        if(layer == base_layer && layers.empty()) [[likely]]
+        {
+            mount_impl(tree, p, overwrite, std::in_place_type<T>, std::forward<Args>(args)...);
+            return;
+        }
+
+        layers.mount(
+            tree, p, layer, overwrite, detail::leaf_data(std::in_place_type<T>, std::forward<Args>(args)...)
+        );
+    }
+
+    /**
+     * @brief Mount a batch of files into a layer. The tree must be locked exclusively.
+     */
+    void mount_batch(layer_id layer, std::span<detail::batch_entry> entries, bool overwrite)
+    {
+        ++generation;
+        if(layer == base_layer && layers.empty()) [[likely]]
+        {
+            mount_batch_impl(tree, entries, overwrite);
+            return;
+        }
+
+        for(auto& e : entries)
+            layers.mount(tree, path_view(std::string_view(e.key)), layer, overwrite, std::move(e.data));
+    }
+
+    /**
+     * @brief Mount an opened archive. The tree must be locked exclusively.
+     *
+     * @param entries Result of `archive_batch`, or empty if the archive is requested to be mounted lazily
+     */
+    void mount_archive_locked(
+        layer_id layer,
+        path_view p,
+        std::shared_ptr<zip_archive> ar,
+        std::vector<detail::batch_entry> entries,
+        bool overwrite,
+        bool lazy
+    )
+    {
+        if(lazy)
+        {
+            // Files of layers are tracked individually, so archives in layers are always mounted eagerly
+            if(layer == base_layer && layers.empty())
+            {
+                ++generation;
+                mount_lazy_archive_impl(tree, p, std::move(ar), overwrite);
+                return;
+            }
+
+            entries = detail::archive_batch(p, *ar);
+        }
+
+        mount_batch(layer, entries, overwrite);
+    }
+
+    /**
+     * @brief Mount an opened archive, collecting its entries before locking the tree
+     */
+    void mount_archive(layer_id layer, path_view p, std::shared_ptr<zip_archive> ar, bool overwrite, bool lazy)
+    {
+        std::vector<detail::batch_entry> entries;
+        if(!lazy)
+            entries = detail::archive_batch(p, *ar);
 
-    vfs_data()
-        : root(nullptr, std::in_place_type<file_data::directory>) {}
+        std::unique_lock lock(mutex);
+        check_layer(layer);
+        mount_archive_locked(layer, p, std::move(ar), std::move(entries), overwrite, lazy);
+    }
+
+    /**
+     * @brief Call a function with the node found by a lookup (null if not found) while the tree is locked
+     *
+     * The lookup runs under a shared lock. It is retried under an exclusive lock
+     * if a directory of a lazily mounted archive needs to be materialized.
+     *
+     * @param find Called with a pointer to the blocked flag of `try_find_impl` under the shared lock,
+     *             and with null for materializing directories under the exclusive lock
+     */
+    template <typename Find, typename Fn>
+    decltype(auto) with_found(Find&& find, Fn&& fn) const
+    {
+        {
+            std::shared_lock lock(mutex);
+            bool blocked = false;
+            const detail::file_node* f = find(&blocked);
+            if(!blocked) [[likely]]
+                return fn(f);
+        }
+
+        std::unique_lock lock(mutex);
+        return fn(find(nullptr));
+    }
+
+    /**
+     * @brief Find a node while the tree is locked
+     *
+     * @param blocked Same as the parameter of `with_found`'s lookup
+     */
+    [[nodiscard]]
+    const detail::file_node* find(path_view p, bool* blocked) const
+    {
+        if(blocked)
+            return try_find_impl(tree, p, *blocked);
+        return find_impl(tree, p);
+    }
+
+    /**
+     * @brief Call a function with the node of a path (null if not found) while the tree is locked
+     */
+    template <typename Fn>
+    decltype(auto) with_node(path_view p, Fn&& fn) const
+    {
+        return with_found(
+            [&](bool* blocked)
+            { return find(p, blocked); },
+            std::forward<Fn>(fn)
+        );
+    }
 };
 
 virtual_file_system::virtual_file_system()
-    : m_vfs_data(new vfs_data())
+    : virtual_file_system(nullptr) {}
+
+virtual_file_system::virtual_file_system(std::pmr::memory_resource* mr)
+    : virtual_file_system(vfs_options{.memory_resource = mr}) {}
+
+virtual_file_system::virtual_file_system(const vfs_options& opts)
 {
-    assert(m_vfs_data->root.is_directory());
+    std::pmr::memory_resource* mr = opts.memory_resource;
+    if(!mr)
+        mr = std::pmr::get_default_resource();
+    m_vfs_data = std::pmr::polymorphic_allocator<>(mr).new_object<vfs_data>(mr, opts.case_insensitive);
+
+    assert(m_vfs_data->tree.root.is_directory());
 }
 
 virtual_file_system::~virtual_file_system()
 {
-    delete m_vfs_data;
+    std::pmr::polymorphic_allocator<>(get_memory_resource()).delete_object(m_vfs_data);
 }
 
 void virtual_file_system::mount_string(
     path_view p, std::string_view str, bool overwrite
 )
 {
-    mount_impl(
-        m_vfs_data->root,
+    mount_string(base_layer, p, str, overwrite);
+}
+
+void virtual_file_system::mount_string(
+    path_view p, const char* str, bool overwrite
+)
+{
+    mount_string(
+        p,
+        std::string_view(str),
+        overwrite
+    );
+}
+
+void virtual_file_system::mount_string(
+    path_view p, std::string str, bool overwrite
+)
+{
+    mount_string(base_layer, p, std::move(str), overwrite);
+}
+
+void virtual_file_system::mount_file(
+    path_view p, const std::filesystem::path& sys_path, bool overwrite
+)
+{
+    mount_file(base_layer, p, sys_path, overwrite);
+}
+
+void virtual_file_system::mount_dir(
+    path_view p, const std::filesystem::path& dir, bool overwrite
+)
+{
+    mount_dir(base_layer, p, dir, overwrite);
+}
+
+void virtual_file_system::mount_archive(
+    path_view p,
+    const std::filesystem::path& sys_path,
+    bool overwrite,
+    const archive_options& opts
+)
+{
+    mount_archive(base_layer, p, sys_path, overwrite, opts);
+}
+
+void virtual_file_system::mount_dir(
+    path_view p,
+    const std::filesystem::path& dir,
+    mount_manifest& manifest,
+    bool overwrite
+)
+{
+    mount_dir(base_layer, p, dir, manifest, overwrite);
+}
+
+void virtual_file_system::mount_archive(
+    path_view p,
+    const std::filesystem::path& sys_path,
+    mount_manifest& manifest,
+    bool overwrite,
+    const archive_options& opts
+)
+{
+    mount_archive(base_layer, p, sys_path, manifest, overwrite, opts);
+}
+
+void virtual_file_system::mount_archive(
+    path_view p,
+    std::span<const std::byte> data,
+    bool overwrite,
+    const archive_options& opts
+)
+{
+    std::shared_ptr ar = std::make_shared<zip_archive>();
+    ar->set_inflate_checkpoints(opts.checkpoint_interval, opts.checkpoint_memory_limit);
+    ar->open(data);
+
+    m_vfs_data->mount_archive(base_layer, p, std::move(ar), overwrite, opts.lazy);
+}
+
+void virtual_file_system::mount_archive(
+    path_view p,
+    std::vector<std::byte>&& data,
+    bool overwrite,
+    const archive_options& opts
+)
+{
+    std::shared_ptr ar = std::make_shared<zip_archive>();
+    ar->set_inflate_checkpoints(opts.checkpoint_interval, opts.checkpoint_memory_limit);
+    ar->open(std::move(data));
+
+    m_vfs_data->mount_archive(base_layer, p, std::move(ar), overwrite, opts.lazy);
+}
+
+void virtual_file_system::mount_nested_archive(
+    path_view p,
+    path_view archive_path,
+    bool overwrite,
+    const archive_options& opts
+)
+{
+    std::shared_ptr ar = std::make_shared<zip_archive>();
+    ar->set_inflate_checkpoints(opts.checkpoint_interval, opts.checkpoint_memory_limit);
+
+    // The archive does not refer to the node after opening, so the tree is only locked for reading the node
+    m_vfs_data->with_node(
+        archive_path,
+        [&](const detail::file_node* f)
+        {
+            if(!f)
+                throw error(vfs_err_msg(archive_path, " is not found"));
+            if(f->is_directory())
+                throw error(vfs_err_msg(archive_path, " is not a file"));
+
+            std::shared_ptr<const zip_archive> outer;
+            if(const auto* entry = f->get_if<file_data::archive_entry>())
+                outer = std::dynamic_pointer_cast<const zip_archive>(entry->get_archive());
+
+            if(outer)
+            {
+                ar->open_nested(std::move(outer), f->get_if<file_data::archive_entry>()->index());
+            }
+            else if(const auto* file = f->get_if<file_data::sys_file>())
+            {
+                ar->open(file->system_path(), opts.memory_map);
+            }
+            else
+            {
+                // Copy the content, since the file may be removed or overwritten later
+                std::string data = f->read_string(false);
+                auto bytes = std::as_bytes(std::span(data));
+                ar->open(std::vector<std::byte>(bytes.begin(), bytes.end()));
+            }
+        }
+    );
+
+    m_vfs_data->mount_archive(base_layer, p, std::move(ar), overwrite, opts.lazy);
+}
+
+void virtual_file_system::mount_archives(
+    std::span<const archive_source> archives,
+    bool overwrite,
+    const archive_options& opts,
+    unsigned int max_threads
+)
+{
+    if(archives.empty())
+        return;
+
+    std::vector<std::shared_ptr<zip_archive>> opened(archives.size());
+    std::vector<std::vector<detail::batch_entry>> batches(archives.size());
+    std::vector<std::exception_ptr> errors(archives.size());
+
+    // Errors are kept per archive, so the archives before a failed one can still be mounted
+    auto open_archive = [&](std::size_t i)
+    {
+        try
+        {
+            auto ar = std::make_shared<zip_archive>();
+            ar->set_inflate_checkpoints(opts.checkpoint_interval, opts.checkpoint_memory_limit);
+            ar->open(archives[i].sys_path, opts.memory_map);
+            if(!opts.lazy)
+                batches[i] = detail::archive_batch(archives[i].mount_point, *ar);
+            opened[i] = std::move(ar);
+        }
+        catch(...)
+        {
+            errors[i] = std::current_exception();
+        }
+    };
+
+    if(max_threads == 0)
+        max_threads = std::max(1u, std::thread::hardware_concurrency());
+    if(max_threads <= 1 || archives.size() == 1)
+    {
+        for(std::size_t i = 0; i < archives.size(); ++i)
+            open_archive(i);
+    }
+    else
+        detail::worker_pool::shared().parallel_for(archives.size(), max_threads - 1, open_archive);
+
+    // Merge in the original order, so the overwrite semantics are the same as mounting one by one
+    std::unique_lock lock(m_vfs_data->mutex);
+    for(std::size_t i = 0; i < archives.size(); ++i)
+    {
+        if(errors[i])
+            std::rethrow_exception(errors[i]);
+
+        m_vfs_data->mount_archive_locked(
+            base_layer,
+            archives[i].mount_point,
+            std::move(opened[i]),
+            std::move(batches[i]),
+            overwrite,
+            opts.lazy
+        );
+    }
+}
+
+void virtual_file_system::mount_pack(
+    path_view p,
+    const std::filesystem::path& sys_path,
+    bool overwrite,
+    unsigned int max_threads
+)
+{
+    std::shared_ptr ar = std::make_shared<pack_archive>();
+    ar->set_decode_threads(max_threads);
+    ar->open(sys_path);
+
+    const std::string base_key = detail::path_index::key_of(p);
+    std::vector<detail::batch_entry> entries;
+    entries.reserve(ar->entry_count());
+    for(std::size_t i = 0; i < ar->entry_count(); ++i)
+    {
+        entries.emplace_back(
+            base_key,
+            ar->entry_name(i),
+            detail::leaf_data(std::in_place_type<file_data::archive_entry>, *ar, i)
+        );
+    }
+
+    std::unique_lock lock(m_vfs_data->mutex);
+    m_vfs_data->mount_batch(base_layer, entries, overwrite);
+}
+
+void virtual_file_system::mount(mount_batch& batch, bool overwrite)
+{
+    mount(base_layer, batch, overwrite);
+}
+
+void virtual_file_system::mount(layer_id layer, mount_batch& batch, bool overwrite)
+{
+    std::unique_lock lock(m_vfs_data->mutex);
+    m_vfs_data->check_layer(layer);
+    m_vfs_data->mount_batch(layer, batch.m_data->entries, overwrite);
+    batch.m_data->entries.clear();
+}
+
+layer_id virtual_file_system::add_layer(int priority)
+{
+    std::unique_lock lock(m_vfs_data->mutex);
+    return m_vfs_data->layers.add(priority);
+}
+
+bool virtual_file_system::unmount_layer(layer_id layer)
+{
+    std::unique_lock lock(m_vfs_data->mutex);
+    ++m_vfs_data->generation;
+    return m_vfs_data->layers.unmount(m_vfs_data->tree, layer);
+}
+
+void virtual_file_system::mount_string(
+    layer_id layer, path_view p, std::string_view str, bool overwrite
+)
+{
+    std::unique_lock lock(m_vfs_data->mutex);
+    m_vfs_data->check_layer(layer);
+    m_vfs_data->mount(
+        layer,
         p,
         overwrite,
         std::in_place_type<file_data::string_constant>,
@@ -40,10 +496,11 @@ void virtual_file_system::mount_string(
 }
 
 void virtual_file_system::mount_string(
-    path_view p, const char* str, bool overwrite
+    layer_id layer, path_view p, const char* str, bool overwrite
 )
 {
     mount_string(
+        layer,
         p,
         std::string_view(str),
         overwrite
@@ -51,11 +508,13 @@ void virtual_file_system::mount_string(
 }
 
 void virtual_file_system::mount_string(
-    path_view p, std::string str, bool overwrite
+    layer_id layer, path_view p, std::string str, bool overwrite
 )
 {
-    mount_impl(
-        m_vfs_data->root,
+    std::unique_lock lock(m_vfs_data->mutex);
+    m_vfs_data->check_layer(layer);
+    m_vfs_data->mount(
+        layer,
         p,
         overwrite,
         std::in_place_type<file_data::string_constant>,
@@ -64,7 +523,7 @@ void virtual_file_system::mount_string(
 }
 
 void virtual_file_system::mount_file(
-    path_view p, const std::filesystem::path& sys_path, bool overwrite
+    layer_id layer, path_view p, const std::filesystem::path& sys_path, bool overwrite
 )
 {
     namespace stdfs = std::filesystem;
@@ -75,12 +534,16 @@ void virtual_file_system::mount_file(
     }
     else if(stdfs::is_regular_file(sys_path))
     {
-        mount_impl(
-            m_vfs_data->root,
+        stdfs::path abs_path = stdfs::absolute(sys_path);
+
+        std::unique_lock lock(m_vfs_data->mutex);
+        m_vfs_data->check_layer(layer);
+        m_vfs_data->mount(
+            layer,
             p,
             overwrite,
             std::in_place_type<file_data::sys_file>,
-            stdfs::absolute(sys_path)
+            std::move(abs_path)
         );
     }
     else
@@ -90,17 +553,473 @@ void virtual_file_system::mount_file(
 }
 
 void virtual_file_system::mount_dir(
-    path_view p, const std::filesystem::path& dir, bool overwrite
+    layer_id layer, path_view p, const std::filesystem::path& dir, bool overwrite
+)
+{
+    // Scan the directory before locking, so lookups are only blocked while the files are being inserted
+    mount_batch batch;
+    batch.add_dir(p, dir);
+
+    mount(layer, batch, overwrite);
+}
+
+void virtual_file_system::mount_archive(
+    layer_id layer,
+    path_view p,
+    const std::filesystem::path& sys_path,
+    bool overwrite,
+    const archive_options& opts
 )
+{
+    std::shared_ptr ar = std::make_shared<zip_archive>();
+    ar->set_inflate_checkpoints(opts.checkpoint_interval, opts.checkpoint_memory_limit);
+    ar->open(sys_path, opts.memory_map);
+
+    m_vfs_data->mount_archive(layer, p, std::move(ar), overwrite, opts.lazy);
+}
+
+void virtual_file_system::mount_dir(
+    layer_id layer,
+    path_view p,
+    const std::filesystem::path& dir,
+    mount_manifest& manifest,
+    bool overwrite
+)
+{
+    mount_batch batch;
+    batch.add_dir(p, dir, manifest);
+
+    mount(layer, batch, overwrite);
+}
+
+void virtual_file_system::mount_archive(
+    layer_id layer,
+    path_view p,
+    const std::filesystem::path& sys_path,
+    mount_manifest& manifest,
+    bool overwrite,
+    const archive_options& opts
+)
+{
+    std::shared_ptr ar = std::make_shared<zip_archive>();
+    ar->set_inflate_checkpoints(opts.checkpoint_interval, opts.checkpoint_memory_limit);
+    manifest.m_data->open_archive(*ar, sys_path, opts.memory_map);
+
+    m_vfs_data->mount_archive(layer, p, std::move(ar), overwrite, opts.lazy);
+}
+
+namespace detail
+{
+    static void collect_pack_sources(
+        std::vector<pack_source>& out,
+        std::vector<const file_node*>& nodes,
+        const std::string& prefix,
+        const file_node& dir
+    )
+    {
+        const auto& children = dir.get_directory()->children();
+        for(const auto* e : children.sorted())
+        {
+            std::string_view name = children.spelling(*e);
+            const file_node& child = *e->value();
+
+            std::string child_name = prefix;
+            if(!child_name.empty())
+                child_name += path_view::separator;
+            child_name += name;
+            if(child.is_directory())
+            {
+                collect_pack_sources(out, nodes, child_name, child);
+                continue;
+            }
+
+            const file_node* node = &child;
+            out.push_back({std::move(child_name), [node]()
+                           { return node->read_string(false); }});
+            nodes.push_back(node);
+        }
+    }
+} // namespace detail
+
+void virtual_file_system::write_pack(
+    path_view dir,
+    const std::filesystem::path& sys_path,
+    const pack_options& opts
+) const
+{
+    // Collecting the files materializes lazy directories, and the nodes are read until the pack is written
+    std::unique_lock lock(m_vfs_data->mutex);
+
+    const auto* d = find_impl(m_vfs_data->tree, dir);
+    if(!d)
+        throw error(vfs_err_msg(dir, " is not found"));
+    if(!d->is_directory())
+        throw error(vfs_err_msg(dir, " is not a directory"));
+
+    std::vector<pack_source> sources;
+    std::vector<const detail::file_node*> nodes;
+    detail::collect_pack_sources(sources, nodes, std::string(), *d);
+
+    if(!opts.access_order.empty())
+    {
+        std::unordered_map<const detail::file_node*, std::size_t> node_indices;
+        for(std::size_t i = 0; i < nodes.size(); ++i)
+            node_indices.emplace(nodes[i], i);
+
+        std::vector<pack_source> ordered;
+        ordered.reserve(sources.size());
+        std::vector<bool> used(sources.size(), false);
+        for(const auto& p : opts.access_order)
+        {
+            auto it = node_indices.find(find_impl(m_vfs_data->tree, p));
+            if(it == node_indices.end() || used[it->second])
+                continue;
+
+            ordered.push_back(std::move(sources[it->second]));
+            used[it->second] = true;
+        }
+        for(std::size_t i = 0; i < sources.size(); ++i)
+        {
+            if(!used[i])
+                ordered.push_back(std::move(sources[i]));
+        }
+
+        sources = std::move(ordered);
+    }
+
+    write_pack_file(sys_path, sources, opts);
+}
+
+bool virtual_file_system::exists(path_view p) const
+{
+    return m_vfs_data->with_node(
+        p,
+        [](const detail::file_node* f)
+        { return f != nullptr; }
+    );
+}
+
+bool virtual_file_system::is_directory(path_view p) const
+{
+    return m_vfs_data->with_node(
+        p,
+        [](const detail::file_node* f)
+        { return f && f->is_directory(); }
+    );
+}
+
+std::uint64_t virtual_file_system::file_size(path_view p) const
+{
+    return m_vfs_data->with_node(
+        p,
+        [&](const detail::file_node* f)
+        {
+            if(!f) [[unlikely]]
+                throw error(vfs_err_msg(p, " is not found"));
+
+            return f->file_size();
+        }
+    );
+}
+
+bool virtual_file_system::remove(path_view p)
+{
+    if(p.empty() || !p.is_absolute()) [[unlikely]]
+        return false;
+
+    std::unique_lock lock(m_vfs_data->mutex);
+    if(!remove_impl(m_vfs_data->tree, p))
+        return false;
+    ++m_vfs_data->generation;
+
+    // Hidden files of layers are removed along with the winners
+    m_vfs_data->layers.erase_under(m_vfs_data->tree.key_of(p));
+    return true;
+}
+
+ivfstream virtual_file_system::open(path_view p, std::ios_base::openmode mode)
+{
+    mode |= std::ios_base::in;
+    return m_vfs_data->with_node(
+        p,
+        [&](const detail::file_node* f)
+        {
+            if(!f)
+                throw error(vfs_err_msg(p, " is not found"));
+
+            return ivfstream(f->getbuf(mode));
+        }
+    );
+}
+
+std::string virtual_file_system::read_string(path_view p, bool convert_crlf)
+{
+    return m_vfs_data->with_node(
+        p,
+        [&](const detail::file_node* f)
+        {
+            if(!f)
+                throw error(vfs_err_msg(p, " is not found"));
+
+            return f->read_string(convert_crlf);
+        }
+    );
+}
+
+std::optional<std::span<const std::byte>> virtual_file_system::view_bytes(path_view p) const
+{
+    return m_vfs_data->with_node(
+        p,
+        [&](const detail::file_node* f)
+        {
+            if(!f)
+                throw error(vfs_err_msg(p, " is not found"));
+
+            return f->view_bytes();
+        }
+    );
+}
+
+/**
+ * @brief Path of a node in the original spellings of its names
+ *
+ * @param key Key of an indexed node
+ */
+static std::string spelled_path(const detail::file_tree& tree, std::string_view key)
+{
+    if(!tree.names.folds_case())
+        return std::string(key);
+
+    std::string result;
+    result.reserve(key.size());
+    const detail::file_node* current = &tree.root;
+    for(std::size_t start = 1; start < key.size();)
+    {
+        std::size_t end = std::min(key.find(path_view::separator, start), key.size());
+        std::string_view name = key.substr(start, end - start);
+        start = end + 1;
+
+        result += path_view::separator;
+        const auto* dir = current ? current->get_if<file_data::directory>() : nullptr;
+        const auto* e = dir ? dir->children().find_entry(name) : nullptr;
+        if(!e) [[unlikely]]
+        {
+            result += name;
+            current = nullptr;
+            continue;
+        }
+        result += dir->children().spelling(*e);
+        current = e->value();
+    }
+
+    return result;
+}
+
+std::vector<path> virtual_file_system::glob(const glob_pattern& pattern) const
+{
+    using state_set = glob_pattern::pattern_data::state_set;
+
+    const auto& tree = m_vfs_data->tree;
+    // Names of a case-insensitive tree are keyed by their folded forms
+    const auto& pat = tree.names.folds_case() ? pattern.m_data->folded() : *pattern.m_data;
+    std::vector<path> result;
+
+    // Placeholders of lazily mounted archives only exist after mounting an archive lazily,
+    // which makes the walk lock exclusively for materializing them
+    std::shared_lock shared(m_vfs_data->mutex);
+    std::unique_lock<std::shared_mutex> exclusive;
+    if(!tree.index.complete())
+    {
+        shared.unlock();
+        exclusive = std::unique_lock(m_vfs_data->mutex);
+    }
+
+    if(!pat.extension.empty() && tree.index.complete() && tree.index.indexes_extensions())
+    {
+        std::string prefix_key;
+        for(std::size_t i = 0; i < pat.prefix; ++i)
+        {
+            prefix_key += path_view::separator;
+            prefix_key += pat.segments[i].text;
+        }
+
+        const auto* bucket = tree.index.find_extension(pat.extension);
+        if(!bucket)
+            return result;
+        for(const auto& e : *bucket)
+        {
+            std::string_view key = e.key();
+            if(key.size() > prefix_key.size() &&
+               key.starts_with(prefix_key) &&
+               key[prefix_key.size()] == path_view::separator)
+            {
+                result.emplace_back(spelled_path(tree, key));
+            }
+        }
+
+        return result;
+    }
+
+    std::string buf;
+    auto walk = [&](auto& self, const detail::file_node& node, const state_set& states) -> void
+    {
+        const file_data::directory* dir = nullptr;
+        if(exclusive.owns_lock())
+            dir = node.get_directory();
+        else
+        {
+            assert(!node.get_if<file_data::archive_dir>());
+            dir = node.get_if<file_data::directory>();
+        }
+        if(!dir)
+            return;
+
+        const std::size_t dir_size = buf.size();
+        buf += path_view::separator;
+
+        state_set next;
+        auto visit = [&](const file_data::file_container::entry& e)
+        {
+            pat.step(states, e.key(), next);
+            if(next.empty())
+                return;
+
+            buf.resize(dir_size + 1);
+            buf += dir->children().spelling(e);
+            if(pat.accepts(next))
+                result.emplace_back(buf);
+            if(pat.can_descend(next))
+                self(self, *e.value(), next);
+        };
+
+        if(const std::string* name = pat.lookup_name(states))
+        {
+            if(const auto* e = dir->children().find_entry(*name))
+                visit(*e);
+        }
+        else
+        {
+            for(const auto& e : dir->children())
+                visit(e);
+        }
+
+        buf.resize(dir_size);
+    };
+    walk(walk, tree.root, pat.start());
+
+    return result;
+}
+
+std::vector<path> virtual_file_system::glob(std::string_view pattern) const
+{
+    return glob(glob_pattern(pattern));
+}
+
+void virtual_file_system::enable_extension_index(bool enable)
+{
+    std::unique_lock lock(m_vfs_data->mutex);
+    m_vfs_data->tree.index.index_extensions(enable);
+}
+
+std::size_t virtual_file_system::path_index_memory_usage() const noexcept
+{
+    std::shared_lock lock(m_vfs_data->mutex);
+    return m_vfs_data->tree.index.memory_usage();
+}
+
+bool virtual_file_system::case_insensitive() const noexcept
+{
+    return m_vfs_data->tree.names.folds_case();
+}
+
+std::pmr::memory_resource* virtual_file_system::get_memory_resource() const noexcept
+{
+    return m_vfs_data->tree.resource();
+}
+
+void virtual_file_system::list_files(std::ostream& os)
+{
+    // Listing materializes lazy directories
+    std::unique_lock lock(m_vfs_data->mutex);
+    list_files_impl(os, "/", m_vfs_data->tree.root, 0);
+}
+
+frozen_vfs virtual_file_system::freeze() const
+{
+    // Freezing materializes lazy directories
+    std::unique_lock lock(m_vfs_data->mutex);
+    return frozen_vfs(m_vfs_data->tree);
+}
+
+mount_batch::mount_batch()
+    : m_data(new batch_data()) {}
+
+mount_batch::mount_batch(mount_batch&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)) {}
+
+mount_batch::~mount_batch()
+{
+    delete m_data;
+}
+
+mount_batch& mount_batch::operator=(mount_batch&& rhs) noexcept
+{
+    if(this == &rhs) [[unlikely]]
+        return *this;
+
+    delete m_data;
+    m_data = std::exchange(rhs.m_data, nullptr);
+    return *this;
+}
+
+/**
+ * @brief Normalized form of a path that files of a batch are added to
+ */
+static std::string batch_base_key(path_view p)
+{
+    if(p.empty() || !p.is_absolute()) [[unlikely]]
+        throw virtual_file_system::error(vfs_err_msg(p, " is not an absolute path"));
+
+    return detail::path_index::key_of(p);
+}
+
+void mount_batch::add_string(path_view p, std::string str)
+{
+    m_data->entries.emplace_back(
+        batch_base_key(p),
+        detail::leaf_data(std::in_place_type<file_data::string_constant>, std::move(str))
+    );
+}
+
+void mount_batch::add_file(path_view p, const std::filesystem::path& sys_path)
+{
+    namespace stdfs = std::filesystem;
+
+    if(!stdfs::exists(sys_path))
+    {
+        throw virtual_file_system::error(stdfs_err_msg(sys_path, " does not exist"));
+    }
+    else if(!stdfs::is_regular_file(sys_path))
+    {
+        throw virtual_file_system::error(stdfs_err_msg({}, sys_path, " is not a regular file"));
+    }
+
+    m_data->entries.emplace_back(
+        batch_base_key(p),
+        detail::leaf_data(std::in_place_type<file_data::sys_file>, stdfs::absolute(sys_path))
+    );
+}
+
+void mount_batch::add_dir(path_view p, const std::filesystem::path& dir)
 {
     namespace stdfs = std::filesystem;
 
     if(!stdfs::is_directory(dir))
     {
-        throw error(stdfs_err_msg(dir, " is not a directory"));
+        throw virtual_file_system::error(stdfs_err_msg(dir, " is not a directory"));
     }
 
-    path base(p);
+    const std::string base_key = batch_base_key(p);
     for(auto& i : stdfs::recursive_directory_iterator(dir))
     {
         if(stdfs::is_directory(i))
@@ -108,134 +1027,347 @@ void virtual_file_system::mount_dir(
 
         stdfs::path file_path = stdfs::absolute(i);
         std::u8string filename = stdfs::relative(file_path, dir).generic_u8string();
-        mount_impl(
-            m_vfs_data->root,
-            base / std::string_view((const char*)filename.c_str(), filename.size()),
-            overwrite,
-            std::in_place_type<file_data::sys_file>,
-            file_path
+        m_data->entries.emplace_back(
+            base_key,
+            std::string_view((const char*)filename.c_str(), filename.size()),
+            detail::leaf_data(std::in_place_type<file_data::sys_file>, std::move(file_path))
         );
     }
 }
 
-void virtual_file_system::mount_archive(
-    path_view p, const std::filesystem::path& sys_path, bool overwrite
+void mount_batch::add_dir(path_view p, const std::filesystem::path& dir, mount_manifest& manifest)
+{
+    namespace stdfs = std::filesystem;
+
+    if(!stdfs::is_directory(dir))
+    {
+        throw virtual_file_system::error(stdfs_err_msg(dir, " is not a directory"));
+    }
+
+    const std::string base_key = batch_base_key(p);
+    const stdfs::path abs_dir = normalized_dir(dir);
+    const auto& rec = manifest.m_data->list_dir(abs_dir);
+
+    m_data->entries.reserve(m_data->entries.size() + rec.files.size());
+    for(std::size_t i = 0; i < rec.files.size(); ++i)
+    {
+        const std::string_view name = rec.files[i];
+        stdfs::path file_path = abs_dir / stdfs::path(
+            std::u8string_view(reinterpret_cast<const char8_t*>(name.data()), name.size())
+        );
+        file_path.make_preferred();
+        m_data->entries.emplace_back(
+            base_key,
+            name,
+            detail::leaf_data(std::in_place_type<file_data::sys_file>, std::move(file_path))
+        );
+    }
+}
+
+void mount_batch::add_archive(
+    path_view p,
+    const std::filesystem::path& sys_path,
+    const archive_options& opts
 )
 {
     std::shared_ptr ar = std::make_shared<zip_archive>();
-    ar->open(sys_path);
+    ar->set_inflate_checkpoints(opts.checkpoint_interval, opts.checkpoint_memory_limit);
+    ar->open(sys_path, opts.memory_map);
 
-    path base(p);
+    auto entries = detail::archive_batch(p, *ar);
+    m_data->entries.insert(
+        m_data->entries.end(),
+        std::make_move_iterator(entries.begin()),
+        std::make_move_iterator(entries.end())
+    );
+}
 
-    if(!ar->goto_first())
-        return; // Empty archive
-    do
-    {
-        if(ar->current_is_dir())
-            continue;
+void mount_batch::add_archive(
+    path_view p,
+    const std::filesystem::path& sys_path,
+    mount_manifest& manifest,
+    const archive_options& opts
+)
+{
+    std::shared_ptr ar = std::make_shared<zip_archive>();
+    ar->set_inflate_checkpoints(opts.checkpoint_interval, opts.checkpoint_memory_limit);
+    manifest.m_data->open_archive(*ar, sys_path, opts.memory_map);
 
-        auto entry = ar->open_current();
-        std::string_view filename = entry.filename();
+    auto entries = detail::archive_batch(p, *ar);
+    m_data->entries.insert(
+        m_data->entries.end(),
+        std::make_move_iterator(entries.begin()),
+        std::make_move_iterator(entries.end())
+    );
+}
 
-        mount_impl(
-            m_vfs_data->root,
-            base / filename,
-            overwrite,
-            std::in_place_type<file_data::archive_entry>,
-            *ar,
-            entry.offset()
-        );
-    } while(ar->goto_next());
+std::size_t mount_batch::size() const noexcept
+{
+    return m_data->entries.size();
 }
 
-bool virtual_file_system::exists(path_view p) const
+static file_kind kind_of(const detail::file_node& node) noexcept
 {
-    return find_impl(m_vfs_data->root, p) != nullptr;
+    return node.visit(
+        []<typename T>(const T&)
+        {
+            if constexpr(std::same_as<T, file_data::string_constant>)
+                return file_kind::string_constant;
+            else if constexpr(std::same_as<T, file_data::sys_file>)
+                return file_kind::sys_file;
+            else if constexpr(std::same_as<T, file_data::archive_entry>)
+                return file_kind::archive_entry;
+            else
+                return file_kind::directory;
+        }
+    );
 }
 
-bool virtual_file_system::is_directory(path_view p) const
+template <typename Fn>
+decltype(auto) directory_entry::with_node(Fn&& fn) const
 {
-    const auto* f = find_impl(m_vfs_data->root, p);
-    if(!f)
-        return false;
-    return f->is_directory();
+    const auto& data = *m_vfs->m_vfs_data;
+    return data.with_found(
+        [&](bool* blocked)
+        { return m_generation == data.generation ? m_node : data.find(path(), blocked); },
+        [&](const detail::file_node* f)
+        {
+            if(!f) [[unlikely]]
+                throw virtual_file_system::error(vfs_err_msg(path(), " is not found"));
+
+            return fn(*f);
+        }
+    );
 }
 
-std::uint64_t virtual_file_system::file_size(path_view p) const
+std::uint64_t directory_entry::file_size() const
+{
+    return with_node(
+        [](const detail::file_node& f)
+        { return f.file_size(); }
+    );
+}
+
+ivfstream directory_entry::open(std::ios_base::openmode mode) const
 {
-    const auto* f = find_impl(m_vfs_data->root, p);
-    if(!f) [[unlikely]]
-        throw error(vfs_err_msg(p, " is not found"));
+    if(is_directory())
+        throw virtual_file_system::error(vfs_err_msg(path(), " is not a file"));
 
-    return f->file_size();
+    return with_node(
+        [&](const detail::file_node& f)
+        { return ivfstream(f.getbuf(mode | std::ios_base::in)); }
+    );
 }
 
-bool virtual_file_system::remove(path_view p)
+std::string directory_entry::read_string(bool convert_crlf) const
 {
-    if(p.empty() || !p.is_absolute()) [[unlikely]]
-        return false;
-    if(p == "/"_pv)
+    if(is_directory())
+        throw virtual_file_system::error(vfs_err_msg(path(), " is not a file"));
+
+    return with_node(
+        [&](const detail::file_node& f)
+        { return f.read_string(convert_crlf); }
+    );
+}
+
+struct directory_iterator::iterator_data
+{
+    struct child
     {
-        auto* root_dir = m_vfs_data->root.get_if<file_data::directory>();
-        assert(root_dir);
+        // Position of the name in the buffer of the frame
+        std::size_t name_pos;
+        std::size_t name_size;
+        const detail::file_node* node;
+        file_kind kind;
+    };
 
-        root_dir->children().clear();
-        return true;
+    /**
+     * @brief Children of a directory listed when the iteration entered it
+     */
+    struct frame
+    {
+        std::string names;
+        std::vector<child> children;
+        std::size_t next = 0;
+        // Size of the path of the directory in the buffer, including the trailing separator
+        std::size_t path_size = 0;
+        // Generation of the VFS when the children were listed. Their nodes are valid while it is unchanged.
+        std::uint64_t generation = 0;
+    };
+
+    const virtual_file_system* vfs = nullptr;
+    std::vector<frame> stack;
+    std::string path;
+    directory_entry entry;
+    bool recursive = false;
+    // Descend into the current entry when incrementing
+    bool pending = false;
+
+    /**
+     * @brief Find a directory to be listed while the tree is locked
+     *
+     * @param blocked Same as the parameter of `vfs_data::find`. A placeholder of a lazily mounted archive
+     *                also blocks the lookup, since it is materialized for listing its children.
+     */
+    static const detail::file_node* find_dir(const detail::file_node* node, bool* blocked)
+    {
+        if(blocked && node && node->get_if<file_data::archive_dir>())
+        {
+            *blocked = true;
+            return nullptr;
+        }
+
+        return node;
     }
 
-    auto* parent = find_impl(m_vfs_data->root, p.parent_path());
-    if(!parent->is_directory())
-        return false;
+    /**
+     * @brief List the children of a directory, whose path is in the buffer. The tree must be locked.
+     */
+    void push(const file_data::directory& dir, std::uint64_t generation)
+    {
+        if(path.back() != path_view::separator)
+            path += path_view::separator;
 
-    std::string_view target_sv = [](path_view pv)
+        frame& f = stack.emplace_back();
+        f.path_size = path.size();
+        f.generation = generation;
+        f.children.reserve(dir.children().size());
+        for(const auto& e : dir.children())
+        {
+            const std::string_view name = dir.children().spelling(e);
+            f.children.push_back(child{f.names.size(), name.size(), e.value(), kind_of(*e.value())});
+            f.names += name;
+        }
+    }
+
+    /**
+     * @brief List the children of the current entry, which is skipped if it has been removed or replaced by a file
+     */
+    void descend()
     {
-        std::string_view result(pv);
-        if(result.back() == path_view::separator)
-            result.remove_suffix(1);
+        const auto& data = *vfs->m_vfs_data;
+        data.with_found(
+            [&](bool* blocked)
+            {
+                if(entry.m_generation == data.generation)
+                    return find_dir(entry.m_node, blocked);
+                return find_dir(data.find(path_view(path), blocked), blocked);
+            },
+            [&](const detail::file_node* f)
+            {
+                if(const auto* dir = f ? f->get_directory() : nullptr)
+                    push(*dir, data.generation);
+            }
+        );
+    }
+
+    /**
+     * @return False if the iteration reaches the end
+     */
+    bool advance()
+    {
+        if(pending)
+        {
+            pending = false;
+            descend();
+        }
+
+        while(!stack.empty())
+        {
+            frame& f = stack.back();
+            if(f.next == f.children.size())
+            {
+                stack.pop_back();
+                continue;
+            }
+
+            const child& c = f.children[f.next++];
+            const std::string_view name = std::string_view(f.names).substr(c.name_pos, c.name_size);
+            path.resize(f.path_size);
+            path += name;
 
-        std::size_t pos = result.rfind(path_view::separator);
-        if(pos == std::string_view::npos)
-            pos = 0;
-        return result.substr(pos + 1);
-    }(p);
+            entry.m_node = c.node;
+            entry.m_generation = f.generation;
+            entry.m_name = name;
+            entry.m_path = path;
+            entry.m_kind = c.kind;
+            pending = recursive && entry.m_kind == file_kind::directory;
+            return true;
+        }
 
-    auto* parent_dir = parent->get_if<file_data::directory>();
-    auto it = parent_dir->children().find(path_view(target_sv));
-    if(it == parent_dir->children().end())
         return false;
+    }
+};
 
-    parent_dir->children().erase(it);
-    return true;
+directory_iterator::directory_iterator(const virtual_file_system& vfs, path_view dir, bool recursive)
+{
+    const auto& vfs_data = *vfs.m_vfs_data;
+    auto data = std::make_shared<iterator_data>();
+    data->vfs = &vfs;
+    data->recursive = recursive;
+    data->entry.m_vfs = &vfs;
+
+    vfs_data.with_found(
+        [&](bool* blocked)
+        { return iterator_data::find_dir(vfs_data.find(dir, blocked), blocked); },
+        [&](const detail::file_node* f)
+        {
+            if(!f)
+                throw virtual_file_system::error(vfs_err_msg(dir, " is not found"));
+            const auto* d = f->get_directory();
+            if(!d)
+                throw virtual_file_system::error(vfs_err_msg(dir, " is not a directory"));
+
+            data->path = spelled_path(vfs_data.tree, vfs_data.tree.key_of(dir));
+            data->push(*d, vfs_data.generation);
+        }
+    );
+
+    if(data->advance())
+        m_data = std::move(data);
 }
 
-ivfstream virtual_file_system::open(path_view p, std::ios_base::openmode mode)
+const directory_entry& directory_iterator::operator*() const noexcept
 {
-    const auto* f = find_impl(m_vfs_data->root, p);
-    if(!f)
-        throw error(vfs_err_msg(p, " is not found"));
-
-    mode |= std::ios_base::in;
-    return ivfstream(f->getbuf(mode));
+    assert(m_data);
+    return m_data->entry;
 }
 
-std::string virtual_file_system::read_string(path_view p, bool convert_crlf)
+directory_iterator& directory_iterator::operator++()
 {
-    const auto* f = find_impl(m_vfs_data->root, p);
-    if(!f)
-        throw error(vfs_err_msg(p, " is not found"));
+    assert(m_data);
+    if(!m_data->advance())
+        m_data.reset();
+    return *this;
+}
 
-    return f->read_string(convert_crlf);
+std::size_t directory_iterator::depth() const noexcept
+{
+    assert(m_data && !m_data->stack.empty());
+    return m_data->stack.size() - 1;
 }
 
-void virtual_file_system::list_files(std::ostream& os)
+void directory_iterator::disable_recursion_pending() noexcept
 {
-    list_files_impl(os, "/", m_vfs_data->root, 0);
+    assert(m_data);
+    m_data->pending = false;
 }
 
 access_context::access_context(access_context&& other) noexcept
-    : m_vfs(other.m_vfs), m_current(std::move(other.m_current)) {}
+    : m_vfs(other.m_vfs),
+      m_current(std::move(other.m_current)),
+      m_dir(other.m_dir.load(std::memory_order_relaxed)),
+      m_generation(other.m_generation.exchange(0, std::memory_order_relaxed)) {}
 
-access_context::access_context(const access_context&) = default;
+access_context::access_context(const access_context& other)
+    : m_vfs(other.m_vfs),
+      m_current(other.m_current)
+{
+    // A node newer than the generation is only refreshed again, because the generation does not match the VFS
+    const std::uint64_t generation = other.m_generation.load(std::memory_order_acquire);
+    m_dir.store(other.m_dir.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_generation.store(generation, std::memory_order_relaxed);
+}
 
 access_context::access_context(virtual_file_system& vfs)
     : m_vfs(&vfs), m_current("/") {}
@@ -244,6 +1376,7 @@ void access_context::current_path(path_view pv)
 {
     m_current /= pv;
     m_current = m_current.lexically_normal();
+    m_generation.store(0, std::memory_order_relaxed);
 }
 
 path access_context::to_fullpath(path_view pv) const
@@ -252,4 +1385,143 @@ path access_context::to_fullpath(path_view pv) const
 
     return result.lexically_normal();
 }
+
+/**
+ * @brief Check if a path can be looked up from the current directory, i.e. it is relative and does not go up after a name
+ */
+static bool is_forward_relative(path_view p)
+{
+    if(p.empty())
+        return true;
+    if(p.is_absolute())
+        return false;
+
+    bool named = false;
+    for(path_view subview : p)
+    {
+        const std::string_view name(subview);
+        if(name == "..")
+        {
+            if(named)
+                return false;
+        }
+        else if(name != ".")
+            named = true;
+    }
+
+    return true;
+}
+
+const detail::file_node* access_context::find_node(path_view p, bool* blocked) const
+{
+    const auto& data = *m_vfs->m_vfs_data;
+    if(is_forward_relative(p)) [[likely]]
+    {
+        // The generation only changes under the exclusive lock,
+        // so threads refreshing the cache at the same time store the same node
+        const detail::file_node* dir = nullptr;
+        if(m_generation.load(std::memory_order_acquire) == data.generation) [[likely]]
+            dir = m_dir.load(std::memory_order_relaxed);
+        else
+        {
+            dir = data.find(m_current, blocked);
+            if(blocked && *blocked)
+                return nullptr;
+
+            m_dir.store(dir, std::memory_order_relaxed);
+            m_generation.store(data.generation, std::memory_order_release);
+        }
+
+        // A missing current directory can still be left by "..", which is resolved by the full path below
+        if(dir) [[likely]]
+            return find_relative_impl(*dir, p, blocked);
+    }
+
+    return data.find(to_fullpath(p), blocked);
+}
+
+template <typename Fn>
+decltype(auto) access_context::with_node(path_view p, Fn&& fn) const
+{
+    return m_vfs->m_vfs_data->with_found(
+        [&](bool* blocked)
+        { return find_node(p, blocked); },
+        std::forward<Fn>(fn)
+    );
+}
+
+bool access_context::exists(path_view p) const
+{
+    return with_node(
+        p,
+        [](const detail::file_node* f)
+        { return f != nullptr; }
+    );
+}
+
+bool access_context::is_directory(path_view p) const
+{
+    return with_node(
+        p,
+        [](const detail::file_node* f)
+        { return f && f->is_directory(); }
+    );
+}
+
+std::uint64_t access_context::file_size(path_view p) const
+{
+    return with_node(
+        p,
+        [&](const detail::file_node* f)
+        {
+            if(!f) [[unlikely]]
+                throw virtual_file_system::error(vfs_err_msg(to_fullpath(p), " is not found"));
+
+            return f->file_size();
+        }
+    );
+}
+
+ivfstream access_context::open(path_view p, std::ios_base::openmode mode) const
+{
+    mode |= std::ios_base::in;
+    return with_node(
+        p,
+        [&](const detail::file_node* f)
+        {
+            if(!f)
+                throw virtual_file_system::error(vfs_err_msg(to_fullpath(p), " is not found"));
+
+            return ivfstream(f->getbuf(mode));
+        }
+    );
+}
+
+std::string access_context::read_string(path_view p, bool convert_crlf)
+{
+    return with_node(
+        p,
+        [&](const detail::file_node* f)
+        {
+            if(!f)
+                throw virtual_file_system::error(vfs_err_msg(to_fullpath(p), " is not found"));
+
+            return f->read_string(convert_crlf);
+        }
+    );
+}
+
+std::optional<std::span<const std::byte>> access_context::view_bytes(path_view p) const
+{
+    return with_node(
+        p,
+        [&](const detail::file_node* f)
+        {
+            if(!f)
+                throw virtual_file_system::error(vfs_err_msg(to_fullpath(p), " is not found"));
+
+            return f->view_bytes();
+        }
+    );
+}
 } // namespace lochfolk
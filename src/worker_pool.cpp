@@ -0,0 +1,124 @@
+#include "worker_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace lochfolk::detail
+{
+worker_pool::worker_pool(unsigned int thread_count)
+{
+    m_threads.reserve(thread_count);
+    for(unsigned int i = 0; i < thread_count; ++i)
+        m_threads.emplace_back([this]() { run(); });
+}
+
+worker_pool::~worker_pool()
+{
+    {
+        std::lock_guard lock(m_mut);
+        m_stopping = true;
+    }
+    m_cond.notify_all();
+
+    for(auto& t : m_threads)
+        t.join();
+}
+
+worker_pool& worker_pool::shared()
+{
+    static worker_pool pool(std::max(2u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+void worker_pool::parallel_for(std::size_t count, std::size_t max_helpers, const std::function<void(std::size_t)>& fn)
+{
+    struct range_state
+    {
+        std::size_t count;
+        const std::function<void(std::size_t)>* fn;
+        std::atomic_size_t next = 0;
+        std::atomic_bool failed = false;
+
+        std::mutex mut;
+        std::condition_variable cond;
+        std::size_t done = 0;
+        std::exception_ptr error;
+
+        /**
+         * @brief Run the indices left. The function is only called for claimed indices, which the caller waits for.
+         */
+        void work()
+        {
+            for(std::size_t i = next++; i < count; i = next++)
+            {
+                std::exception_ptr e;
+                if(!failed)
+                {
+                    try
+                    {
+                        (*fn)(i);
+                    }
+                    catch(...)
+                    {
+                        e = std::current_exception();
+                        failed = true;
+                    }
+                }
+
+                std::lock_guard lock(mut);
+                if(e && !error)
+                    error = std::move(e);
+                if(++done == count)
+                    cond.notify_all();
+            }
+        }
+    };
+
+    if(count == 0)
+        return;
+
+    // Shared with the helpers, which may start after the caller has returned
+    auto state = std::make_shared<range_state>();
+    state->count = count;
+    state->fn = &fn;
+
+    const std::size_t helpers = std::min({max_helpers, size(), count - 1});
+    for(std::size_t i = 0; i < helpers; ++i)
+        post([state]() { state->work(); });
+    state->work();
+
+    std::unique_lock lock(state->mut);
+    state->cond.wait(lock, [&]() { return state->done == count; });
+    if(state->error)
+        std::rethrow_exception(state->error);
+}
+
+void worker_pool::post(std::function<void()> task)
+{
+    {
+        std::lock_guard lock(m_mut);
+        m_tasks.push_back(std::move(task));
+    }
+    m_cond.notify_one();
+}
+
+void worker_pool::run()
+{
+    while(true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(m_mut);
+            m_cond.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+            if(m_tasks.empty())
+                return;
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        task();
+    }
+}
+} // namespace lochfolk::detail
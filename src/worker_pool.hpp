@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lochfolk::detail
+{
+/**
+ * @brief Fixed set of worker threads shared by parallel reads
+ *
+ * Reads hand their work to the workers through a queue instead of starting threads,
+ * so the number of threads does not grow with the number of concurrent reads.
+ */
+class worker_pool
+{
+public:
+    explicit worker_pool(unsigned int thread_count);
+
+    worker_pool(const worker_pool&) = delete;
+
+    ~worker_pool();
+
+    /**
+     * @brief Pool of the process with one worker less than the number of hardware threads (at least one),
+     *        since callers work too
+     */
+    [[nodiscard]]
+    static worker_pool& shared();
+
+    [[nodiscard]]
+    std::size_t size() const noexcept
+    {
+        return m_threads.size();
+    }
+
+    /**
+     * @brief Call a function with every index of a range on the calling thread and up to `max_helpers` workers
+     *
+     * Returns when all indices are done. Workers that are busy with other work do not delay the caller,
+     * because the indices are claimed from a shared counter and the caller claims the rest.
+     * After a call throws, the remaining indices are skipped.
+     *
+     * @exception Any The first exception thrown by the function
+     */
+    void parallel_for(std::size_t count, std::size_t max_helpers, const std::function<void(std::size_t)>& fn);
+
+private:
+    void post(std::function<void()> task);
+
+    void run();
+
+    std::mutex m_mut;
+    std::condition_variable m_cond;
+    std::deque<std::function<void()>> m_tasks;
+    bool m_stopping = false;
+    std::vector<std::thread> m_threads;
+};
+} // namespace lochfolk::detail
@@ -1,5 +1,58 @@
 #include <gtest/gtest.h>
 #include <lochfolk/vfs.hpp>
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <memory_resource>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "zip_writer.hpp"
+
+namespace
+{
+using lochfolk_test::write_zip;
+
+std::vector<std::byte> read_sys_file(const std::filesystem::path& sys_path)
+{
+    std::ifstream ifs(sys_path, std::ios_base::binary);
+    std::vector<char> buf(
+        (std::istreambuf_iterator<char>(ifs)),
+        std::istreambuf_iterator<char>()
+    );
+
+    auto bytes = std::as_bytes(std::span(buf));
+    return std::vector<std::byte>(bytes.begin(), bytes.end());
+}
+
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+    std::size_t allocated = 0;
+    std::size_t deallocated = 0;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        allocated += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        deallocated += bytes;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+} // namespace
 
 TEST(vfs, mount_string_constant)
 {
@@ -36,6 +89,12 @@ TEST(vfs, mount_string_constant)
         EXPECT_EQ(str, "123 456");
     }
 
+    {
+        auto view = vfs.view_bytes("/data/text/example.txt"_pv);
+        ASSERT_TRUE(view.has_value());
+        EXPECT_EQ(view->size(), 7);
+    }
+
     vfs.mount_string("/data/text/example.txt"_pv, std::string("1013"));
     EXPECT_TRUE(vfs.exists("/data/text/example.txt"_pv));
     EXPECT_FALSE(vfs.is_directory("/data/text/example.txt"_pv));
@@ -118,6 +177,8 @@ TEST(vfs, mount_sys_file)
         EXPECT_EQ(str, "1013\n");
     }
 
+    EXPECT_FALSE(vfs.view_bytes("/text/example.txt"_pv).has_value());
+
     EXPECT_TRUE(vfs.remove("/text/example.txt"_pv));
     EXPECT_FALSE(vfs.exists("/text/example.txt"_pv));
     // Won't remove the actual system file
@@ -169,6 +230,156 @@ TEST(vfs, mount_sys_dir)
     }
 }
 
+TEST(vfs, large_directory)
+{
+    using namespace lochfolk::vfs_literals;
+
+    constexpr int count = 1000;
+
+    lochfolk::virtual_file_system vfs;
+    for(int i = count - 1; i >= 0; --i)
+        vfs.mount_string(lochfolk::path("/large") / std::to_string(i), std::to_string(i));
+
+    for(int i = 0; i < count; i += 3)
+        EXPECT_TRUE(vfs.remove(lochfolk::path("/large") / std::to_string(i)));
+    EXPECT_FALSE(vfs.remove("/large/0"_pv));
+
+    for(int i = 0; i < count; ++i)
+    {
+        lochfolk::path p = lochfolk::path("/large") / std::to_string(i);
+        if(i % 3 == 0)
+        {
+            EXPECT_FALSE(vfs.exists(p));
+        }
+        else
+        {
+            ASSERT_TRUE(vfs.exists(p));
+            EXPECT_EQ(vfs.read_string(p), std::to_string(i));
+        }
+    }
+
+    // Listing is ordered by name
+    std::stringstream ss;
+    vfs.list_files(ss);
+    std::vector<std::string> names;
+    for(std::string line; std::getline(ss, line);)
+    {
+        if(line.starts_with("    - "))
+            names.push_back(line.substr(6));
+    }
+    EXPECT_EQ(names.size(), static_cast<std::size_t>(count - (count + 2) / 3));
+    EXPECT_TRUE(std::ranges::is_sorted(names));
+}
+
+TEST(vfs, shrunk_directory)
+{
+    using namespace lochfolk::vfs_literals;
+
+    lochfolk::virtual_file_system vfs;
+    for(int i = 0; i < 16; ++i)
+        vfs.mount_string(lochfolk::path("/dir") / std::to_string(i), std::to_string(i));
+
+    // Shrinking below the size of linearly scanned directories
+    for(int i = 0; i < 12; ++i)
+        EXPECT_TRUE(vfs.remove(lochfolk::path("/dir") / std::to_string(i)));
+
+    vfs.mount_string("/dir/new"_pv, "new");
+    ASSERT_TRUE(vfs.exists("/dir/new"_pv));
+    EXPECT_EQ(vfs.read_string("/dir/new"_pv), "new");
+    for(int i = 12; i < 16; ++i)
+        EXPECT_EQ(vfs.read_string(lochfolk::path("/dir") / std::to_string(i)), std::to_string(i));
+
+    // Mounting the same name again overwrites the child instead of adding another one
+    vfs.mount_string("/dir/new"_pv, "overwritten");
+    EXPECT_EQ(vfs.read_string("/dir/new"_pv), "overwritten");
+    EXPECT_TRUE(vfs.remove("/dir/new"_pv));
+    EXPECT_FALSE(vfs.exists("/dir/new"_pv));
+}
+
+TEST(vfs, path_index)
+{
+    using namespace lochfolk::vfs_literals;
+
+    lochfolk::virtual_file_system vfs;
+    vfs.mount_string("/a/b/c.txt"_pv, "C");
+    vfs.mount_string("/a/b/d/e.txt"_pv, "E");
+
+    // Paths not in the normalized form are resolved by walking the tree
+    EXPECT_EQ(vfs.read_string("/a//b/c.txt"_pv), "C");
+    EXPECT_TRUE(vfs.is_directory("/a/b/"_pv));
+    EXPECT_TRUE(vfs.is_directory("/"_pv));
+    EXPECT_FALSE(vfs.exists("/a/b/x.txt"_pv));
+    EXPECT_FALSE(vfs.exists("a/b/c.txt"_pv));
+
+    // Replacing a directory by a file removes its descendants
+    vfs.mount_string("/a/b"_pv, "B");
+    EXPECT_EQ(vfs.read_string("/a/b"_pv), "B");
+    EXPECT_FALSE(vfs.exists("/a/b/c.txt"_pv));
+    EXPECT_FALSE(vfs.exists("/a/b/d/e.txt"_pv));
+
+    EXPECT_TRUE(vfs.remove("/a/b"_pv));
+    EXPECT_FALSE(vfs.exists("/a/b"_pv));
+    vfs.mount_string("/a/b/d/e.txt"_pv, "E2");
+    EXPECT_EQ(vfs.read_string("/a/b/d/e.txt"_pv), "E2");
+
+    EXPECT_TRUE(vfs.remove("/a/"_pv));
+    EXPECT_FALSE(vfs.exists("/a/b/d/e.txt"_pv));
+    EXPECT_FALSE(vfs.exists("/a"_pv));
+
+    // Files of a lazily mounted archive are found without being indexed
+    vfs.mount_archive("/lazy"_pv, "test_vfs_data/ar.zip", true, {.lazy = true});
+    EXPECT_EQ(vfs.read_string("/lazy/info.txt"_pv), "archive\n");
+    EXPECT_TRUE(vfs.exists("/lazy/data/value.txt"_pv));
+    vfs.mount_string("/lazy/data/extra.txt"_pv, "X");
+    EXPECT_TRUE(vfs.remove("/lazy/data"_pv));
+    EXPECT_FALSE(vfs.exists("/lazy/data/extra.txt"_pv));
+    EXPECT_FALSE(vfs.exists("/lazy/data/value.txt"_pv));
+
+    EXPECT_TRUE(vfs.remove("/"_pv));
+    EXPECT_FALSE(vfs.exists("/lazy"_pv));
+    EXPECT_TRUE(vfs.is_directory("/"_pv));
+    vfs.mount_string("/new.txt"_pv, "N");
+    EXPECT_EQ(vfs.read_string("/new.txt"_pv), "N");
+}
+
+TEST(vfs, memory_resource)
+{
+    using namespace lochfolk::vfs_literals;
+
+    counting_resource res;
+    {
+        lochfolk::virtual_file_system vfs(&res);
+        EXPECT_EQ(vfs.get_memory_resource(), &res);
+        const std::size_t initial = res.allocated;
+        EXPECT_GT(initial, 0);
+
+        for(int i = 0; i < 100; ++i)
+            vfs.mount_string(lochfolk::path("/dir/a_long_name_of_file_" + std::to_string(i) + ".txt"), "text");
+        vfs.mount_archive("/lazy"_pv, "test_vfs_data/ar.zip", true, {.lazy = true});
+        EXPECT_GT(res.allocated, initial);
+
+        // Materializing a lazily mounted archive allocates from the resource, too
+        const std::size_t mounted = res.allocated;
+        EXPECT_EQ(vfs.read_string("/lazy/info.txt"_pv), "archive\n");
+        EXPECT_TRUE(vfs.exists("/lazy/data/value.txt"_pv));
+        EXPECT_GT(res.allocated, mounted);
+
+        EXPECT_TRUE(vfs.remove("/dir"_pv));
+        EXPECT_FALSE(vfs.exists("/dir/a_long_name_of_file_0.txt"_pv));
+        EXPECT_GT(res.deallocated, 0);
+    }
+    EXPECT_EQ(res.allocated, res.deallocated);
+
+    // Nothing is freed back to a monotonic resource until the whole buffer is released
+    std::pmr::monotonic_buffer_resource arena;
+    {
+        lochfolk::virtual_file_system vfs(&arena);
+        vfs.mount_string("/a/b/c.txt"_pv, "C");
+        EXPECT_EQ(vfs.read_string("/a/b/c.txt"_pv), "C");
+    }
+    arena.release();
+}
+
 TEST(vfs, mount_zip_archive)
 {
     using namespace lochfolk::vfs_literals;
@@ -179,6 +390,8 @@ TEST(vfs, mount_zip_archive)
     vfs.list_files(std::cerr);
 
     EXPECT_TRUE(vfs.is_directory("/archive"_pv));
+    EXPECT_TRUE(vfs.is_directory("/archive/data"_pv));
+    EXPECT_EQ(vfs.file_size("/archive/info.txt"_pv), 8);
 
     {
         auto vfss = vfs.open("/archive/info.txt"_pv);
@@ -204,6 +417,30 @@ TEST(vfs, mount_zip_archive)
         EXPECT_EQ(v2, 182376);
     }
 
+    {
+        auto vfss = vfs.open("/archive/data/value.txt"_pv);
+
+        int v1 = 0, v2 = 0;
+        vfss >> v1;
+        EXPECT_EQ(v1, 182375);
+
+        // Seeking backward restarts the decompression
+        vfss.seekg(0, std::ios_base::beg);
+        vfss >> v1 >> v2;
+        EXPECT_EQ(v1, 182375);
+        EXPECT_EQ(v2, 182376);
+
+        vfss.seekg(0, std::ios_base::end);
+        EXPECT_EQ(
+            static_cast<std::uint64_t>(vfss.tellg()),
+            vfs.file_size("/archive/data/value.txt"_pv)
+        );
+
+        vfss.seekg(7, std::ios_base::beg);
+        vfss >> v2;
+        EXPECT_EQ(v2, 182376);
+    }
+
     EXPECT_TRUE(vfs.exists("/archive/info.txt"_pv));
     EXPECT_TRUE(vfs.exists("/archive/data/value.txt"_pv));
     EXPECT_TRUE(vfs.remove("/archive"_pv));
@@ -211,6 +448,1312 @@ TEST(vfs, mount_zip_archive)
     EXPECT_FALSE(vfs.exists("/archive/data/value.txt"_pv));
 }
 
+TEST(vfs, mount_zip_archive_memory_map)
+{
+    using namespace lochfolk::vfs_literals;
+
+    const std::pair<std::string, std::string> entries[] = {
+        {"stored.txt", "182375 182376"},
+        {"dir/empty.txt", ""}
+    };
+    write_zip("test_vfs_data/stored.zip", entries, MZ_COMPRESS_METHOD_STORE);
+
+    lochfolk::virtual_file_system vfs;
+
+    vfs.mount_archive("/stored"_pv, "test_vfs_data/stored.zip", true, {.memory_map = true});
+    vfs.mount_archive("/deflated"_pv, "test_vfs_data/ar.zip", true, {.memory_map = true});
+    vfs.list_files(std::cerr);
+
+    {
+        auto view = vfs.view_bytes("/stored/stored.txt"_pv);
+        ASSERT_TRUE(view.has_value());
+        EXPECT_EQ(
+            std::string_view(reinterpret_cast<const char*>(view->data()), view->size()),
+            "182375 182376"
+        );
+    }
+
+    {
+        auto view = vfs.view_bytes("/stored/dir/empty.txt"_pv);
+        ASSERT_TRUE(view.has_value());
+        EXPECT_TRUE(view->empty());
+    }
+
+    // Compressed entries cannot be viewed directly
+    EXPECT_FALSE(vfs.view_bytes("/deflated/info.txt"_pv).has_value());
+    EXPECT_EQ(vfs.read_string("/deflated/info.txt"_pv), "archive\n");
+
+    {
+        auto vfss = vfs.open("/stored/stored.txt"_pv);
+
+        // Remove the node while the stream is still in use
+        EXPECT_TRUE(vfs.remove("/stored"_pv));
+
+        int v1 = 0, v2 = 0;
+        vfss >> v1;
+        EXPECT_EQ(v1, 182375);
+
+        vfss.seekg(0, std::ios_base::end);
+        EXPECT_EQ(vfss.tellg(), 13);
+        vfss.seekg(7, std::ios_base::beg);
+        vfss >> v2;
+        EXPECT_EQ(v2, 182376);
+    }
+}
+
+TEST(vfs, mount_zip_archive_memory)
+{
+    using namespace lochfolk::vfs_literals;
+
+    const std::pair<std::string, std::string> entries[] = {
+        {"stored.txt", "182375 182376"}
+    };
+    write_zip("test_vfs_data/stored_mem.zip", entries, MZ_COMPRESS_METHOD_STORE);
+
+    const std::vector<std::byte> ar_data = read_sys_file("test_vfs_data/ar.zip");
+    ASSERT_FALSE(ar_data.empty());
+
+    lochfolk::virtual_file_system vfs;
+
+    vfs.mount_archive("/archive"_pv, std::span(ar_data));
+    vfs.mount_archive("/stored"_pv, read_sys_file("test_vfs_data/stored_mem.zip"));
+    vfs.list_files(std::cerr);
+
+    EXPECT_TRUE(vfs.is_directory("/archive/data"_pv));
+    EXPECT_EQ(vfs.file_size("/archive/info.txt"_pv), 8);
+    EXPECT_EQ(vfs.read_string("/archive/info.txt"_pv), "archive\n");
+
+    {
+        auto vfss = vfs.open("/archive/data/value.txt"_pv);
+
+        int v1 = 0, v2 = 0;
+        vfss >> v1 >> v2;
+        EXPECT_EQ(v1, 182375);
+        EXPECT_EQ(v2, 182376);
+    }
+
+    // Stored entries of archives in memory are viewed directly
+    {
+        auto view = vfs.view_bytes("/stored/stored.txt"_pv);
+        ASSERT_TRUE(view.has_value());
+        EXPECT_EQ(
+            std::string_view(reinterpret_cast<const char*>(view->data()), view->size()),
+            "182375 182376"
+        );
+    }
+
+    {
+        auto vfss = vfs.open("/stored/stored.txt"_pv);
+
+        int v1 = 0, v2 = 0;
+        vfss >> v1 >> v2;
+        EXPECT_EQ(v1, 182375);
+        EXPECT_EQ(v2, 182376);
+    }
+
+    // An lvalue vector is viewed rather than copied
+    const std::vector<std::byte> stored_data = read_sys_file("test_vfs_data/stored_mem.zip");
+    vfs.mount_archive("/stored_view"_pv, stored_data);
+    {
+        auto view = vfs.view_bytes("/stored_view/stored.txt"_pv);
+        ASSERT_TRUE(view.has_value());
+        EXPECT_GE(view->data(), stored_data.data());
+        EXPECT_LE(view->data() + view->size(), stored_data.data() + stored_data.size());
+    }
+
+    const std::byte bad_data[] = {std::byte('P'), std::byte('K')};
+    EXPECT_ANY_THROW(vfs.mount_archive("/bad"_pv, std::span(bad_data)));
+}
+
+TEST(vfs, mount_zip_archive_lazy)
+{
+    using namespace lochfolk::vfs_literals;
+
+    lochfolk::virtual_file_system vfs;
+
+    vfs.mount_archive("/archive"_pv, "test_vfs_data/ar.zip", true, {.lazy = true});
+
+    EXPECT_TRUE(vfs.is_directory("/archive"_pv));
+    EXPECT_TRUE(vfs.is_directory("/archive/data"_pv));
+    EXPECT_FALSE(vfs.exists("/archive/not_found.txt"_pv));
+    EXPECT_EQ(vfs.file_size("/archive/info.txt"_pv), 8);
+    EXPECT_EQ(vfs.read_string("/archive/info.txt"_pv), "archive\n");
+
+    {
+        auto vfss = vfs.open("/archive/data/value.txt"_pv);
+
+        int v1 = 0, v2 = 0;
+        vfss >> v1 >> v2;
+        EXPECT_EQ(v1, 182375);
+        EXPECT_EQ(v2, 182376);
+    }
+
+    // Mount files into a directory that has not been materialized yet
+    vfs.mount_archive("/lazy"_pv, "test_vfs_data/ar.zip", true, {.lazy = true});
+    vfs.mount_string("/lazy/data/extra.txt"_pv, "extra");
+    EXPECT_EQ(vfs.read_string("/lazy/data/extra.txt"_pv), "extra");
+    EXPECT_TRUE(vfs.exists("/lazy/data/value.txt"_pv));
+
+    // Merge into an existing directory without overwriting
+    vfs.mount_string("/merged/info.txt"_pv, "old");
+    vfs.mount_string("/merged/data/old.txt"_pv, "old");
+    vfs.mount_archive("/merged"_pv, "test_vfs_data/ar.zip", false, {.lazy = true});
+    vfs.list_files(std::cerr);
+
+    EXPECT_EQ(vfs.read_string("/merged/info.txt"_pv), "old");
+    EXPECT_EQ(vfs.read_string("/merged/data/old.txt"_pv), "old");
+    EXPECT_EQ(vfs.read_string("/merged/data/value.txt"_pv), "182375 182376\n");
+
+    vfs.mount_string("/file"_pv, "file");
+    EXPECT_THROW(
+        vfs.mount_archive("/file"_pv, "test_vfs_data/ar.zip", true, {.lazy = true}),
+        lochfolk::virtual_file_system::error
+    );
+
+    EXPECT_TRUE(vfs.remove("/archive/data/value.txt"_pv));
+    EXPECT_FALSE(vfs.exists("/archive/data/value.txt"_pv));
+    EXPECT_TRUE(vfs.remove("/archive"_pv));
+    EXPECT_FALSE(vfs.exists("/archive/info.txt"_pv));
+}
+
+TEST(vfs, mount_zip_archives)
+{
+    using namespace lochfolk::vfs_literals;
+
+    const std::pair<std::string, std::string> first[] = {
+        {"a.txt", "first"},
+        {"first.txt", "first"}
+    };
+    const std::pair<std::string, std::string> second[] = {
+        {"a.txt", "second"}
+    };
+    write_zip("test_vfs_data/batch_1.zip", first, MZ_COMPRESS_METHOD_DEFLATE);
+    write_zip("test_vfs_data/batch_2.zip", second, MZ_COMPRESS_METHOD_DEFLATE);
+
+    const lochfolk::archive_source sources[] = {
+        {"/batch"_pv, "test_vfs_data/batch_1.zip"},
+        {"/archive"_pv, "test_vfs_data/ar.zip"},
+        {"/batch"_pv, "test_vfs_data/batch_2.zip"}
+    };
+
+    {
+        lochfolk::virtual_file_system vfs;
+        vfs.mount_archives(sources);
+        vfs.list_files(std::cerr);
+
+        EXPECT_EQ(vfs.read_string("/batch/a.txt"_pv), "second");
+        EXPECT_EQ(vfs.read_string("/batch/first.txt"_pv), "first");
+        EXPECT_EQ(vfs.read_string("/archive/info.txt"_pv), "archive\n");
+    }
+
+    {
+        lochfolk::virtual_file_system vfs;
+        vfs.mount_archives(sources, false, {}, 2);
+
+        EXPECT_EQ(vfs.read_string("/batch/a.txt"_pv), "first");
+        EXPECT_EQ(vfs.read_string("/archive/info.txt"_pv), "archive\n");
+    }
+
+    {
+        const lochfolk::archive_source bad_sources[] = {
+            {"/batch"_pv, "test_vfs_data/batch_1.zip"},
+            {"/bad"_pv, "test_vfs_data/not_found.zip"},
+            {"/archive"_pv, "test_vfs_data/ar.zip"}
+        };
+
+        lochfolk::virtual_file_system vfs;
+        EXPECT_ANY_THROW(vfs.mount_archives(bad_sources));
+
+        // Archives before the bad one are mounted
+        EXPECT_TRUE(vfs.exists("/batch/a.txt"_pv));
+        EXPECT_FALSE(vfs.exists("/archive"_pv));
+    }
+}
+
+TEST(vfs, mount_nested_zip_archive)
+{
+    using namespace lochfolk::vfs_literals;
+
+    std::string inner;
+    {
+        auto bytes = read_sys_file("test_vfs_data/ar.zip");
+        inner.assign(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+    const std::pair<std::string, std::string> entries[] = {
+        {"inner.zip", inner}
+    };
+    write_zip("test_vfs_data/outer_stored.zip", entries, MZ_COMPRESS_METHOD_STORE);
+    write_zip("test_vfs_data/outer_deflated.zip", entries, MZ_COMPRESS_METHOD_DEFLATE);
+
+    lochfolk::virtual_file_system vfs;
+    vfs.mount_archive("/stored"_pv, "test_vfs_data/outer_stored.zip");
+    vfs.mount_archive("/mapped"_pv, "test_vfs_data/outer_stored.zip", true, {.memory_map = true});
+    vfs.mount_archive("/deflated"_pv, "test_vfs_data/outer_deflated.zip");
+    vfs.mount_string("/string/inner.zip"_pv, inner);
+    vfs.mount_file("/sys/inner.zip"_pv, "test_vfs_data/ar.zip");
+
+    const lochfolk::path_view outer_dirs[] = {
+        "/stored"_pv, "/mapped"_pv, "/deflated"_pv, "/string"_pv, "/sys"_pv
+    };
+    for(auto dir : outer_dirs)
+    {
+        lochfolk::path inner_path = lochfolk::path(dir) / "inner.zip"_pv;
+        lochfolk::path mount_point = lochfolk::path(dir) / "inner"_pv;
+        vfs.mount_nested_archive(mount_point, inner_path);
+
+        EXPECT_EQ(vfs.read_string(mount_point / "info.txt"_pv), "archive\n");
+
+        auto vfss = vfs.open(mount_point / "data/value.txt"_pv);
+
+        int v1 = 0, v2 = 0;
+        vfss >> v1 >> v2;
+        EXPECT_EQ(v1, 182375);
+        EXPECT_EQ(v2, 182376);
+    }
+    vfs.list_files(std::cerr);
+
+    // Inner archives are still readable after the outer ones are removed
+    EXPECT_TRUE(vfs.remove("/mapped/inner.zip"_pv));
+    EXPECT_TRUE(vfs.remove("/string/inner.zip"_pv));
+    EXPECT_EQ(vfs.read_string("/mapped/inner/info.txt"_pv), "archive\n");
+    EXPECT_EQ(vfs.read_string("/string/inner/info.txt"_pv), "archive\n");
+
+    EXPECT_THROW(vfs.mount_nested_archive("/bad"_pv, "/not/found.zip"_pv), lochfolk::virtual_file_system::error);
+    EXPECT_THROW(vfs.mount_nested_archive("/bad"_pv, "/stored"_pv), lochfolk::virtual_file_system::error);
+}
+
+TEST(vfs, mount_pack)
+{
+    using namespace lochfolk::vfs_literals;
+
+    std::string big;
+    for(int i = 0; big.size() < 64 * 1024; ++i)
+        big += std::to_string(i) + ' ';
+
+    lochfolk::virtual_file_system src;
+    src.mount_dir("/data"_pv, "test_vfs_data/dir");
+    src.mount_archive("/data/ar"_pv, "test_vfs_data/ar.zip");
+    src.mount_string("/data/big.txt"_pv, big);
+    src.mount_string("/data/empty.txt"_pv, "");
+
+    // Blocks of random bytes are stored raw, while the others are compressed
+    std::string mixed;
+    {
+        std::mt19937 gen(182375);
+        std::uniform_int_distribution<int> dist(0, 255);
+        for(int i = 0; i < 16 * 1024; ++i)
+            mixed += static_cast<char>(dist(gen));
+        mixed += big;
+    }
+    src.mount_string("/data/mixed.bin"_pv, mixed);
+
+    const lochfolk::path access_order[] = {
+        lochfolk::path("/data/big.txt"), lochfolk::path("/data/not_found.txt")
+    };
+
+    const std::pair<lochfolk::pack_encoding, std::string_view> encodings[] = {
+        {lochfolk::pack_encoding::raw, "raw"},
+        {lochfolk::pack_encoding::lz4, "lz4"},
+        {lochfolk::pack_encoding::zstd, "zstd"}
+    };
+    for(const auto& [encoding, name] : encodings)
+    {
+        SCOPED_TRACE(name);
+
+        std::filesystem::path pack_path = "test_vfs_data/test_";
+        pack_path += name;
+        pack_path += ".lpk";
+        src.write_pack(
+            "/data"_pv,
+            pack_path,
+            {.encoding = encoding, .chunk_size = 16 * 1024, .access_order = access_order}
+        );
+
+        lochfolk::virtual_file_system vfs;
+        vfs.mount_pack("/pack"_pv, pack_path, true, 4);
+        vfs.list_files(std::cerr);
+
+        EXPECT_TRUE(vfs.is_directory("/pack/nested"_pv));
+        EXPECT_EQ(vfs.read_string("/pack/a.txt"_pv), "AAA\n");
+        EXPECT_EQ(vfs.read_string("/pack/nested/b.txt"_pv), "BBB\n");
+        EXPECT_EQ(vfs.read_string("/pack/ar/info.txt"_pv), "archive\n");
+        EXPECT_EQ(vfs.read_string("/pack/empty.txt"_pv), "");
+        EXPECT_EQ(vfs.file_size("/pack/big.txt"_pv), big.size());
+        EXPECT_TRUE(vfs.read_string("/pack/big.txt"_pv) == big);
+        EXPECT_TRUE(vfs.read_string("/pack/mixed.bin"_pv) == mixed);
+        {
+            auto vfss = vfs.open("/pack/mixed.bin"_pv);
+            std::string str(std::istreambuf_iterator<char>(vfss), {});
+            EXPECT_TRUE(str == mixed);
+        }
+
+        // Concurrent reads of chunked files share the decoding workers
+        {
+            std::atomic_int mismatches = 0;
+            {
+                std::vector<std::jthread> readers;
+                for(int i = 0; i < 8; ++i)
+                {
+                    readers.emplace_back(
+                        [&]()
+                        {
+                            for(int j = 0; j < 4; ++j)
+                            {
+                                if(vfs.read_string("/pack/big.txt"_pv) != big)
+                                    ++mismatches;
+                            }
+                        }
+                    );
+                }
+            }
+            EXPECT_EQ(mismatches, 0);
+        }
+
+        {
+            auto vfss = vfs.open("/pack/ar/data/value.txt"_pv);
+
+            int v1 = 0, v2 = 0;
+            vfss >> v1 >> v2;
+            EXPECT_EQ(v1, 182375);
+            EXPECT_EQ(v2, 182376);
+        }
+
+        auto view = vfs.view_bytes("/pack/big.txt"_pv);
+        if(encoding == lochfolk::pack_encoding::raw)
+        {
+            ASSERT_TRUE(view.has_value());
+            EXPECT_TRUE(std::string_view(reinterpret_cast<const char*>(view->data()), view->size()) == big);
+            // Files of the access order come first, right after the page holding the index
+            EXPECT_EQ(reinterpret_cast<std::uintptr_t>(view->data()) % 4096, 0);
+        }
+        else
+        {
+            EXPECT_FALSE(view.has_value());
+        }
+    }
+
+    {
+        std::ofstream ofs("test_vfs_data/bad.lpk", std::ios_base::binary);
+        ofs << "not a pack";
+    }
+    lochfolk::virtual_file_system vfs;
+    EXPECT_THROW(vfs.mount_pack("/bad"_pv, "test_vfs_data/bad.lpk"), lochfolk::virtual_file_system::error);
+
+    {
+        auto bytes = read_sys_file("test_vfs_data/test_raw.lpk");
+        bytes.resize(bytes.size() - 1);
+        std::ofstream ofs("test_vfs_data/truncated.lpk", std::ios_base::binary);
+        ofs.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+    EXPECT_THROW(vfs.mount_pack("/bad"_pv, "test_vfs_data/truncated.lpk"), lochfolk::virtual_file_system::error);
+    EXPECT_THROW(src.write_pack("/data/a.txt"_pv, "test_vfs_data/bad.lpk"), lochfolk::virtual_file_system::error);
+}
+
+TEST(vfs, zip_archive_compression_methods)
+{
+    using namespace lochfolk::vfs_literals;
+
+    std::string data;
+    {
+        std::mt19937 gen(182375);
+        std::uniform_int_distribution<int> dist(0, 7);
+        data.resize(256 * 1024);
+        for(char& ch : data)
+            ch = "lochfolk"[dist(gen)];
+    }
+    const std::pair<std::string, std::string> entries[] = {
+        {"data.txt", data},
+        {"info.txt", "archive\n"}
+    };
+
+    const std::pair<std::uint16_t, std::string_view> methods[] = {
+        {MZ_COMPRESS_METHOD_ZSTD, "zstd"},
+        {MZ_COMPRESS_METHOD_LZMA, "lzma"}
+    };
+    for(const auto& [method, name] : methods)
+    {
+        SCOPED_TRACE(name);
+
+        std::filesystem::path ar_path = "test_vfs_data/";
+        ar_path += name;
+        ar_path += ".zip";
+        write_zip(ar_path, entries, method);
+
+        lochfolk::virtual_file_system vfs;
+        vfs.mount_archive("/archive"_pv, ar_path);
+
+        EXPECT_EQ(vfs.file_size("/archive/data.txt"_pv), data.size());
+        EXPECT_EQ(vfs.read_string("/archive/info.txt"_pv), "archive\n");
+        EXPECT_TRUE(vfs.read_string("/archive/data.txt"_pv) == data);
+
+        auto vfss = vfs.open("/archive/data.txt"_pv);
+        char buf[16];
+        vfss.seekg(200 * 1024, std::ios_base::beg);
+        vfss.read(buf, sizeof(buf));
+        EXPECT_EQ(std::string_view(buf, sizeof(buf)), std::string_view(data).substr(200 * 1024, sizeof(buf)));
+        vfss.seekg(1024, std::ios_base::beg);
+        vfss.read(buf, sizeof(buf));
+        EXPECT_EQ(std::string_view(buf, sizeof(buf)), std::string_view(data).substr(1024, sizeof(buf)));
+    }
+}
+
+TEST(vfs, zip_archive_inflate_checkpoints)
+{
+    using namespace lochfolk::vfs_literals;
+
+    std::string data;
+    {
+        std::mt19937 gen(1013);
+        std::uniform_int_distribution<int> dist(0, 15);
+        data.resize(1024 * 1024);
+        for(char& ch : data)
+            ch = "0123456789abcdef"[dist(gen)];
+    }
+    const std::pair<std::string, std::string> entries[] = {
+        {"large.txt", data}
+    };
+    write_zip("test_vfs_data/large.zip", entries, MZ_COMPRESS_METHOD_DEFLATE);
+
+    lochfolk::virtual_file_system vfs;
+    vfs.mount_archive(
+        "/large"_pv,
+        "test_vfs_data/large.zip",
+        true,
+        {.checkpoint_interval = 64 * 1024}
+    );
+
+    auto check_read_at = [&](std::istream& is, std::size_t pos)
+    {
+        char buf[16];
+        is.seekg(static_cast<std::streamoff>(pos), std::ios_base::beg);
+        is.read(buf, sizeof(buf));
+        ASSERT_TRUE(is.good());
+        EXPECT_EQ(std::string_view(buf, sizeof(buf)), std::string_view(data).substr(pos, sizeof(buf)));
+    };
+
+    {
+        auto vfss = vfs.open("/large/large.txt"_pv);
+
+        // Read the trailer first, then jump around
+        check_read_at(vfss, data.size() - 16);
+        check_read_at(vfss, 0);
+        check_read_at(vfss, 700 * 1024 + 3);
+        check_read_at(vfss, 200 * 1024 + 7);
+        check_read_at(vfss, 200 * 1024 + 1);
+        check_read_at(vfss, 900 * 1024);
+    }
+
+    // The checkpoints recorded by the previous stream are reused
+    {
+        auto vfss = vfs.open("/large/large.txt"_pv);
+
+        check_read_at(vfss, 500 * 1024 + 5);
+        check_read_at(vfss, 100 * 1024);
+        check_read_at(vfss, data.size() - 16);
+
+        vfss.seekg(0, std::ios_base::beg);
+        std::string str(data.size(), '\0');
+        vfss.read(str.data(), static_cast<std::streamsize>(str.size()));
+        EXPECT_TRUE(str == data);
+    }
+
+    EXPECT_TRUE(vfs.read_string("/large/large.txt"_pv) == data);
+}
+
+TEST(vfs, zip_archive_inflate_exact_read)
+{
+    using namespace lochfolk::vfs_literals;
+
+    std::string data;
+    {
+        std::mt19937 gen(182375);
+        std::uniform_int_distribution<int> dist(0, 15);
+        data.resize(256 * 1024);
+        for(char& ch : data)
+            ch = "0123456789abcdef"[dist(gen)];
+    }
+    const std::pair<std::string, std::string> entries[] = {
+        {"exact.txt", data}
+    };
+    write_zip("test_vfs_data/exact.zip", entries, MZ_COMPRESS_METHOD_DEFLATE);
+
+    lochfolk::virtual_file_system vfs;
+    vfs.mount_archive(
+        "/exact"_pv,
+        "test_vfs_data/exact.zip",
+        true,
+        {.checkpoint_interval = 64 * 1024}
+    );
+
+    // Reading exactly the size of the entry may fill the output before the end of the deflate stream is decoded
+    auto vfss = vfs.open("/exact/exact.txt"_pv);
+    std::string str(data.size(), '\0');
+    vfss.read(str.data(), static_cast<std::streamsize>(str.size()));
+    ASSERT_EQ(vfss.gcount(), static_cast<std::streamsize>(data.size()));
+    EXPECT_TRUE(str == data);
+
+    EXPECT_EQ(vfss.get(), std::char_traits<char>::eof());
+    EXPECT_TRUE(vfss.eof());
+    EXPECT_FALSE(vfss.bad());
+}
+
+TEST(vfs, zip_archive_concurrent_read)
+{
+    using namespace lochfolk::vfs_literals;
+
+    lochfolk::virtual_file_system vfs;
+
+    vfs.mount_archive("/archive"_pv, "test_vfs_data/ar.zip");
+
+    std::vector<std::thread> threads;
+    for(int i = 0; i < 4; ++i)
+    {
+        threads.emplace_back(
+            [&vfs]()
+            {
+                for(int j = 0; j < 64; ++j)
+                {
+                    EXPECT_EQ(vfs.read_string("/archive/info.txt"_pv), "archive\n");
+
+                    auto vfss = vfs.open("/archive/data/value.txt"_pv);
+                    EXPECT_EQ(vfs.file_size("/archive/info.txt"_pv), 8);
+
+                    int v1 = 0, v2 = 0;
+                    vfss >> v1 >> v2;
+                    EXPECT_EQ(v1, 182375);
+                    EXPECT_EQ(v2, 182376);
+                }
+            }
+        );
+    }
+
+    for(auto& t : threads)
+        t.join();
+}
+
+TEST(vfs, concurrent_mount)
+{
+    using namespace lochfolk::vfs_literals;
+
+    lochfolk::virtual_file_system vfs;
+    vfs.mount_string("/base/a.txt"_pv, "A");
+    vfs.mount_archive("/base/archive"_pv, "test_vfs_data/ar.zip");
+
+    std::atomic_bool done = false;
+    std::vector<std::thread> readers;
+    for(int i = 0; i < 3; ++i)
+    {
+        readers.emplace_back(
+            [&]()
+            {
+                while(!done)
+                {
+                    EXPECT_EQ(vfs.read_string("/base/a.txt"_pv), "A");
+                    EXPECT_EQ(vfs.read_string("/base/archive/info.txt"_pv), "archive\n");
+
+                    // Mounted files are either absent or complete
+                    if(vfs.exists("/patch/info.txt"_pv))
+                    {
+                        try
+                        {
+                            EXPECT_EQ(vfs.read_string("/patch/info.txt"_pv), "archive\n");
+                        }
+                        catch(const lochfolk::virtual_file_system::error&)
+                        {
+                            // Removed between the two calls
+                        }
+                    }
+                    // Materializes a lazy directory if it is mounted
+                    (void)vfs.exists("/lazy/data/value.txt"_pv);
+                }
+            }
+        );
+    }
+
+    for(int i = 0; i < 64; ++i)
+    {
+        vfs.mount_archive("/patch"_pv, "test_vfs_data/ar.zip");
+        vfs.mount_archive("/lazy"_pv, "test_vfs_data/ar.zip", true, {.lazy = true});
+        vfs.mount_string("/patch/extra.txt"_pv, std::to_string(i));
+        EXPECT_TRUE(vfs.remove("/patch"_pv));
+        EXPECT_TRUE(vfs.remove("/lazy"_pv));
+    }
+
+    done = true;
+    for(auto& t : readers)
+        t.join();
+
+    EXPECT_FALSE(vfs.exists("/patch"_pv));
+    EXPECT_EQ(vfs.read_string("/base/a.txt"_pv), "A");
+}
+
+TEST(vfs, mount_batch)
+{
+    using namespace lochfolk::vfs_literals;
+
+    lochfolk::mount_batch batch;
+    batch.add_string("/batch/x.txt"_pv, "X");
+    batch.add_dir("/batch/dir/"_pv, "test_vfs_data/dir/");
+    batch.add_file("/batch/sys//example.txt"_pv, "test_vfs_data/example.txt");
+    batch.add_archive("/batch/archive"_pv, "test_vfs_data/ar.zip");
+    // Files of the same path are mounted in order
+    batch.add_string("/batch/x.txt"_pv, "X2");
+    EXPECT_GT(batch.size(), 5);
+
+    EXPECT_THROW(batch.add_string("batch/relative.txt"_pv, "R"), lochfolk::virtual_file_system::error);
+    EXPECT_THROW(batch.add_string("/"_pv, "R"), lochfolk::virtual_file_system::error);
+    EXPECT_THROW(batch.add_dir("/batch"_pv, "test_vfs_data/example.txt"), lochfolk::virtual_file_system::error);
+
+    lochfolk::virtual_file_system vfs;
+    vfs.mount_string("/batch/dir/a.txt"_pv, "replaced");
+    vfs.mount(batch);
+    EXPECT_EQ(batch.size(), 0);
+    vfs.list_files(std::cerr);
+
+    EXPECT_EQ(vfs.read_string("/batch/x.txt"_pv), "X2");
+    EXPECT_EQ(vfs.read_string("/batch/dir/nested/b.txt"_pv), "BBB\n");
+    EXPECT_NE(vfs.read_string("/batch/dir/a.txt"_pv), "replaced");
+    EXPECT_TRUE(vfs.is_directory("/batch/archive/data"_pv));
+    EXPECT_EQ(vfs.read_string("/batch/archive/info.txt"_pv), "archive\n");
+    {
+        auto vfss = vfs.open("/batch/sys/example.txt"_pv);
+
+        int date = 0;
+        vfss >> date;
+        EXPECT_EQ(date, 1013);
+    }
+
+    batch.add_string("/batch/x.txt"_pv, "X3");
+    batch.add_string("/batch/y.txt"_pv, "Y");
+    vfs.mount(batch, false);
+    EXPECT_EQ(vfs.read_string("/batch/x.txt"_pv), "X2");
+    EXPECT_EQ(vfs.read_string("/batch/y.txt"_pv), "Y");
+
+    // Same as mounting one by one
+    lochfolk::virtual_file_system expected;
+    expected.mount_string("/batch/x.txt"_pv, "X2");
+    expected.mount_string("/batch/y.txt"_pv, "Y");
+    expected.mount_dir("/batch/dir/"_pv, "test_vfs_data/dir/");
+    expected.mount_file("/batch/sys/example.txt"_pv, "test_vfs_data/example.txt");
+    expected.mount_archive("/batch/archive"_pv, "test_vfs_data/ar.zip");
+    {
+        std::stringstream lhs, rhs;
+        vfs.list_files(lhs);
+        expected.list_files(rhs);
+        EXPECT_EQ(lhs.str(), rhs.str());
+    }
+
+    // A file conflicts with a directory regardless of the order
+    batch.add_string("/conflict/a/b.txt"_pv, "B");
+    batch.add_string("/conflict/a"_pv, "A");
+    batch.add_string("/conflict/c.txt"_pv, "C");
+    EXPECT_THROW(vfs.mount(batch), lochfolk::virtual_file_system::error);
+    // Nothing is mounted, and the batch is kept
+    EXPECT_FALSE(vfs.exists("/conflict"_pv));
+    EXPECT_EQ(batch.size(), 3);
+    EXPECT_THROW(vfs.mount(batch, false), lochfolk::virtual_file_system::error);
+    EXPECT_FALSE(vfs.exists("/conflict"_pv));
+
+    // Files of the tree conflict with the directories of a batch
+    lochfolk::mount_batch under_file;
+    under_file.add_string("/batch/0.txt"_pv, "0");
+    under_file.add_string("/batch/x.txt/z.txt"_pv, "Z");
+    EXPECT_THROW(vfs.mount(under_file), lochfolk::virtual_file_system::error);
+    EXPECT_FALSE(vfs.exists("/batch/0.txt"_pv));
+    EXPECT_EQ(vfs.read_string("/batch/x.txt"_pv), "X2");
+
+    // A file at an existing directory is skipped without overwriting, so it does not conflict
+    lochfolk::mount_batch skipped;
+    skipped.add_string("/batch/dir"_pv, "D");
+    skipped.add_string("/batch/dir/d.txt"_pv, "D");
+    EXPECT_THROW(vfs.mount(skipped), lochfolk::virtual_file_system::error);
+    vfs.mount(skipped, false);
+    EXPECT_TRUE(vfs.is_directory("/batch/dir"_pv));
+    EXPECT_EQ(vfs.read_string("/batch/dir/d.txt"_pv), "D");
+    EXPECT_TRUE(vfs.remove("/batch/dir/d.txt"_pv));
+
+    lochfolk::virtual_file_system folded({.case_insensitive = true});
+    lochfolk::mount_batch spelled;
+    spelled.add_string("/Conflict/A/b.txt"_pv, "B");
+    spelled.add_string("/conflict/a"_pv, "A");
+    EXPECT_THROW(folded.mount(spelled), lochfolk::virtual_file_system::error);
+    EXPECT_FALSE(folded.exists("/conflict"_pv));
+
+    const lochfolk::layer_id layer = vfs.add_layer(1);
+    lochfolk::mount_batch patch;
+    patch.add_string("/batch/x.txt"_pv, "patched");
+    patch.add_string("/batch/patch/z.txt"_pv, "Z");
+    vfs.mount(layer, patch);
+    EXPECT_EQ(vfs.read_string("/batch/x.txt"_pv), "patched");
+    EXPECT_TRUE(vfs.unmount_layer(layer));
+    EXPECT_EQ(vfs.read_string("/batch/x.txt"_pv), "X2");
+    EXPECT_FALSE(vfs.exists("/batch/patch"_pv));
+}
+
+TEST(vfs, mount_manifest)
+{
+    using namespace lochfolk::vfs_literals;
+    namespace stdfs = std::filesystem;
+
+    const stdfs::path dir = "test_vfs_data/manifest_dir";
+    stdfs::remove_all(dir);
+    stdfs::create_directories(dir / "nested");
+    std::ofstream(dir / "a.txt") << "A";
+    std::ofstream(dir / "nested" / "b.txt") << "B";
+    // Changes are detected by the times of directories, so make them distinct from the time of later changes
+    const auto old_time = stdfs::file_time_type::clock::now() - std::chrono::hours(1);
+    stdfs::last_write_time(dir, old_time);
+    stdfs::last_write_time(dir / "nested", old_time);
+
+    const stdfs::path ar_path = "test_vfs_data/manifest.zip";
+    const std::vector<std::pair<std::string, std::string>> entries = {
+        {"info.txt", "archive"},
+        {"data/value.txt", "123 456"}
+    };
+    write_zip(ar_path, entries, MZ_COMPRESS_METHOD_DEFLATE);
+
+    auto listing = [](lochfolk::virtual_file_system& vfs)
+    {
+        std::stringstream ss;
+        vfs.list_files(ss);
+        return ss.str();
+    };
+
+    lochfolk::virtual_file_system expected;
+    expected.mount_dir("/dir"_pv, dir);
+    expected.mount_archive("/ar"_pv, ar_path);
+
+    lochfolk::mount_manifest manifest;
+    {
+        lochfolk::virtual_file_system vfs;
+        vfs.mount_dir("/dir"_pv, dir, manifest);
+        vfs.mount_archive("/ar"_pv, ar_path, manifest);
+        EXPECT_EQ(manifest.misses(), 2);
+        EXPECT_EQ(manifest.hits(), 0);
+        EXPECT_EQ(manifest.size(), 2);
+        EXPECT_EQ(listing(vfs), listing(expected));
+    }
+    manifest.save("test_vfs_data/test.manifest");
+
+    lochfolk::mount_manifest loaded;
+    ASSERT_TRUE(loaded.load("test_vfs_data/test.manifest"));
+    EXPECT_EQ(loaded.size(), 2);
+    {
+        lochfolk::virtual_file_system vfs;
+        vfs.mount_dir("/dir"_pv, dir, loaded);
+        vfs.mount_archive("/ar"_pv, ar_path, loaded);
+        EXPECT_EQ(loaded.hits(), 2);
+        EXPECT_EQ(loaded.misses(), 0);
+        EXPECT_EQ(listing(vfs), listing(expected));
+        EXPECT_EQ(vfs.read_string("/dir/nested/b.txt"_pv), "B");
+        EXPECT_EQ(vfs.read_string("/ar/data/value.txt"_pv), "123 456");
+
+        lochfolk::virtual_file_system lazy;
+        lazy.mount_archive("/ar"_pv, ar_path, loaded, true, {.lazy = true});
+        EXPECT_EQ(lazy.read_string("/ar/info.txt"_pv), "archive");
+        EXPECT_EQ(loaded.hits(), 3);
+
+        lochfolk::virtual_file_system layered;
+        layered.mount_string("/dir/a.txt"_pv, "base");
+        const lochfolk::layer_id layer = layered.add_layer(1);
+        layered.mount_dir(layer, "/dir"_pv, dir, loaded);
+        layered.mount_archive(layer, "/ar"_pv, ar_path, loaded);
+        EXPECT_EQ(loaded.hits(), 5);
+        EXPECT_EQ(loaded.misses(), 0);
+        EXPECT_EQ(layered.read_string("/dir/a.txt"_pv), "A");
+        EXPECT_EQ(layered.read_string("/ar/data/value.txt"_pv), "123 456");
+        EXPECT_TRUE(layered.unmount_layer(layer));
+        EXPECT_EQ(layered.read_string("/dir/a.txt"_pv), "base");
+        EXPECT_FALSE(layered.exists("/ar"_pv));
+    }
+
+    // Changed sources are enumerated again
+    std::ofstream(dir / "nested" / "c.txt") << "C";
+    const std::vector<std::pair<std::string, std::string>> changed = {
+        {"info.txt", "changed"}
+    };
+    write_zip(ar_path, changed, MZ_COMPRESS_METHOD_DEFLATE);
+    {
+        lochfolk::mount_batch batch;
+        batch.add_dir("/dir"_pv, dir, loaded);
+        batch.add_archive("/ar"_pv, ar_path, loaded);
+        EXPECT_EQ(loaded.misses(), 2);
+
+        lochfolk::virtual_file_system vfs;
+        vfs.mount(batch);
+        EXPECT_EQ(vfs.read_string("/dir/nested/c.txt"_pv), "C");
+        EXPECT_EQ(vfs.read_string("/ar/info.txt"_pv), "changed");
+        EXPECT_FALSE(vfs.exists("/ar/data"_pv));
+    }
+
+    EXPECT_FALSE(loaded.load("test_vfs_data/missing.manifest"));
+    EXPECT_EQ(loaded.size(), 0);
+    {
+        auto bytes = read_sys_file("test_vfs_data/test.manifest");
+        bytes.back() ^= std::byte(1);
+        std::ofstream ofs("test_vfs_data/corrupted.manifest", std::ios_base::binary);
+        ofs.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+    EXPECT_FALSE(loaded.load("test_vfs_data/corrupted.manifest"));
+    EXPECT_FALSE(loaded.load("test_vfs_data/example.txt"));
+    EXPECT_EQ(loaded.size(), 0);
+}
+
+TEST(vfs, directory_iterator)
+{
+    using namespace lochfolk::vfs_literals;
+
+    lochfolk::virtual_file_system vfs;
+    vfs.mount_string("/data/x.txt"_pv, "X");
+    vfs.mount_string("/data/sub/y.txt"_pv, "YY");
+    vfs.mount_string("/data/sub/deep/z.txt"_pv, "ZZZ");
+    vfs.mount_string("/data/skipped/w.txt"_pv, "W");
+    vfs.mount_dir("/data/dir"_pv, "test_vfs_data/dir/");
+    vfs.mount_string("/empty/file.txt"_pv, "E");
+    vfs.remove("/empty/file.txt"_pv);
+
+    {
+        std::vector<std::string> names;
+        for(const auto& e : lochfolk::directory_iterator(vfs, "/data"_pv))
+        {
+            names.emplace_back(e.name());
+            EXPECT_EQ(e.path().string(), "/data/" + names.back());
+        }
+        std::ranges::sort(names);
+        EXPECT_EQ(names, (std::vector<std::string>{"dir", "skipped", "sub", "x.txt"}));
+    }
+
+    {
+        std::vector<std::string> paths;
+        for(lochfolk::directory_iterator it(vfs, "/data/"_pv, true); it != lochfolk::directory_iterator(); ++it)
+        {
+            if(it->name() == "skipped")
+                it.disable_recursion_pending();
+
+            std::string p(it->path().string());
+            if(it->is_directory())
+            {
+                EXPECT_EQ(it->kind(), lochfolk::file_kind::directory);
+                p += '/';
+            }
+            else if(it->name() == "z.txt")
+            {
+                EXPECT_EQ(it->kind(), lochfolk::file_kind::string_constant);
+                EXPECT_EQ(it.depth(), 2);
+                EXPECT_EQ(it->file_size(), 3);
+                EXPECT_EQ(it->read_string(), "ZZZ");
+            }
+            else if(it->name() == "a.txt")
+            {
+                EXPECT_EQ(it->kind(), lochfolk::file_kind::sys_file);
+                std::string str;
+                it->open() >> str;
+                EXPECT_EQ(str, "AAA");
+            }
+            paths.push_back(std::move(p));
+        }
+
+        // Directories are visited before their children
+        auto pos = [&](std::string_view p)
+        {
+            return std::ranges::find(paths, p) - paths.begin();
+        };
+        EXPECT_LT(pos("/data/sub/"), pos("/data/sub/deep/"));
+        EXPECT_LT(pos("/data/sub/deep/"), pos("/data/sub/deep/z.txt"));
+
+        std::ranges::sort(paths);
+        EXPECT_EQ(
+            paths,
+            (std::vector<std::string>{
+                "/data/dir/",
+                "/data/dir/a.txt",
+                "/data/dir/nested/",
+                "/data/dir/nested/b.txt",
+                "/data/skipped/",
+                "/data/sub/",
+                "/data/sub/deep/",
+                "/data/sub/deep/z.txt",
+                "/data/sub/y.txt",
+                "/data/x.txt"
+            })
+        );
+    }
+
+    EXPECT_EQ(lochfolk::directory_iterator(vfs, "/empty"_pv), lochfolk::directory_iterator());
+    EXPECT_THROW(lochfolk::directory_iterator(vfs, "/missing"_pv), lochfolk::virtual_file_system::error);
+    EXPECT_THROW(lochfolk::directory_iterator(vfs, "/data/x.txt"_pv), lochfolk::virtual_file_system::error);
+
+    // Directories of a lazily mounted archive are materialized on the way
+    vfs.mount_archive("/lazy"_pv, "test_vfs_data/ar.zip", true, {.lazy = true});
+    {
+        std::size_t count = 0;
+        lochfolk::directory_iterator it(vfs, "/"_pv, true);
+        for(const auto& e : it)
+        {
+            if(e.path() == "/lazy/info.txt"_pv)
+            {
+                EXPECT_EQ(e.kind(), lochfolk::file_kind::archive_entry);
+                EXPECT_EQ(e.read_string(), "archive\n");
+            }
+            // The VFS is not locked between increments
+            EXPECT_TRUE(vfs.exists(e.path()));
+            if(!e.is_directory())
+            {
+                EXPECT_EQ(vfs.read_string(e.path()), e.read_string());
+            }
+            ++count;
+        }
+        EXPECT_GT(count, 12);
+        EXPECT_TRUE(vfs.is_directory("/lazy/data"_pv));
+    }
+
+    // Changes during the iteration are not seen by the directories already listed
+    {
+        std::vector<std::string> paths;
+        for(const auto& e : lochfolk::directory_iterator(vfs, "/data"_pv, true))
+        {
+            if(e.path() == "/data/sub"_pv)
+            {
+                EXPECT_TRUE(vfs.remove("/data/sub/deep"_pv));
+                vfs.mount_string("/data/sub/y.txt"_pv, "remounted");
+                vfs.mount_string("/data/sub/new.txt"_pv, "N");
+            }
+            else if(e.path() == "/data/x.txt"_pv)
+            {
+                EXPECT_TRUE(vfs.remove("/data/x.txt"_pv));
+                EXPECT_THROW((void)e.read_string(), lochfolk::virtual_file_system::error);
+            }
+            else if(e.path() == "/data/sub/y.txt"_pv)
+            {
+                EXPECT_EQ(e.read_string(), "remounted");
+            }
+            paths.emplace_back(e.path().string());
+        }
+
+        // The removed directory is skipped, since it is listed only when the iteration enters it
+        EXPECT_EQ(std::ranges::count(paths, "/data/sub/deep"), 0);
+        EXPECT_EQ(std::ranges::count(paths, "/data/sub/new.txt"), 1);
+        EXPECT_EQ(std::ranges::count(paths, "/data/x.txt"), 1);
+    }
+}
+
+TEST(vfs, glob)
+{
+    using namespace lochfolk::vfs_literals;
+
+    {
+        lochfolk::glob_pattern pat("/assets/**/[a-c]?_*.shader");
+        EXPECT_EQ(pat.str(), "/assets/**/[a-c]?_*.shader");
+        EXPECT_TRUE(pat.match("/assets/ab_x.shader"_pv));
+        EXPECT_TRUE(pat.match("/assets/deep/er/cd_.shader"_pv));
+        EXPECT_FALSE(pat.match("/assets/db_x.shader"_pv));
+        EXPECT_FALSE(pat.match("/assets/a_x.shader"_pv));
+        EXPECT_FALSE(pat.match("/assets/ab_x.shader/more"_pv));
+        EXPECT_FALSE(pat.match("/other/ab_x.shader"_pv));
+
+        EXPECT_TRUE(lochfolk::glob_pattern("/a/[!0-9]*").match("/a/x1"_pv));
+        EXPECT_FALSE(lochfolk::glob_pattern("/a/[!0-9]*").match("/a/1x"_pv));
+        EXPECT_TRUE(lochfolk::glob_pattern("/a/[]x]").match("/a/]"_pv));
+        EXPECT_TRUE(lochfolk::glob_pattern("/a/\\*").match("/a/*"_pv));
+        EXPECT_FALSE(lochfolk::glob_pattern("/a/\\*").match("/a/b"_pv));
+        EXPECT_TRUE(lochfolk::glob_pattern("/a/*b*b").match("/a/abbab"_pv));
+        EXPECT_FALSE(lochfolk::glob_pattern("/a/*b*b").match("/a/abba"_pv));
+
+        EXPECT_THROW(lochfolk::glob_pattern("a/*"), lochfolk::virtual_file_system::error);
+        EXPECT_THROW(lochfolk::glob_pattern("/a/[ab"), lochfolk::virtual_file_system::error);
+    }
+
+    lochfolk::virtual_file_system vfs;
+    vfs.mount_string("/assets/a.shader"_pv, "A");
+    vfs.mount_string("/assets/fx/b.shader"_pv, "B");
+    vfs.mount_string("/assets/fx/b.png"_pv, "B");
+    vfs.mount_string("/assets/fx/deep/c.shader"_pv, "C");
+    vfs.mount_string("/other/d.shader"_pv, "D");
+    vfs.mount_dir("/assets/dir"_pv, "test_vfs_data/dir/");
+
+    auto sorted_glob = [&](std::string_view pattern)
+    {
+        std::vector<std::string> result;
+        for(const auto& p : vfs.glob(pattern))
+            result.push_back(p.string());
+        std::ranges::sort(result);
+        return result;
+    };
+
+    const std::vector<std::string> shaders = {
+        "/assets/a.shader", "/assets/fx/b.shader", "/assets/fx/deep/c.shader"
+    };
+    const std::vector<std::string> all_shaders = {
+        "/assets/a.shader", "/assets/fx/b.shader", "/assets/fx/deep/c.shader", "/other/d.shader"
+    };
+
+    EXPECT_EQ(sorted_glob("/assets/**/*.shader"), shaders);
+    EXPECT_EQ(sorted_glob("/**/*.shader"), all_shaders);
+    EXPECT_EQ(sorted_glob("/assets/*/b.*"), (std::vector<std::string>{"/assets/fx/b.png", "/assets/fx/b.shader"}));
+    EXPECT_EQ(sorted_glob("//assets/fx/"), (std::vector<std::string>{"/assets/fx"}));
+    EXPECT_EQ(
+        sorted_glob("/assets/**/?.txt"),
+        (std::vector<std::string>{"/assets/dir/a.txt", "/assets/dir/nested/b.txt"})
+    );
+    // `**` also matches no name, so the directory itself is included
+    EXPECT_EQ(sorted_glob("/assets/**").size(), 11);
+    EXPECT_TRUE(sorted_glob("/missing/**/*.shader").empty());
+
+    // The extension index answers the same as walking the tree, and follows mounting and removing
+    vfs.enable_extension_index();
+    EXPECT_EQ(sorted_glob("/assets/**/*.shader"), shaders);
+    EXPECT_EQ(sorted_glob("/**/*.shader"), all_shaders);
+    EXPECT_TRUE(sorted_glob("/**/*.missing").empty());
+    vfs.mount_string("/assets/fx/e.shader"_pv, "E");
+    vfs.remove("/assets/fx/deep"_pv);
+    EXPECT_EQ(sorted_glob("/assets/**/*.shader"), (std::vector<std::string>{
+        "/assets/a.shader", "/assets/fx/b.shader", "/assets/fx/e.shader"
+    }));
+    vfs.enable_extension_index(false);
+    EXPECT_EQ(sorted_glob("/assets/**/*.shader"), (std::vector<std::string>{
+        "/assets/a.shader", "/assets/fx/b.shader", "/assets/fx/e.shader"
+    }));
+
+    // Directories of a lazily mounted archive are materialized on the way
+    vfs.enable_extension_index();
+    vfs.mount_archive("/lazy"_pv, "test_vfs_data/ar.zip", true, {.lazy = true});
+    EXPECT_EQ(sorted_glob("/lazy/**/value.txt"), (std::vector<std::string>{"/lazy/data/value.txt"}));
+    EXPECT_EQ(sorted_glob("/**/*.txt").size(), 4);
+}
+
+TEST(vfs, case_insensitive)
+{
+    using namespace lochfolk::vfs_literals;
+
+    {
+        lochfolk::virtual_file_system vfs;
+        EXPECT_FALSE(vfs.case_insensitive());
+        vfs.mount_string("/Data/File.txt"_pv, "F");
+        EXPECT_TRUE(vfs.exists("/Data/File.txt"_pv));
+        EXPECT_FALSE(vfs.exists("/data/file.txt"_pv));
+    }
+
+    lochfolk::virtual_file_system vfs({.case_insensitive = true});
+    EXPECT_TRUE(vfs.case_insensitive());
+
+    vfs.mount_string("/Mods/Textures/Stone.PNG"_pv, "stone");
+    vfs.mount_string("/mods/textures/Grass.png"_pv, "grass");
+    vfs.mount_string("/\xc3\x84.txt"_pv, "upper");
+    vfs.mount_string("/\xc3\xa4.txt"_pv, "lower");
+    vfs.mount_dir("/MODS/Dir"_pv, "test_vfs_data/dir/");
+
+    EXPECT_TRUE(vfs.is_directory("/MODS"_pv));
+    EXPECT_TRUE(vfs.exists("/mods/textures/stone.png"_pv));
+    EXPECT_EQ(vfs.read_string("/MODS/TEXTURES/STONE.PNG"_pv), "stone");
+    EXPECT_EQ(vfs.read_string("//mods//Textures/grass.PNG"_pv), "grass");
+    EXPECT_EQ(vfs.read_string("/mods/dir/NESTED/b.txt"_pv), "BBB\n");
+    EXPECT_EQ(vfs.file_size("/MoDs/TeXtUrEs/StOnE.pNg"_pv), 5);
+    // Only ASCII letters are folded
+    EXPECT_EQ(vfs.read_string("/\xc3\x84.txt"_pv), "upper");
+    EXPECT_EQ(vfs.read_string("/\xc3\xa4.TXT"_pv), "lower");
+
+    // The first spelling is kept for display
+    vfs.mount_string("/MODS/TEXTURES/STONE.png"_pv, "stone2");
+    EXPECT_EQ(vfs.read_string("/mods/textures/stone.png"_pv), "stone2");
+    {
+        std::ostringstream ss;
+        vfs.list_files(ss);
+        EXPECT_NE(ss.str().find("- Mods/"), std::string::npos);
+        EXPECT_NE(ss.str().find("- Stone.PNG"), std::string::npos);
+        EXPECT_EQ(ss.str().find("STONE"), std::string::npos);
+    }
+    {
+        std::vector<std::string> paths;
+        for(const auto& e : lochfolk::directory_iterator(vfs, "/MODS/textures"_pv))
+            paths.push_back(e.path().string());
+        std::ranges::sort(paths);
+        EXPECT_EQ(paths, (std::vector<std::string>{"/Mods/Textures/Grass.png", "/Mods/Textures/Stone.PNG"}));
+    }
+
+    // Patterns are matched ignoring case too, with or without the extension index
+    auto sorted_glob = [&](std::string_view pattern)
+    {
+        std::vector<std::string> result;
+        for(const auto& p : vfs.glob(pattern))
+            result.push_back(p.string());
+        std::ranges::sort(result);
+        return result;
+    };
+    const std::vector<std::string> textures = {"/Mods/Textures/Grass.png", "/Mods/Textures/Stone.PNG"};
+    EXPECT_EQ(sorted_glob("/MODS/**/*.Png"), textures);
+    EXPECT_EQ(sorted_glob("/mods/TEXTURES/[A-Z]*"), textures);
+    vfs.enable_extension_index();
+    EXPECT_EQ(sorted_glob("/MODS/**/*.Png"), textures);
+
+    EXPECT_TRUE(vfs.remove("/MODS/TEXTURES/GRASS.PNG"_pv));
+    EXPECT_FALSE(vfs.exists("/Mods/Textures/Grass.png"_pv));
+    EXPECT_EQ(sorted_glob("/mods/**/*.png"), (std::vector<std::string>{"/Mods/Textures/Stone.PNG"}));
+
+    // Layers share the stacks of paths differing in case
+    {
+        lochfolk::layer_id mod = vfs.add_layer(1);
+        vfs.mount_string(mod, "/MODS/textures/stone.png"_pv, "modded");
+        EXPECT_EQ(vfs.read_string("/Mods/Textures/Stone.PNG"_pv), "modded");
+        vfs.unmount_layer(mod);
+        EXPECT_EQ(vfs.read_string("/Mods/Textures/Stone.PNG"_pv), "stone2");
+    }
+
+    vfs.mount_archive("/Lazy"_pv, "test_vfs_data/ar.zip", true, {.lazy = true});
+    EXPECT_EQ(vfs.read_string("/LAZY/INFO.TXT"_pv), "archive\n");
+    EXPECT_TRUE(vfs.exists("/lazy/DATA/Value.txt"_pv));
+
+    const lochfolk::frozen_vfs frozen = vfs.freeze();
+    EXPECT_EQ(frozen.read_string("/mods/textures/STONE.png"_pv), "stone2");
+    EXPECT_EQ(frozen.read_string("//Lazy//INFO.txt"_pv), "archive\n");
+    EXPECT_FALSE(frozen.exists("/mods/textures/grass.png"_pv));
+    {
+        std::ostringstream ss;
+        frozen.list_files(ss);
+        EXPECT_NE(ss.str().find("- Stone.PNG"), std::string::npos);
+    }
+}
+
+TEST(vfs, layers)
+{
+    using namespace lochfolk::vfs_literals;
+
+    lochfolk::virtual_file_system vfs;
+    vfs.mount_string("/data/a.txt"_pv, "base A");
+    vfs.mount_string("/data/b.txt"_pv, "base B");
+
+    const lochfolk::layer_id mod = vfs.add_layer(10);
+    vfs.mount_string(mod, "/data/a.txt"_pv, "mod A");
+    vfs.mount_string(mod, "/data/mod/c.txt"_pv, "mod C");
+    vfs.mount_archive(mod, "/ar"_pv, "test_vfs_data/ar.zip", true, {.lazy = true});
+
+    const lochfolk::layer_id patch = vfs.add_layer(5);
+    vfs.mount_string(patch, "/data/a.txt"_pv, "patch A");
+    vfs.mount_string(patch, "/data/b.txt"_pv, "patch B");
+    vfs.mount_string(patch, "/data/b.txt"_pv, "ignored", false);
+
+    // Mounting into the base layer does not replace the files of higher layers
+    vfs.mount_string("/data/a.txt"_pv, "base A2");
+    vfs.list_files(std::cerr);
+
+    EXPECT_EQ(vfs.read_string("/data/a.txt"_pv), "mod A");
+    EXPECT_EQ(vfs.read_string("/data/b.txt"_pv), "patch B");
+    EXPECT_EQ(vfs.read_string("/data/mod/c.txt"_pv), "mod C");
+    EXPECT_EQ(vfs.read_string("/ar/info.txt"_pv), "archive\n");
+
+    // Files and directories of different layers cannot replace each other
+    EXPECT_THROW(vfs.mount_string(patch, "/data/mod"_pv, "file"), lochfolk::virtual_file_system::error);
+    EXPECT_THROW(vfs.mount_string("/data"_pv, "file"), lochfolk::virtual_file_system::error);
+
+    EXPECT_TRUE(vfs.unmount_layer(mod));
+    EXPECT_EQ(vfs.read_string("/data/a.txt"_pv), "patch A");
+    EXPECT_FALSE(vfs.exists("/data/mod/c.txt"_pv));
+    EXPECT_FALSE(vfs.exists("/data/mod"_pv));
+    EXPECT_FALSE(vfs.exists("/ar"_pv));
+
+    EXPECT_TRUE(vfs.unmount_layer(patch));
+    EXPECT_EQ(vfs.read_string("/data/a.txt"_pv), "base A2");
+    EXPECT_EQ(vfs.read_string("/data/b.txt"_pv), "base B");
+
+    EXPECT_FALSE(vfs.unmount_layer(patch));
+    EXPECT_FALSE(vfs.unmount_layer(lochfolk::base_layer));
+    EXPECT_THROW(vfs.mount_string(patch, "/data/d.txt"_pv, "D"), lochfolk::virtual_file_system::error);
+
+    // A layer below the base one
+    const lochfolk::layer_id fallback = vfs.add_layer(-1);
+    vfs.mount_string(fallback, "/data/b.txt"_pv, "fallback B");
+    vfs.mount_string(fallback, "/fallback/e.txt"_pv, "fallback E");
+    EXPECT_EQ(vfs.read_string("/data/b.txt"_pv), "base B");
+    EXPECT_TRUE(vfs.remove("/data/b.txt"_pv));
+    EXPECT_FALSE(vfs.exists("/data/b.txt"_pv));
+
+    // Removed files are forgotten by their layers
+    EXPECT_TRUE(vfs.unmount_layer(fallback));
+    EXPECT_FALSE(vfs.exists("/data/b.txt"_pv));
+    EXPECT_FALSE(vfs.exists("/fallback"_pv));
+    EXPECT_EQ(vfs.read_string("/data/a.txt"_pv), "base A2");
+
+    // The tree is destructive again without layers
+    vfs.mount_string("/data"_pv, "file");
+    EXPECT_FALSE(vfs.is_directory("/data"_pv));
+}
+
+TEST(vfs, freeze)
+{
+    using namespace lochfolk::vfs_literals;
+
+    lochfolk::virtual_file_system vfs;
+    vfs.mount_string("/text/a.txt"_pv, "A");
+    vfs.mount_file("/data/example.txt"_pv, "test_vfs_data/example.txt");
+    vfs.mount_archive("/lazy"_pv, "test_vfs_data/ar.zip", true, {.lazy = true});
+
+    const lochfolk::frozen_vfs frozen = vfs.freeze();
+    frozen.list_files(std::cerr);
+
+    EXPECT_TRUE(frozen.is_directory("/"_pv));
+    EXPECT_TRUE(frozen.is_directory("/text"_pv));
+    EXPECT_TRUE(frozen.is_directory("/lazy/data"_pv));
+    EXPECT_FALSE(frozen.is_directory("/text/a.txt"_pv));
+    EXPECT_EQ(frozen.read_string("/text/a.txt"_pv), "A");
+    EXPECT_EQ(frozen.read_string("/lazy/info.txt"_pv), "archive\n");
+    EXPECT_EQ(frozen.file_size("/text"_pv), 0);
+    EXPECT_EQ(frozen.file_size("/lazy/info.txt"_pv), vfs.file_size("/lazy/info.txt"_pv));
+
+    {
+        auto vfss = frozen.open("/data/example.txt"_pv);
+
+        int date = 0;
+        vfss >> date;
+        EXPECT_EQ(date, 1013);
+    }
+
+    {
+        auto bytes = frozen.view_bytes("/text/a.txt"_pv);
+        ASSERT_TRUE(bytes.has_value());
+        EXPECT_EQ(bytes->size(), 1);
+        EXPECT_FALSE(frozen.view_bytes("/text"_pv).has_value());
+    }
+
+    // Paths not in the normalized form are resolved like the VFS does
+    for(lochfolk::path_view p : {"/text/"_pv, "/lazy/data//value.txt"_pv, "/text/c.txt"_pv, "text/a.txt"_pv, ""_pv})
+    {
+        EXPECT_EQ(frozen.exists(p), vfs.exists(p)) << p;
+        EXPECT_EQ(frozen.is_directory(p), vfs.is_directory(p)) << p;
+    }
+    EXPECT_TRUE(frozen.is_directory("/text/"_pv));
+    EXPECT_FALSE(frozen.exists("/text/c.txt"_pv));
+    EXPECT_THROW((void)frozen.read_string("/text/c.txt"_pv), lochfolk::virtual_file_system::error);
+    EXPECT_THROW((void)frozen.read_string("/text"_pv), lochfolk::virtual_file_system::error);
+
+    // A frozen VFS is a snapshot
+    vfs.mount_string("/text/c.txt"_pv, "C");
+    EXPECT_TRUE(vfs.remove("/text/a.txt"_pv));
+    EXPECT_FALSE(frozen.exists("/text/c.txt"_pv));
+    EXPECT_EQ(frozen.read_string("/text/a.txt"_pv), "A");
+    EXPECT_EQ(frozen.size(), vfs.freeze().size());
+
+    std::vector<std::thread> readers;
+    for(int i = 0; i < 3; ++i)
+    {
+        readers.emplace_back(
+            [&]()
+            {
+                for(int j = 0; j < 256; ++j)
+                {
+                    EXPECT_EQ(frozen.read_string("/text/a.txt"_pv), "A");
+                    EXPECT_EQ(frozen.read_string("/lazy/data/value.txt"_pv), "182375 182376\n");
+                }
+            }
+        );
+    }
+    for(auto& t : readers)
+        t.join();
+
+    lochfolk::frozen_vfs refrozen = vfs.freeze();
+    lochfolk::frozen_vfs moved = std::move(refrozen);
+    EXPECT_TRUE(moved.exists("/text/c.txt"_pv));
+    EXPECT_FALSE(moved.exists("/text/a.txt"_pv));
+}
+
 TEST(vfs, access_context)
 {
     using namespace lochfolk::vfs_literals;
@@ -353,6 +1896,82 @@ TEST(vfs, access_context_archive)
     EXPECT_FALSE(ctx.exists("data/value.txt"_pv));
 }
 
+TEST(vfs, access_context_cache)
+{
+    using namespace lochfolk::vfs_literals;
+
+    lochfolk::virtual_file_system vfs;
+    vfs.mount_string("/data/strings/str.txt"_pv, "str");
+    vfs.mount_string("/info/info.txt"_pv, "1013");
+
+    lochfolk::access_context ctx(vfs);
+    ctx.current_path("/data"_pv);
+    EXPECT_EQ(ctx.read_string("strings/str.txt"_pv), "str");
+    EXPECT_TRUE(ctx.is_directory(""_pv));
+    EXPECT_TRUE(ctx.is_directory("./strings/"_pv));
+    EXPECT_EQ(ctx.read_string("../../info/info.txt"_pv), "1013");
+    // Going up after a name is resolved by the full path, even if the name does not exist
+    EXPECT_EQ(ctx.read_string("missing/../strings/str.txt"_pv), "str");
+    EXPECT_THROW((void)ctx.file_size("strings/missing.txt"_pv), lochfolk::virtual_file_system::error);
+
+    // The cached node of the current directory is destroyed by removing it
+    EXPECT_TRUE(vfs.remove("/data"_pv));
+    EXPECT_FALSE(ctx.exists("strings/str.txt"_pv));
+    EXPECT_TRUE(ctx.exists("../info/info.txt"_pv));
+    vfs.mount_string("/data/strings/str.txt"_pv, "remounted");
+    EXPECT_EQ(ctx.read_string("strings/str.txt"_pv), "remounted");
+
+    lochfolk::access_context copied = ctx;
+    lochfolk::layer_id layer = vfs.add_layer(1);
+    vfs.mount_string(layer, "/data/strings/str.txt"_pv, "layered", true);
+    EXPECT_EQ(copied.read_string("strings/str.txt"_pv), "layered");
+    vfs.unmount_layer(layer);
+    EXPECT_EQ(copied.read_string("strings/str.txt"_pv), "remounted");
+
+    // The current directory replaced by a file
+    EXPECT_TRUE(vfs.remove("/data"_pv));
+    vfs.mount_string("/data"_pv, "file");
+    EXPECT_FALSE(ctx.exists("strings/str.txt"_pv));
+    EXPECT_EQ(ctx.read_string(""_pv), "file");
+
+    // A directory of a lazily mounted archive is materialized for the relative lookup
+    vfs.mount_archive("/archive"_pv, "test_vfs_data/ar.zip", true, {.lazy = true});
+    ctx.current_path("/archive/data"_pv);
+    EXPECT_TRUE(ctx.exists("value.txt"_pv));
+    EXPECT_EQ(ctx.read_string("../info.txt"_pv), "archive\n");
+
+    // Threads share a context while the VFS is mounted into, which makes them refresh the cache together
+    {
+        const lochfolk::access_context& shared = ctx;
+        std::atomic_int found = 0;
+        {
+            std::vector<std::jthread> threads;
+            for(int i = 0; i < 4; ++i)
+            {
+                threads.emplace_back(
+                    [&]()
+                    {
+                        for(int j = 0; j < 200; ++j)
+                        {
+                            if(shared.exists("value.txt"_pv))
+                                ++found;
+                        }
+                    }
+                );
+            }
+            for(int j = 0; j < 50; ++j)
+                vfs.mount_string("/archive/extra.txt"_pv, "extra");
+        }
+        EXPECT_EQ(found, 800);
+    }
+
+    lochfolk::virtual_file_system insensitive({.case_insensitive = true});
+    insensitive.mount_string("/Scripts/Lib/Util.lua"_pv, "util");
+    lochfolk::access_context script(insensitive);
+    script.current_path("/scripts"_pv);
+    EXPECT_EQ(script.read_string("LIB/util.LUA"_pv), "util");
+}
+
 int main(int argc, char* argv[])
 {
     testing::InitGoogleTest(&argc, argv);
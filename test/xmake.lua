@@ -13,7 +13,7 @@ target("test_vfs")
     set_warnings("all", "error")
     set_kind("binary")
     set_default(false)
-    add_packages("gtest")
+    add_packages("gtest", "minizip-ng")
     add_deps("lochfolk")
     add_files("test_vfs.cpp")
     add_tests("test_lochfolk")
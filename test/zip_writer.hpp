@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <span>
+#include <utility>
+#include <filesystem>
+#include <stdexcept>
+#include <ctime>
+#include <minizip/mz.h>
+#include <minizip/mz_zip.h>
+#include <minizip/mz_zip_rw.h>
+
+// Shared by the tests and the benchmarks
+namespace lochfolk_test
+{
+/**
+ * @brief Write entries into a ZIP archive
+ *
+ * @param method Compression method of minizip, e.g. MZ_COMPRESS_METHOD_DEFLATE
+ *
+ * @exception std::runtime_error Failed to write the archive
+ */
+inline void write_zip(
+    const std::filesystem::path& sys_path,
+    std::span<const std::pair<std::string, std::string>> entries,
+    std::uint16_t method = MZ_COMPRESS_METHOD_DEFLATE
+)
+{
+    void* writer = mz_zip_writer_create();
+    std::int32_t err = mz_zip_writer_open_file(
+        writer,
+        reinterpret_cast<const char*>(sys_path.u8string().c_str()),
+        0,
+        false
+    );
+    if(err != MZ_OK)
+    {
+        mz_zip_writer_delete(&writer);
+        throw std::runtime_error("failed to create archive");
+    }
+
+    mz_zip_writer_set_compress_method(writer, method);
+    for(const auto& [name, data] : entries)
+    {
+        mz_zip_file info{};
+        info.filename = name.c_str();
+        info.modified_date = std::time(nullptr);
+        info.version_madeby = MZ_VERSION_MADEBY;
+        info.compression_method = method;
+        info.flag = MZ_ZIP_FLAG_UTF8;
+
+        err = mz_zip_writer_add_buffer(
+            writer,
+            const_cast<char*>(data.data()),
+            static_cast<std::int32_t>(data.size()),
+            &info
+        );
+        if(err != MZ_OK)
+            break;
+    }
+
+    mz_zip_writer_close(writer);
+    mz_zip_writer_delete(&writer);
+    if(err != MZ_OK)
+        throw std::runtime_error("failed to write archive");
+}
+} // namespace lochfolk_test
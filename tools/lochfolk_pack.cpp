@@ -0,0 +1,140 @@
+// Build a pack of the native format from directories and ZIP archives
+//
+// Usage: lochfolk_pack [options] <output> <input>...
+//
+// Inputs are mounted to the root in order, later ones overwrite earlier ones.
+// A directory is mounted recursively, and any other file is mounted as a ZIP archive.
+//
+// Options:
+//   -e, --encoding <raw|lz4|zstd>  Preferred encoding of files (default: zstd)
+//   -l, --level <n>                Compression level of zstd (default: 0, the default level of zstd)
+//   -a, --alignment <n>            Alignment of file data in bytes (default: 4096)
+//   -o, --order <file>             Text file of virtual paths in access order, one per line
+
+#include <lochfolk/vfs.hpp>
+#include <charconv>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace
+{
+[[noreturn]]
+void usage_error(std::string_view msg)
+{
+    std::cerr << "lochfolk_pack: " << msg << '\n'
+              << "Usage: lochfolk_pack [-e raw|lz4|zstd] [-l level] [-a alignment] [-o order.txt] <output> <input>..."
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+lochfolk::pack_encoding parse_encoding(std::string_view str)
+{
+    if(str == "raw")
+        return lochfolk::pack_encoding::raw;
+    else if(str == "lz4")
+        return lochfolk::pack_encoding::lz4;
+    else if(str == "zstd")
+        return lochfolk::pack_encoding::zstd;
+
+    usage_error("unknown encoding \"" + std::string(str) + '"');
+}
+
+template <typename T>
+T parse_number(std::string_view option, std::string_view str)
+{
+    T result{};
+    const char* last = str.data() + str.size();
+    auto [ptr, ec] = std::from_chars(str.data(), last, result);
+    if(ec != std::errc() || ptr != last)
+        usage_error("invalid value of " + std::string(option) + " \"" + std::string(str) + '"');
+
+    return result;
+}
+
+std::vector<lochfolk::path> read_access_order(const std::filesystem::path& order_file)
+{
+    std::ifstream ifs(order_file);
+    if(!ifs.is_open())
+        usage_error("failed to open access order file");
+
+    std::vector<lochfolk::path> result;
+    std::string line;
+    while(std::getline(ifs, line))
+    {
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if(line.empty())
+            continue;
+
+        lochfolk::path p = lochfolk::path("/") / line;
+        result.push_back(p.lexically_normal());
+    }
+
+    return result;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    lochfolk::pack_options opts;
+    std::vector<lochfolk::path> access_order;
+    std::vector<std::string_view> positional;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        auto next_value = [&]() -> std::string_view
+        {
+            if(i + 1 >= argc)
+                usage_error("missing value of " + std::string(arg));
+            return argv[++i];
+        };
+
+        if(arg == "-e" || arg == "--encoding")
+            opts.encoding = parse_encoding(next_value());
+        else if(arg == "-l" || arg == "--level")
+            opts.level = parse_number<int>(arg, next_value());
+        else if(arg == "-a" || arg == "--alignment")
+            opts.alignment = parse_number<std::uint32_t>(arg, next_value());
+        else if(arg == "-o" || arg == "--order")
+            access_order = read_access_order(next_value());
+        else if(arg.starts_with('-'))
+            usage_error("unknown option " + std::string(arg));
+        else
+            positional.push_back(arg);
+    }
+
+    if(positional.size() < 2)
+        usage_error("missing output or input");
+
+    try
+    {
+        using namespace lochfolk::vfs_literals;
+
+        lochfolk::virtual_file_system vfs;
+        for(std::size_t i = 1; i < positional.size(); ++i)
+        {
+            std::filesystem::path input(positional[i]);
+            if(std::filesystem::is_directory(input))
+                vfs.mount_dir("/"_pv, input);
+            else
+                vfs.mount_archive("/"_pv, input);
+        }
+
+        opts.access_order = access_order;
+        vfs.write_pack("/"_pv, std::filesystem::path(positional[0]), opts);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "lochfolk_pack: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,5 @@
+target("lochfolk_pack")
+    set_warnings("all", "error")
+    set_kind("binary")
+    add_deps("lochfolk")
+    add_files("lochfolk_pack.cpp")
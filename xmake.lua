@@ -2,19 +2,31 @@ add_rules("mode.debug", "mode.release")
 
 set_languages("c++20")
 
-add_requires("minizip-ng")
+-- Build minizip-ng with Zstandard and LZMA for entries compressed by them
+add_requires("minizip-ng", { configs = { zstd = true, lzma = true } })
+add_requires("zlib")
+-- Encodings of the native pack format
+add_requires("lz4", "zstd")
+
+option("path_index")
+    set_default(true)
+    set_showmenu(true)
+    set_description("Index full paths for faster lookups, disable it to save memory")
 
 target("lochfolk")
     set_warnings("all", "error")
     set_kind("$(kind)")
     add_includedirs("include", { public = true })
     add_headerfiles("include/(**.hpp)", { prefix = "include" })
-    add_packages("minizip-ng")
+    add_packages("minizip-ng", "zlib", "lz4", "zstd")
     add_files("src/*.cpp")
     if is_kind("shared") then
         add_defines("LOCHFOLK_SHARED", { public = true })
     end
     add_defines("LOCHFOLK_BUILD")
+    if not has_config("path_index") then
+        add_defines("LOCHFOLK_NO_PATH_INDEX")
+    end
     set_symbols("hidden")
 
 option("unit_test")
@@ -25,3 +37,21 @@ option("unit_test")
 if has_config("unit_test") then
     includes("test")
 end
+
+option("benchmark")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Enable benchmarks building")
+
+if has_config("benchmark") then
+    includes("bench")
+end
+
+option("tools")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Enable tools building")
+
+if has_config("tools") then
+    includes("tools")
+end